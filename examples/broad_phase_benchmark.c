@@ -0,0 +1,88 @@
+/**
+ * @file broad_phase_benchmark.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/3/24
+ *
+ * @brief compare the uniform hash grid against "opus_SAP" on a dense scene of similarly
+ * 		sized boxes and circles, at increasing body counts
+ *
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "data_structure/array.h"
+#include "external/sokol_time.h"
+#include "physics/opus/physics.h"
+#include "physics/opus/physics_private.h"
+
+#define ROUNDS (10)
+
+static void count_pair_(opus_body *A, opus_body *B, void *data)
+{
+	(void) A;
+	(void) B;
+	(*(size_t *) data)++;
+}
+
+/* bodies jitter a little between the rounds, like a settling pile */
+static void jitter_(opus_physics_world *world)
+{
+	size_t i;
+	for (i = 0; i < opus_arr_len(world->bodies); i++) {
+		world->bodies[i]->position.x += opus_rand_m11() * 0.5;
+		world->bodies[i]->position.y += opus_rand_m11() * 0.5;
+	}
+}
+
+int main(void)
+{
+	size_t counts[4] = {1000, 4000, 16000, 64000};
+	size_t i, c, n, k, sap_pairs, grid_pairs;
+
+	opus_physics_world *world;
+	opus_grid          *grid;
+	opus_real           side;
+	uint64_t            start;
+	double              t_sap, t_grid;
+
+	stm_setup();
+
+	printf("%10s %10s %12s %12s %10s\n", "bodies", "pairs", "SAP(ms)", "grid(ms)", "speedup");
+	for (c = 0; c < 4; c++) {
+		n     = counts[c];
+		side  = sqrt((double) n) * 30;
+		world = opus_physics_world_create();
+		grid  = opus_grid_create();
+		for (i = 0; i < n; i++) {
+			opus_vec2 p = opus_vec2_(opus_rand_01() * side, opus_rand_01() * side);
+			if (i % 2) opus_physics_world_add_rect(world, p, 16 + opus_rand_01() * 8, 16 + opus_rand_01() * 8, opus_rand_01() * 3);
+			else opus_physics_world_add_circle(world, p, 8 + opus_rand_01() * 4);
+		}
+
+		t_sap = t_grid = 0;
+		for (k = 0; k < ROUNDS; k++) {
+			jitter_(world);
+
+			sap_pairs = 0;
+			start     = stm_now();
+			opus_SAP(world->bodies, n, count_pair_, &sap_pairs);
+			t_sap += stm_ms(stm_since(start));
+
+			grid_pairs = 0;
+			start      = stm_now();
+			opus_grid_for_each_pair(grid, world->bodies, n, 0, count_pair_, &grid_pairs);
+			t_grid += stm_ms(stm_since(start));
+
+			if (sap_pairs != grid_pairs) printf("pair count mismatch: SAP %d, grid %d\n", (int) sap_pairs, (int) grid_pairs);
+		}
+		printf("%10d %10d %12.3f %12.3f %9.2fx\n", (int) n, (int) grid_pairs, t_sap / ROUNDS, t_grid / ROUNDS, t_sap / t_grid);
+
+		opus_grid_destroy(grid);
+		opus_physics_world_destroy(world);
+	}
+
+	return 0;
+}
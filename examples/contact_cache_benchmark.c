@@ -0,0 +1,147 @@
+/**
+ * @file contact_cache_benchmark.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/3/20
+ *
+ * @brief compare the packed pair key cache used by the physics world against the
+ * 		previous "opus_hashmap" + decimal string id path, at 1k, 10k and 100k pairs
+ *
+ */
+
+#include <stdio.h>
+#include "data_structure/hashmap.h"
+#include "external/sokol_time.h"
+#include "physics/opus/physics.h"
+#include "physics/opus/physics_private.h"
+
+#define LOOKUP_ROUNDS (10)
+
+/* the same as the previous string id of the world contact map */
+static char *string_id_(opus_body *A, opus_body *B)
+{
+	static char id[32];
+
+	uint64_t id_min = A->id < B->id ? A->id : B->id;
+	uint64_t id_max = A->id > B->id ? A->id : B->id;
+
+	sprintf(id, "%d,%d", (int) id_min, (int) id_max);
+	return id;
+}
+
+static uint64_t hash_(opus_hashmap *map, const void *x, uint64_t seed0, uint64_t seed1, void *data)
+{
+	char                *key;
+	const opus_contacts *contacts;
+	(void) map;
+	(void) seed0;
+	(void) seed1;
+	(void) data;
+	contacts = *(opus_contacts **) x;
+	key      = string_id_(contacts->A, contacts->B);
+	return opus_hashmap_murmur(key, strlen(key), 0, 0);
+}
+
+static int compare_(opus_hashmap *map, const void *a, const void *b, void *data)
+{
+	const opus_contacts *ca = *(opus_contacts **) a;
+	const opus_contacts *cb = *(opus_contacts **) b;
+	(void) map;
+	(void) data;
+	return !(ca->A->id == cb->A->id && ca->B->id == cb->B->id);
+}
+
+static double bench_hashmap_(opus_contacts *pairs, size_t n)
+{
+	size_t         i, k;
+	uint64_t       start;
+	opus_hashmap   map;
+	opus_contacts *ptr, key, *key_ptr;
+
+	key_ptr = &key;
+	start   = stm_now();
+	opus_hashmap_init(&map, sizeof(opus_contacts *), 2, 0, 0, compare_, hash_, NULL);
+	for (i = 0; i < n; i++) {
+		ptr = &pairs[i];
+		opus_hashmap_insert(&map, &ptr);
+	}
+	for (k = 0; k < LOOKUP_ROUNDS; k++) {
+		for (i = 0; i < n; i++) {
+			key.A = pairs[i].A;
+			key.B = pairs[i].B;
+			if (!opus_hashmap_retrieve(&map, &key_ptr)) printf("hashmap: missing pair %d\n", (int) i);
+		}
+	}
+	for (i = 0; i < n; i++) {
+		ptr = &pairs[i];
+		opus_hashmap_delete(&map, &ptr);
+	}
+	opus_hashmap_done(&map);
+	return stm_ms(stm_since(start));
+}
+
+static double bench_pair_cache_(opus_contacts *pairs, size_t n)
+{
+	size_t          i, k;
+	uint64_t        start;
+	opus_pair_cache cache;
+
+	start = stm_now();
+	opus_pair_cache_init(&cache, 0);
+	for (i = 0; i < n; i++)
+		opus_pair_cache_insert(&cache, opus_contacts_key(pairs[i].A, pairs[i].B), &pairs[i]);
+	for (k = 0; k < LOOKUP_ROUNDS; k++) {
+		for (i = 0; i < n; i++) {
+			if (!opus_pair_cache_find(&cache, opus_contacts_key(pairs[i].A, pairs[i].B)))
+				printf("pair cache: missing pair %d\n", (int) i);
+		}
+	}
+	for (i = 0; i < n; i++)
+		opus_pair_cache_remove(&cache, opus_contacts_key(pairs[i].A, pairs[i].B));
+	opus_pair_cache_done(&cache);
+	return stm_ms(stm_since(start));
+}
+
+int main(void)
+{
+	size_t counts[3] = {1000, 10000, 100000};
+	size_t i, c, n, n_bodies;
+
+	opus_body     *bodies;
+	opus_contacts *pairs;
+	double         t_map, t_cache;
+
+	stm_setup();
+
+	printf("%10s %16s %16s %10s\n", "pairs", "hashmap(ms)", "pair cache(ms)", "speedup");
+	for (c = 0; c < 3; c++) {
+		n        = counts[c];
+		n_bodies = n / 4 + 2;
+
+		/* bodies only need an id here, each body touches about 8 neighbours like a dense scene */
+		bodies = OPUS_CALLOC(n_bodies, sizeof(opus_body));
+		pairs  = OPUS_CALLOC(n, sizeof(opus_contacts));
+		for (i = 0; i < n_bodies; i++) bodies[i].id = i + 1;
+		for (i = 0; i < n; i++) {
+			pairs[i].A = &bodies[i / 4];
+			pairs[i].B = &bodies[(i / 4 + 1 + i % 4 * (n_bodies / 5)) % n_bodies];
+			if (pairs[i].A == pairs[i].B) pairs[i].B = &bodies[(i / 4 + 1) % n_bodies];
+			if (pairs[i].A->id > pairs[i].B->id) {
+				opus_body *t = pairs[i].A;
+				pairs[i].A   = pairs[i].B;
+				pairs[i].B   = t;
+			}
+		}
+
+		t_map   = bench_hashmap_(pairs, n);
+		t_cache = bench_pair_cache_(pairs, n);
+		printf("%10d %16.3f %16.3f %9.2fx\n", (int) n, t_map, t_cache, t_map / t_cache);
+
+		OPUS_FREE(pairs);
+		OPUS_FREE(bodies);
+	}
+
+	return 0;
+}
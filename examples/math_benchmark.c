@@ -0,0 +1,134 @@
+/**
+ * @file math_benchmark.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/4/5
+ *
+ * @brief the helpers of "math/math_inline.h" against the functions of math.c. First a loop
+ * 		like the narrow phase and the solver (transform, subtract, dot, cross, scale)
+ * 		written with both, in this binary. Then the step of the pyramid of
+ * 		physics_benchmark, which is timed as the physics was built: run math_benchmark
+ * 		and math_benchmark_no_inline (built with OPUS_MATH_NO_INLINE) to compare the two,
+ * 		physics_benchmark_no_inline does the same for all the scenes.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "external/sokol_time.h"
+#include "math/math.h"
+#include "math/math_inline.h"
+#include "physics/opus/physics.h"
+
+#define N_POINTS (4096)
+#define ROUNDS (2000)
+#define STEPS (300)
+
+static opus_vec2 points_[N_POINTS], normals_[N_POINTS];
+
+static opus_real kernel_inline_(opus_transform *t, opus_vec2 p)
+{
+	int       i;
+	opus_vec2 d, r;
+	opus_real sum = 0, s;
+
+	for (i = 0; i < N_POINTS; i++) {
+		r = opus_transform_apply(t, points_[i]);
+		d = opus_vec2_sub(r, p);
+		s = opus_max(opus_vec2_dot(d, normals_[i]), 0);
+		r = opus_vec2_add(r, opus_vec2_scale(normals_[i], s));
+		sum += opus_vec2_cross(r, d) + opus_vec2_len(d);
+	}
+	return sum;
+}
+
+/* the same, the parentheses keep the macros of math_inline.h out */
+static opus_real kernel_call_(opus_transform *t, opus_vec2 p)
+{
+	int       i;
+	opus_vec2 d, r;
+	opus_real sum = 0, s;
+
+	for (i = 0; i < N_POINTS; i++) {
+		r = (opus_transform_apply)(t, points_[i]);
+		d = (opus_vec2_sub)(r, p);
+		s = (opus_max)((opus_vec2_dot)(d, normals_[i]), 0);
+		r = (opus_vec2_add)(r, (opus_vec2_scale)(normals_[i], s));
+		sum += (opus_vec2_cross)(r, d) + (opus_vec2_len)(d);
+	}
+	return sum;
+}
+
+static double time_kernel_(opus_real (*kernel)(opus_transform *t, opus_vec2 p), opus_real *sum)
+{
+	int            k;
+	uint64_t       start;
+	opus_transform t;
+
+	start = stm_now();
+	for (k = 0; k < ROUNDS; k++) {
+		opus_transform_set(&t, k * 0.001, opus_vec2_(k, -k));
+		*sum += kernel(&t, opus_vec2_(1, 2));
+	}
+	return stm_ns(stm_since(start)) / ((double) ROUNDS * N_POINTS);
+}
+
+/* 30 rows, 465 boxes, like physics_benchmark */
+static double time_pyramid_(void)
+{
+	int        i, j, rows = 30;
+	uint64_t   start;
+	opus_body *ground;
+
+	opus_physics_world *world;
+	opus_real           dt = 1. / 60;
+
+	world          = opus_physics_world_create();
+	world->gravity = opus_vec2_(0, 0.2);
+	ground         = opus_physics_world_add_rect(world, opus_vec2_(0, 0), rows * 30, 20, 0);
+	ground->type   = OPUS_BODY_STATIC;
+	for (i = 0; i < rows; i++)
+		for (j = 0; j < rows - i; j++)
+			opus_physics_world_add_rect(world, opus_vec2_((j - (rows - i) * 0.5) * 21, -20.5 - i * 20.5), 20, 20, 0);
+
+	for (i = 0; i < 60; i++) opus_physics_world_step(world, dt);
+	start = stm_now();
+	for (i = 0; i < STEPS; i++) opus_physics_world_step(world, dt);
+
+	opus_physics_world_destroy(world);
+	return stm_ms(stm_since(start)) / STEPS;
+}
+
+int main(void)
+{
+	int       i;
+	opus_real sum = 0;
+	double    t_inline, t_call;
+
+	stm_setup();
+
+	srand(1);
+	for (i = 0; i < N_POINTS; i++) {
+		points_[i]  = opus_vec2_(opus_rand_m11() * 100, opus_rand_m11() * 100);
+		normals_[i] = opus_vec2_norm(opus_vec2_(opus_rand_m11(), opus_rand_m11() + 2));
+	}
+
+	/* once each to warm up */
+	time_kernel_(kernel_inline_, &sum);
+	time_kernel_(kernel_call_, &sum);
+	t_inline = time_kernel_(kernel_inline_, &sum);
+	t_call   = time_kernel_(kernel_call_, &sum);
+
+	printf("vec2 loop:     %8.2f ns per point inline, %8.2f ns per point with calls (%.2fx)\n", t_inline, t_call,
+	       t_call / t_inline);
+#ifdef OPUS_MATH_NO_INLINE
+	printf("pyramid step:  %8.3f ms, physics built with OPUS_MATH_NO_INLINE\n", time_pyramid_());
+#else
+	printf("pyramid step:  %8.3f ms, physics built with math_inline.h\n", time_pyramid_());
+#endif
+	printf("(checksum %g)\n", (double) sum);
+
+	return 0;
+}
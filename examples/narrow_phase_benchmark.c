@@ -0,0 +1,101 @@
+/**
+ * @file narrow_phase_benchmark.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/4/6
+ *
+ * @brief a pile of polygons in a box with SAT and with GJK, stepped with 1, 2, 4 and 8
+ * 		"narrow_phase_threads". Prints the time of a step, of the narrow phase and a checksum
+ * 		of the poses, which has to be the same for every thread count. The narrow phase is
+ * 		timed by OPUS_PHYSICS_PROFILE, so the physics has to be built with it, like the
+ * 		narrow_phase_benchmark target does.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "data_structure/array.h"
+#include "external/sokol_time.h"
+#include "physics/opus/physics.h"
+
+#define WARMUP_STEPS (120)
+#define STEPS (200)
+
+static int threads_[] = {1, 2, 4, 8};
+
+static void build_pile_(opus_physics_world *world)
+{
+	int        i, k, n_bodies = 3000, per_row = 60;
+	opus_real  side = 60 * 16;
+	opus_body *wall;
+
+	wall       = opus_physics_world_add_rect(world, opus_vec2_(side / 2, 10), side + 40, 20, 0);
+	wall->type = OPUS_BODY_STATIC;
+	wall       = opus_physics_world_add_rect(world, opus_vec2_(-10, -side / 2), 20, side + 40, 0);
+	wall->type = OPUS_BODY_STATIC;
+	wall       = opus_physics_world_add_rect(world, opus_vec2_(side + 10, -side / 2), 20, side + 40, 0);
+	wall->type = OPUS_BODY_STATIC;
+
+	srand(1);
+	for (i = 0; i < n_bodies; i++) {
+		/* 4, 6 or 8 sides */
+		k = i % per_row;
+		opus_physics_world_add_n_polygon(world, opus_vec2_(20 + k * 16 + opus_rand_m11(), -10 - (i / per_row) * 16),
+		                                 5 + opus_rand_01() * 2, 4 + 2 * (rand() % 3));
+	}
+}
+
+static double checksum_(opus_physics_world *world)
+{
+	size_t i;
+	double sum = 0;
+	for (i = 0; i < opus_arr_len(world->bodies); i++)
+		sum += world->bodies[i]->position.x * 0.001 + world->bodies[i]->position.y + world->bodies[i]->rotation;
+	return sum;
+}
+
+static void run_(int narrow_phase, int threads)
+{
+	int      i;
+	uint64_t start;
+	double   t_step, t_narrow = 0;
+
+	opus_physics_world *world;
+	opus_real           dt = 1. / 60;
+
+	world                       = opus_physics_world_create();
+	world->gravity              = opus_vec2_(0, 0.2);
+	world->narrow_phase         = narrow_phase;
+	world->narrow_phase_threads = threads;
+	build_pile_(world);
+
+	for (i = 0; i < WARMUP_STEPS; i++) opus_physics_world_step(world, dt);
+	start = stm_now();
+	for (i = 0; i < STEPS; i++) {
+		opus_physics_world_step(world, dt);
+		t_narrow += world->profile.phase_ns[OPUS_PHASE_NARROW];
+	}
+	t_step = stm_ms(stm_since(start)) / STEPS;
+
+	printf("  %8d %12.3f %12.3f %18.6f\n", threads, t_step, t_narrow / 1e6 / STEPS, checksum_(world));
+	opus_physics_world_destroy(world);
+}
+
+int main(void)
+{
+	size_t i;
+
+	stm_setup();
+
+	printf("SAT, 3000 polygons\n");
+	printf("  %8s %12s %12s %18s\n", "threads", "step(ms)", "narrow(ms)", "checksum");
+	for (i = 0; i < sizeof(threads_) / sizeof(threads_[0]); i++) run_(OPUS_NARROW_PHASE_SAT, threads_[i]);
+
+	printf("GJK, 3000 polygons\n");
+	printf("  %8s %12s %12s %18s\n", "threads", "step(ms)", "narrow(ms)", "checksum");
+	for (i = 0; i < sizeof(threads_) / sizeof(threads_[0]); i++) run_(OPUS_NARROW_PHASE_GJK, threads_[i]);
+
+	return 0;
+}
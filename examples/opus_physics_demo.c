@@ -196,6 +196,35 @@ void draw_shape(opus_shape *s, opus_real rot, opus_vec2 pos)
 	}
 }
 
+/* what the world recorded in the last step, see debug_draw.c */
+void draw_debug_cmds(opus_debug_cmd *cmds)
+{
+	size_t          i;
+	opus_debug_cmd *cmd;
+
+	for (i = 0; i < opus_arr_len(cmds); i++) {
+		cmd = &cmds[i];
+		plutovg_set_source_rgba(pl, (cmd->color >> 24 & 0xff) / 255.0, (cmd->color >> 16 & 0xff) / 255.0,
+		                        (cmd->color >> 8 & 0xff) / 255.0, (cmd->color & 0xff) / 255.0);
+		switch (cmd->type) {
+			case OPUS_DEBUG_LINE:
+				opus_pl_line_vec(pl, cmd->a, cmd->b);
+				plutovg_set_line_width(pl, cmd->size);
+				plutovg_stroke(pl);
+				break;
+			case OPUS_DEBUG_CIRCLE:
+				plutovg_circle(pl, cmd->a.x, cmd->a.y, cmd->size);
+				plutovg_fill(pl);
+				break;
+			case OPUS_DEBUG_RECT:
+				plutovg_rect(pl, cmd->a.x, cmd->a.y, cmd->b.x - cmd->a.x, cmd->b.y - cmd->a.y);
+				plutovg_set_line_width(pl, cmd->size);
+				plutovg_stroke(pl);
+				break;
+		}
+	}
+}
+
 void update(opus_engine *engine, opus_real delta)
 {
 	opus_input *input = g_param.input;
@@ -222,12 +251,13 @@ void test_SAT(void)
 	opus_overlap_result dr;
 	opus_clip_result    cr;
 
-	opus_mat2d t, mat, tp, tc;
+	opus_mat2d     t, mat;
+	opus_transform tp, tc;
 
-	opus_mat2d_rotate_about(tp, g_param.rot_a, g_param.pos_a);
-	opus_mat2d_rotate_about(tc, g_param.rot_c, g_param.pos_c);
+	opus_transform_set(&tp, g_param.rot_a, g_param.pos_a);
+	opus_transform_set(&tc, g_param.rot_c, g_param.pos_c);
 
-	dr = opus_SAT((void *) g_param.pa, (void *) g_param.ca, tp, tc);
+	dr = opus_SAT((void *) g_param.pa, (void *) g_param.ca, &tp, &tc);
 
 	plutovg_set_source_rgb(g_param.pl, COLOR_BLACK);
 	draw_shape((void *) g_param.pa, g_param.rot_a, g_param.pos_a);
@@ -241,7 +271,7 @@ void test_SAT(void)
 
 		plutovg_set_source_rgb(g_param.pl, COLOR_BLACK);
 		if (dr.A == (void *) g_param.ca) {
-			c = opus_mat2d_pre_mul_vec(dr.transform_a, opus_vec2_(0, 0));
+			c = dr.transform_a.p;
 		} else {
 			c = (cr.supports[0][0]);
 		}
@@ -363,7 +393,7 @@ void render(opus_engine *engine)
 	if (g_param.test_SAT) test_SAT();
 
 	if (g_param.test_world) {
-		g_param.world->draw_contacts = 1;
+		g_param.world->debug_draw = OPUS_DEBUG_DRAW_CONTACTS | OPUS_DEBUG_DRAW_JOINTS;
 		g_param.world->enable_sleeping = 1;
 		g_param.world->gravity = opus_vec2_(0, 0.2);
 
@@ -392,29 +422,7 @@ void render(opus_engine *engine)
 				plutovg_fill(pl);
 			}
 		}
-		for (i = 0; i < opus_arr_len(g_param.world->joints); i++) {
-			switch (g_param.world->joints[i]->type) {
-				case OPUS_JOINT_REVOLUTE: {
-					opus_joint_revolute *joint = (void *) g_param.world->joints[i];
-					opus_vec2            pa, pb;
-					pa = opus_body_l2w(joint->A, joint->local_a);
-					pb = opus_body_l2w(joint->B, joint->local_b);
-					opus_pl_line_vec(pl, joint->A->position, pa);
-					opus_pl_line_vec(pl, joint->B->position, pb);
-					plutovg_set_line_width(pl, 1.4);
-					plutovg_set_source_rgba(pl, COLOR_SLATE_GRAY1, 1);
-					plutovg_stroke(pl);
-					break;
-				}
-				case OPUS_JOINT_DISTANCE: {
-					opus_joint_distance *joint = (void *) g_param.world->joints[i];
-					plutovg_circle(pl, joint->anchor.x, joint->anchor.y, 3);
-					plutovg_set_source_rgba(pl, COLOR_SLATE_GRAY1, 1);
-					plutovg_fill(pl);
-					break;
-				}
-			}
-		}
+		draw_debug_cmds(g_param.world->debug_cmds);
 
 		plutovg_circle(g_param.pl, g_param.pointer.x, g_param.pointer.y, 3);
 		plutovg_set_source_rgba(pl, COLOR_RED, 1);
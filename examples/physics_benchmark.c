@@ -0,0 +1,223 @@
+/**
+ * @file physics_benchmark.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/4/1
+ *
+ * @brief headless benchmark of "opus_physics_world_step" on the standard scenes, prints
+ * 		the percentiles of the time of each phase in ns per step and the counters of
+ * 		"opus_physics_profile". Needs no window, build it with the CMake option
+ * 		OPUS_BUILD_BENCHMARK, which turns on OPUS_PHYSICS_PROFILE for the phases. Without
+ * 		OPUS_PHYSICS_PROFILE only the whole step is timed.
+ *
+ * 		usage: physics_benchmark [steps] [scene]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "data_structure/array.h"
+#include "external/sokol_time.h"
+#include "physics/opus/physics.h"
+#include "physics/opus/physics_private.h"
+
+#define WARMUP_STEPS (60)
+#define DEFAULT_STEPS (300)
+
+typedef struct scene scene;
+
+struct scene {
+	const char *name;
+	void (*build)(opus_physics_world *world);
+};
+
+static opus_body *add_ground_(opus_physics_world *world, opus_vec2 position, opus_real width, opus_real height)
+{
+	opus_body *body = opus_physics_world_add_rect(world, position, width, height, 0);
+	body->type      = OPUS_BODY_STATIC;
+	return body;
+}
+
+/* 30 rows, 465 boxes */
+static void build_pyramid_(opus_physics_world *world)
+{
+	int i, j, rows = 30;
+
+	add_ground_(world, opus_vec2_(0, 0), rows * 30, 20);
+	for (i = 0; i < rows; i++)
+		for (j = 0; j < rows - i; j++)
+			opus_physics_world_add_rect(world, opus_vec2_((j - (rows - i) * 0.5) * 21, -20.5 - i * 20.5), 20, 20, 0);
+}
+
+/* 20 columns of 15 boxes, apart from each other */
+static void build_columns_(opus_physics_world *world)
+{
+	int i, j, columns = 20, height = 15;
+
+	add_ground_(world, opus_vec2_(columns * 20, 0), columns * 50, 20);
+	for (i = 0; i < columns; i++)
+		for (j = 0; j < height; j++)
+			opus_physics_world_add_rect(world, opus_vec2_(i * 40, -20.5 - j * 20.5), 20, 20, 0);
+}
+
+/* like the demo, chains of boxes linked by revolute joints and hung by distance joints at both ends */
+static void build_chains_(opus_physics_world *world)
+{
+	int i, j, chains = 16, links = 20;
+
+	opus_body           *cur, *prev;
+	opus_joint_revolute *joint;
+	opus_real            w = 40, h = 40, gap = 3, x, y;
+
+	add_ground_(world, opus_vec2_(links * (w + gap) * 0.5, 1000), links * (w + gap) * 2, 40);
+	for (i = 0; i < chains; i++) {
+		x    = 0;
+		y    = -i * 60.0;
+		prev = NULL;
+		for (j = 0; j < links; j++) {
+			cur = opus_physics_world_add_rect(world, opus_vec2_(x + j * (w + gap), y), w, h, 0);
+			if (j == 0)
+				opus_physics_world_add_distance_joint(world, cur, opus_vec2_(-w / 2, 0),
+				                                      opus_vec2_add(cur->position, opus_vec2_(-w / 2 - 2 * gap, 0)), 0, 10);
+			else if (j == links - 1)
+				opus_physics_world_add_distance_joint(world, cur, opus_vec2_(w / 2, 0),
+				                                      opus_vec2_add(cur->position, opus_vec2_(w / 2 + 2 * gap, 0)), 0, 10);
+			if (prev) {
+				joint = (void *) opus_physics_world_add_revolute_joint(world, cur, prev,
+				                                                       opus_vec2_(-w / 2 - 2 * gap, 0),
+				                                                       opus_vec2_(w / 2 + 2 * gap, 0));
+				joint->stiffness = 1;
+			}
+			prev = cur;
+		}
+	}
+}
+
+/* 2000 circles of random sizes poured into a box, on a jittered grid so that they start apart */
+static void build_circle_soup_(opus_physics_world *world)
+{
+	int       i, n = 2000, per_row = 50;
+	opus_real side = 800, spacing = 15;
+
+	add_ground_(world, opus_vec2_(side / 2, 10), side + 40, 20);
+	add_ground_(world, opus_vec2_(-10, -side / 2), 20, side + 40);
+	add_ground_(world, opus_vec2_(side + 10, -side / 2), 20, side + 40);
+
+	srand(1);
+	for (i = 0; i < n; i++)
+		opus_physics_world_add_circle(world,
+		                              opus_vec2_(20 + (i % per_row) * spacing + opus_rand_m11(),
+		                                         -10 - (i / per_row) * spacing + opus_rand_m11()),
+		                              4 + opus_rand_01() * 3);
+}
+
+static scene scenes_[] = {
+        {"pyramid", build_pyramid_},
+        {"columns", build_columns_},
+        {"chains", build_chains_},
+        {"circle_soup", build_circle_soup_},
+};
+
+static int compare_double_(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+/* nearest rank, sorts "samples" */
+static double percentile_(double *samples, int n, double p)
+{
+	int rank;
+
+	qsort(samples, n, sizeof(double), compare_double_);
+	rank = (int) (p / 100 * n + 0.5);
+	if (rank < 1) rank = 1;
+	if (rank > n) rank = n;
+	return samples[rank - 1];
+}
+
+static void print_row_(const char *name, double *samples, int n)
+{
+	printf("  %-16s %12.0f %12.0f %12.0f %12.0f\n", name,
+	       percentile_(samples, n, 50), percentile_(samples, n, 90), percentile_(samples, n, 99),
+	       percentile_(samples, n, 100));
+}
+
+static void run_(scene *s, int steps)
+{
+	int      i, p;
+	uint64_t start;
+	double  *step_ns, *phase_ns[OPUS_PHASE_COUNT];
+
+	opus_physics_profile sum = {0}, *last;
+
+	opus_physics_world *world;
+	opus_real           dt = 1. / 60;
+
+	world          = opus_physics_world_create();
+	world->gravity = opus_vec2_(0, 0.2);
+	s->build(world);
+
+	step_ns = OPUS_MALLOC(sizeof(double) * steps);
+	for (p = 0; p < OPUS_PHASE_COUNT; p++) phase_ns[p] = OPUS_MALLOC(sizeof(double) * steps);
+
+	for (i = 0; i < WARMUP_STEPS; i++) opus_physics_world_step(world, dt);
+	for (i = 0; i < steps; i++) {
+		start = stm_now();
+		opus_physics_world_step(world, dt);
+		step_ns[i] = stm_ns(stm_since(start));
+
+		last = &world->profile;
+		for (p = 0; p < OPUS_PHASE_COUNT; p++) phase_ns[p][i] = last->phase_ns[p];
+		sum.candidate_pairs += last->candidate_pairs;
+		sum.narrow_tests += last->narrow_tests;
+		sum.active_contacts += last->active_contacts;
+		sum.warm_starts += last->warm_starts;
+		sum.new_contacts += last->new_contacts;
+		sum.allocations += last->allocations;
+	}
+
+	printf("%s: bodies %d, joints %d, contacts %d\n", s->name, (int) opus_arr_len(world->bodies),
+	       (int) opus_arr_len(world->joints), (int) world->contacts.count);
+	printf("  %-16s %12s %12s %12s %12s\n", "ns/step", "p50", "p90", "p99", "max");
+#ifdef OPUS_PHYSICS_PROFILE
+	for (p = 0; p < OPUS_PHASE_COUNT; p++) print_row_(opus_physics_phase_name(p), phase_ns[p], steps);
+#endif
+	print_row_("step", step_ns, steps);
+#ifdef OPUS_PHYSICS_PROFILE
+	printf("  per step: %.0f candidate pairs, %.0f narrow tests, %.0f contacts, %.1f%% warm started, %.2f allocations\n",
+	       (double) sum.candidate_pairs / steps, (double) sum.narrow_tests / steps,
+	       (double) sum.active_contacts / steps,
+	       100.0 * sum.warm_starts / opus_max(1, sum.warm_starts + sum.new_contacts),
+	       (double) sum.allocations / steps);
+#endif
+
+	for (p = 0; p < OPUS_PHASE_COUNT; p++) OPUS_FREE(phase_ns[p]);
+	OPUS_FREE(step_ns);
+	opus_physics_world_destroy(world);
+}
+
+int main(int argc, char **argv)
+{
+	int    steps = DEFAULT_STEPS;
+	size_t i;
+
+	if (argc > 1) steps = atoi(argv[1]);
+	if (steps < 1) {
+		fprintf(stderr, "usage: %s [steps] [scene]\n", argv[0]);
+		return 1;
+	}
+
+	stm_setup();
+
+#ifndef OPUS_PHYSICS_PROFILE
+	printf("built without OPUS_PHYSICS_PROFILE, only the whole step is timed\n");
+#endif
+	for (i = 0; i < sizeof(scenes_) / sizeof(scenes_[0]); i++)
+		if (argc < 3 || strcmp(argv[2], scenes_[i].name) == 0) run_(&scenes_[i], steps);
+
+	return 0;
+}
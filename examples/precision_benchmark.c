@@ -0,0 +1,94 @@
+/**
+ * @file precision_benchmark.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/3/31
+ *
+ * @brief step time and drift of a settled pyramid of boxes, near the origin and far away
+ * 		from it. Build it once against "opus" and once against "opus_f32" (the CMake option
+ * 		OPUS_BUILD_F32), the two runs print the same table for the two scalar types.
+ * 		Drift is how far the boxes move from where they settled, a resting pile should
+ * 		not move at all.
+ *
+ */
+
+#include <stdio.h>
+#include "data_structure/array.h"
+#include "external/sokol_time.h"
+#include "physics/opus/physics.h"
+#include "physics/opus/physics_private.h"
+
+#define ROWS (20)
+#define SETTLE_STEPS (300)
+#define STEPS (600)
+
+static opus_physics_world *create_pyramid_(opus_real offset)
+{
+	int i, j;
+
+	opus_physics_world *world;
+	opus_body          *ground;
+
+	world          = opus_physics_world_create();
+	world->gravity = opus_vec2_(0, 0.2);
+	ground         = opus_physics_world_add_rect(world, opus_vec2_(offset, 0), ROWS * 30, 20, 0);
+	ground->type   = OPUS_BODY_STATIC;
+	for (i = 0; i < ROWS; i++)
+		for (j = 0; j < ROWS - i; j++)
+			opus_physics_world_add_rect(world, opus_vec2_(offset + (j - (ROWS - i) * 0.5) * 21, -20.5 - i * 20.5), 20, 20, 0);
+
+	return world;
+}
+
+static void run_(opus_real offset)
+{
+	size_t i, n;
+
+	opus_physics_world *world;
+	opus_body          *body;
+	opus_vec2          *settled;
+	opus_real           dt = 1. / 60;
+	uint64_t            start;
+	double              t_step, d, drift, max_drift;
+
+	world = create_pyramid_(offset);
+	n     = opus_arr_len(world->bodies);
+	for (i = 0; i < SETTLE_STEPS; i++) opus_physics_world_step(world, dt);
+
+	/* the order of "world->bodies" changes with the broad phase, remember by id */
+	settled = OPUS_MALLOC(sizeof(opus_vec2) * (n + 1));
+	for (i = 0; i < n; i++) settled[world->bodies[i]->id] = world->bodies[i]->position;
+
+	start = stm_now();
+	for (i = 0; i < STEPS; i++) opus_physics_world_step(world, dt);
+	t_step = stm_ms(stm_since(start)) / STEPS;
+
+	for (i = 0, drift = 0, max_drift = 0; i < n; i++) {
+		body = world->bodies[i];
+		if (body->type == OPUS_BODY_STATIC) continue;
+		d = opus_vec2_len(opus_vec2_sub(body->position, settled[body->id]));
+		drift += d;
+		max_drift = opus_max(max_drift, d);
+	}
+
+	printf("%12.0f %8d %12.3f %14.6f %14.6f\n", (double) offset, (int) n, t_step, drift / (double) (n - 1), max_drift);
+
+	OPUS_FREE(settled);
+	opus_physics_world_destroy(world);
+}
+
+int main(void)
+{
+	opus_real offsets[3] = {0, 1e4, 1e6};
+	int       i;
+
+	stm_setup();
+
+	printf("opus_real is %s (%d bytes)\n", sizeof(opus_real) == sizeof(float) ? "float" : "double", (int) sizeof(opus_real));
+	printf("%12s %8s %12s %14s %14s\n", "offset", "bodies", "step(ms)", "mean drift", "max drift");
+	for (i = 0; i < 3; i++) run_(offsets[i]);
+
+	return 0;
+}
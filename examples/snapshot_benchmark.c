@@ -0,0 +1,94 @@
+/**
+ * @file snapshot_benchmark.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/3/29
+ *
+ * @brief cost of saving and restoring a resting pile of 10k boxes, compared to one step of
+ * 		the same world, and a check that stepping after a restore repeats the original run
+ *
+ */
+
+#include <stdio.h>
+#include "data_structure/array.h"
+#include "external/sokol_time.h"
+#include "physics/opus/physics.h"
+#include "physics/opus/physics_private.h"
+
+#define ROUNDS (50)
+#define COLUMNS (200)
+#define ROWS (50)
+#define STEPS (10)
+
+static double checksum_(opus_physics_world *world)
+{
+	size_t     i;
+	double     sum;
+	opus_body *body;
+
+	for (i = 0, sum = 0; i < opus_arr_len(world->bodies); i++) {
+		body = world->bodies[i];
+		sum += body->position.x + body->position.y + body->rotation;
+	}
+	return sum;
+}
+
+int main(void)
+{
+	size_t i, j, size;
+
+	opus_physics_world *world;
+	opus_body          *body;
+	opus_real           dt = 1. / 60;
+	uint64_t            start;
+	void               *buffer;
+	double              t_step, t_snapshot, t_restore, before, after;
+
+	stm_setup();
+
+	world          = opus_physics_world_create();
+	world->gravity = opus_vec2_(0, 0.2);
+	body           = opus_physics_world_add_rect(world, opus_vec2_(COLUMNS * 10, 0), COLUMNS * 22, 20, 0);
+	body->type     = OPUS_BODY_STATIC;
+	for (i = 0; i < COLUMNS; i++)
+		for (j = 0; j < ROWS; j++)
+			opus_physics_world_add_rect(world, opus_vec2_(i * 21, -20 - j * 20.5), 20, 20, 0);
+
+	/* let the pile touch down so that there are contacts to save */
+	for (i = 0; i < 60; i++) opus_physics_world_step(world, dt);
+
+	start = stm_now();
+	for (i = 0; i < STEPS; i++) opus_physics_world_step(world, dt);
+	t_step = stm_ms(stm_since(start)) / STEPS;
+
+	size   = opus_physics_world_snapshot_size(world);
+	buffer = OPUS_MALLOC(size);
+
+	start = stm_now();
+	for (i = 0; i < ROUNDS; i++) opus_physics_world_snapshot(world, buffer, size);
+	t_snapshot = stm_ms(stm_since(start)) / ROUNDS;
+
+	start = stm_now();
+	for (i = 0; i < ROUNDS; i++) opus_physics_world_restore(world, buffer, size);
+	t_restore = stm_ms(stm_since(start)) / ROUNDS;
+
+	/* rollback: the steps after the restore must land on the same state */
+	for (i = 0; i < STEPS; i++) opus_physics_world_step(world, dt);
+	before = checksum_(world);
+	opus_physics_world_restore(world, buffer, size);
+	for (i = 0; i < STEPS; i++) opus_physics_world_step(world, dt);
+	after = checksum_(world);
+
+	printf("bodies %d, contacts %d, snapshot %.1f KB\n",
+	       (int) opus_arr_len(world->bodies), (int) world->contacts.count, (double) size / 1024);
+	printf("%12s %14s %14s\n", "step(ms)", "snapshot(ms)", "restore(ms)");
+	printf("%12.3f %14.3f %14.3f\n", t_step, t_snapshot, t_restore);
+	printf("replay after restore: %s\n", before == after ? "identical" : "DIFFERENT");
+
+	OPUS_FREE(buffer);
+	opus_physics_world_destroy(world);
+
+	return 0;
+}
@@ -0,0 +1,240 @@
+/**
+ * @file solver_benchmark.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/4/3
+ *
+ * @brief stability of a pyramid and a tall column of boxes against the cost of the solver,
+ * 		for OPUS_SOLVER_ITERATIVE with a few iteration counts and OPUS_SOLVER_SOFT_STEP with
+ * 		a few sub-step counts, with and without "use_simd_solver". Drift is how far the boxes move after they have settled (a
+ * 		resting stack should not move at all), overlap is the deepest contact at the end
+ * 		and fallen is the number of boxes which slid sideways by more than half their size.
+ * 		The last table times the contact passes alone, the part "use_simd_solver" changes.
+ *
+ */
+
+#include <stdio.h>
+#include "data_structure/array.h"
+#include "external/sokol_time.h"
+#include "physics/opus/physics.h"
+#include "physics/opus/physics_private.h"
+
+#define BOX (20)
+#define SETTLE_STEPS (300)
+#define STEPS (600)
+#define PASSES (2000)
+
+typedef struct setup setup;
+
+struct setup {
+	const char *name;
+	int         mode;
+	int         velocity_iteration, position_iteration, sub_steps;
+	int         simd;
+};
+
+static setup setups_[] = {
+        {"iterative 6+20", OPUS_SOLVER_ITERATIVE, 6, 20, 0, 0},
+        {"iterative 4+8", OPUS_SOLVER_ITERATIVE, 4, 8, 0, 0},
+        {"iterative 2+2", OPUS_SOLVER_ITERATIVE, 2, 2, 0, 0},
+        {"soft 1", OPUS_SOLVER_SOFT_STEP, 0, 0, 1, 0},
+        {"soft 2", OPUS_SOLVER_SOFT_STEP, 0, 0, 2, 0},
+        {"soft 4", OPUS_SOLVER_SOFT_STEP, 0, 0, 4, 0},
+        {"soft 8", OPUS_SOLVER_SOFT_STEP, 0, 0, 8, 0},
+        {"simd 6+20", OPUS_SOLVER_ITERATIVE, 6, 20, 0, 1},
+        {"simd soft 4", OPUS_SOLVER_SOFT_STEP, 0, 0, 4, 1},
+};
+
+static void build_pyramid_(opus_physics_world *world)
+{
+	int        i, j, rows = 20;
+	opus_body *ground;
+
+	ground       = opus_physics_world_add_rect(world, opus_vec2_(0, 0), rows * 30, 20, 0);
+	ground->type = OPUS_BODY_STATIC;
+	for (i = 0; i < rows; i++)
+		for (j = 0; j < rows - i; j++)
+			opus_physics_world_add_rect(world, opus_vec2_((j - (rows - i) * 0.5) * (BOX + 1), -20.5 - i * (BOX + 0.5)), BOX, BOX, 0);
+}
+
+static void build_column_(opus_physics_world *world)
+{
+	int        i, height = 30;
+	opus_body *ground;
+
+	ground       = opus_physics_world_add_rect(world, opus_vec2_(0, 0), 200, 20, 0);
+	ground->type = OPUS_BODY_STATIC;
+	for (i = 0; i < height; i++)
+		opus_physics_world_add_rect(world, opus_vec2_(0, -20.5 - i * (BOX + 0.5)), BOX, BOX, 0);
+}
+
+/* deepest overlap of the contact points of the world */
+static opus_real max_overlap_(opus_physics_world *world)
+{
+	uint64_t i;
+	int      j;
+
+	opus_pair_entry *entry;
+	opus_contacts   *contacts;
+	opus_contact    *c;
+	opus_real        overlap = 0;
+
+	opus_pair_cache_foreach_start(&world->contacts, entry, i)
+	{
+		contacts = entry->value;
+		for (j = 0; j < contacts->n_contacts; j++) {
+			c       = &contacts->contacts[j];
+			overlap = opus_max(overlap, -opus_vec2_dot(opus_vec2_to(c->pa, c->pb), c->normal));
+		}
+	}
+	opus_pair_cache_foreach_end();
+	return overlap;
+}
+
+static void run_(setup *s, void (*build)(opus_physics_world *world))
+{
+	size_t i, n;
+	int    fallen;
+
+	opus_physics_world *world;
+	opus_body          *body;
+	opus_vec2          *settled, *start;
+	opus_real           dt = 1. / 60;
+	uint64_t            begin;
+	double              t_step, d, drift, max_drift;
+
+	world                     = opus_physics_world_create();
+	world->gravity            = opus_vec2_(0, 0.2);
+	world->solver_mode        = s->mode;
+	world->velocity_iteration = s->velocity_iteration;
+	world->position_iteration = s->position_iteration;
+	world->sub_steps          = s->sub_steps;
+	world->use_simd_solver    = s->simd;
+	build(world);
+
+	/* the order of "world->bodies" changes with the broad phase, remember by id */
+	n       = opus_arr_len(world->bodies);
+	start   = OPUS_MALLOC(sizeof(opus_vec2) * (n + 1));
+	settled = OPUS_MALLOC(sizeof(opus_vec2) * (n + 1));
+	for (i = 0; i < n; i++) start[world->bodies[i]->id] = world->bodies[i]->position;
+
+	for (i = 0; i < SETTLE_STEPS; i++) opus_physics_world_step(world, dt);
+	for (i = 0; i < n; i++) settled[world->bodies[i]->id] = world->bodies[i]->position;
+
+	begin = stm_now();
+	for (i = 0; i < STEPS; i++) opus_physics_world_step(world, dt);
+	t_step = stm_ms(stm_since(begin)) / STEPS;
+
+	for (i = 0, drift = 0, max_drift = 0, fallen = 0; i < n; i++) {
+		body = world->bodies[i];
+		if (body->type == OPUS_BODY_STATIC) continue;
+		d = opus_vec2_len(opus_vec2_sub(body->position, settled[body->id]));
+		drift += d;
+		max_drift = opus_max(max_drift, d);
+		if (opus_abs(body->position.x - start[body->id].x) > BOX / 2) fallen++;
+	}
+
+	printf("  %-16s %10.3f %12.4f %12.4f %10.3f %8d\n", s->name, t_step, drift / (double) (n - 1), max_drift,
+	       (double) max_overlap_(world), fallen);
+
+	OPUS_FREE(start);
+	OPUS_FREE(settled);
+	opus_physics_world_destroy(world);
+}
+
+/* the step leaves the points of its contacts inactive, for the next one */
+static void activate_contacts_(opus_physics_world *world)
+{
+	uint64_t i;
+	int      j;
+
+	opus_pair_entry *entry;
+	opus_contacts   *contacts;
+
+	opus_pair_cache_foreach_start(&world->contacts, entry, i)
+	{
+		contacts = entry->value;
+		for (j = 0; j < contacts->n_contacts; j++) contacts->contacts[j].is_active = 1;
+	}
+	opus_pair_cache_foreach_end();
+}
+
+/**
+ * @brief only the contact passes of the serial solver, over the points of the settled pyramid,
+ * 		a velocity pass of OPUS_SOLVER_ITERATIVE or a sub-step of OPUS_SOLVER_SOFT_STEP
+ * 		(warm start, soft pass and relaxing pass)
+ * @return microseconds a pass
+ */
+static double time_passes_(int mode, int simd, size_t *n_points)
+{
+	size_t i;
+
+	opus_physics_world  *world;
+	opus_contact_solver *solver;
+	opus_real            dt = 1. / 60;
+	uint64_t             begin;
+	double               t;
+
+	world                  = opus_physics_world_create();
+	world->gravity         = opus_vec2_(0, 0.2);
+	world->solver_mode     = mode;
+	world->sub_steps       = 1;
+	world->use_simd_solver = simd;
+	build_pyramid_(world);
+	for (i = 0; i < SETTLE_STEPS; i++) opus_physics_world_step(world, dt);
+
+	activate_contacts_(world);
+	solver = opus_contact_solver_create();
+	opus_contact_solver_gather(solver, world, dt);
+	*n_points = opus_arr_len(solver->constraints);
+
+	begin = stm_now();
+	for (i = 0; i < PASSES; i++) {
+		if (mode == OPUS_SOLVER_ITERATIVE) {
+			opus_contact_solver_solve_velocity(solver);
+		} else {
+			opus_contact_solver_warm_start(solver);
+			opus_contact_solver_solve_soft(solver, world, 1, dt);
+			opus_contact_solver_solve_soft(solver, world, 0, dt);
+		}
+	}
+	t = stm_us(stm_since(begin)) / PASSES;
+
+	opus_contact_solver_destroy(solver);
+	opus_physics_world_destroy(world);
+	return t;
+}
+
+static void print_passes_(const char *name, int mode)
+{
+	size_t n;
+	double t_points, t_lanes;
+
+	t_points = time_passes_(mode, 0, &n);
+	t_lanes  = time_passes_(mode, 1, &n);
+	printf("  %-16s %8d %12.3f %12.3f %10.2fx\n", name, (int) n, t_points, t_lanes, t_points / t_lanes);
+}
+
+int main(void)
+{
+	size_t i;
+
+	stm_setup();
+
+	printf("pyramid of 20 rows\n");
+	printf("  %-16s %10s %12s %12s %10s %8s\n", "solver", "step(ms)", "mean drift", "max drift", "overlap", "fallen");
+	for (i = 0; i < sizeof(setups_) / sizeof(setups_[0]); i++) run_(&setups_[i], build_pyramid_);
+
+	printf("column of 30 boxes\n");
+	printf("  %-16s %10s %12s %12s %10s %8s\n", "solver", "step(ms)", "mean drift", "max drift", "overlap", "fallen");
+	for (i = 0; i < sizeof(setups_) / sizeof(setups_[0]); i++) run_(&setups_[i], build_column_);
+
+	printf("contact passes over the settled pyramid, one point at a time and in lanes\n");
+	printf("  %-16s %8s %12s %12s %11s\n", "pass", "points", "points(us)", "lanes(us)", "speedup");
+	print_passes_("velocity", OPUS_SOLVER_ITERATIVE);
+	print_passes_("soft sub-step", OPUS_SOLVER_SOFT_STEP);
+
+	return 0;
+}
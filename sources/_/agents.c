@@ -17,6 +17,7 @@
 
 #include "_/agents.h"
 #include "math/math.h"
+#include "math/math_inline.h"
 
 
 void agent_update_state(agent_t *agent, agent_steering_t steering, opus_real delta)
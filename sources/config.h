@@ -18,12 +18,20 @@
 extern "C" {
 #endif /* __cplusplus */
 
-/* the actual data type of "real" */
+/* the actual data type of "real", define OPUS_CONFIG_USE_FLOAT for a single precision build */
+#ifdef OPUS_CONFIG_USE_FLOAT
+#define OPUS_CONFIG_REAL float
+#define OPUS_CONFIG_REAL_MAX FLT_MAX
+#define OPUS_CONFIG_REAL_MIN FLT_MIN
+/* epsilon of data type "real" */
+#define OPUS_CONFIG_REAL_EPSILON FLT_EPSILON
+#else
 #define OPUS_CONFIG_REAL double
 #define OPUS_CONFIG_REAL_MAX DBL_MAX
 #define OPUS_CONFIG_REAL_MIN DBL_MIN
 /* epsilon of data type "real" */
 #define OPUS_CONFIG_REAL_EPSILON DBL_EPSILON
+#endif
 /* the prefix of all the functions and data types */
 #define OPUS_(name) opus_##name
 
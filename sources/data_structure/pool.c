@@ -0,0 +1,89 @@
+/**
+ * @file pool.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/3/28
+ *
+ * @example
+ *
+ * @development_log
+ *
+ */
+
+#include "data_structure/pool.h"
+#include "data_structure/array.h"
+
+/* the strictest alignment an element may need */
+typedef union pool_align_ {
+	void    *p;
+	double   d;
+	uint64_t u;
+} pool_align_;
+
+opus_pool *opus_pool_init(opus_pool *pool, uint64_t ele_size, uint64_t slab_size)
+{
+	if (pool) {
+		memset(pool, 0, sizeof(opus_pool));
+		ele_size        = ele_size < sizeof(pool_align_) ? sizeof(pool_align_) : ele_size;
+		pool->ele_size  = (ele_size + sizeof(pool_align_) - 1) / sizeof(pool_align_) * sizeof(pool_align_);
+		pool->slab_size = slab_size ? slab_size : OPUS_POOL_DEFAULT_SLAB_SIZE;
+		opus_arr_create(pool->slabs_, sizeof(void *));
+	}
+	return pool;
+}
+
+void opus_pool_done(opus_pool *pool)
+{
+	size_t i;
+	for (i = 0; i < opus_arr_len(pool->slabs_); i++) OPUS_FREE(pool->slabs_[i]);
+	opus_arr_destroy(pool->slabs_);
+	pool->slabs_ = NULL;
+	pool->free_  = NULL;
+}
+
+/* link the elements of a new slab into the free list, the first one is handed out first */
+static int pool_grow_(opus_pool *pool)
+{
+	char    *slab;
+	uint64_t i;
+
+	slab = OPUS_MALLOC(pool->ele_size * pool->slab_size);
+	if (!slab) return 0;
+	opus_arr_push(pool->slabs_, &slab);
+	pool->n_slab_allocs++;
+
+	for (i = pool->slab_size; i > 0; i--) {
+		*(void **) (slab + pool->ele_size * (i - 1)) = pool->free_;
+		pool->free_ = slab + pool->ele_size * (i - 1);
+	}
+	return 1;
+}
+
+/**
+ * @brief get an element, not initialized
+ * @param pool
+ * @return NULL if out of memory
+ */
+void *opus_pool_acquire(opus_pool *pool)
+{
+	void *ele;
+
+	if (!pool->free_ && !pool_grow_(pool)) return NULL;
+
+	ele         = pool->free_;
+	pool->free_ = *(void **) ele;
+	pool->n_used++;
+	pool->n_acquired++;
+	return ele;
+}
+
+void opus_pool_release(opus_pool *pool, void *ele)
+{
+	OPUS_RETURN_IF(, !ele);
+	*(void **) ele = pool->free_;
+	pool->free_    = ele;
+	pool->n_used--;
+	pool->n_released++;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file pool.h
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/3/28
+ *
+ * @example
+ *
+ * opus_pool pool;
+ * opus_pool_init(&pool, sizeof(my_struct), 256);
+ * my_struct *p = opus_pool_acquire(&pool);
+ * opus_pool_release(&pool, p);
+ * opus_pool_done(&pool);
+ *
+ * @brief fixed size elements carved out of big slabs, released elements go to a free list
+ * 		and are reused before any new slab is allocated. Slabs are only freed all at once in
+ * 		"opus_pool_done", so a pool at its peak size never calls the system allocator again.
+ *
+ * @development_log
+ *
+ */
+#ifndef POOL_H
+#define POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "utils/utils.h"
+
+#define OPUS_POOL_DEFAULT_SLAB_SIZE (256)
+
+typedef struct opus_pool opus_pool;
+
+struct opus_pool {
+	uint64_t ele_size;  /* rounded up so that every element is aligned */
+	uint64_t slab_size; /* elements per slab */
+
+	void **slabs_; /* opus_arr of the slabs */
+	void  *free_;  /* free elements, linked through their first bytes */
+
+	/* counters, never reset */
+	uint64_t n_used;        /* elements acquired and not released yet */
+	uint64_t n_acquired;    /* calls to "opus_pool_acquire" */
+	uint64_t n_released;    /* calls to "opus_pool_release" */
+	uint64_t n_slab_allocs; /* calls to the system allocator */
+};
+
+opus_pool *opus_pool_init(opus_pool *pool, uint64_t ele_size, uint64_t slab_size);
+void       opus_pool_done(opus_pool *pool);
+void      *opus_pool_acquire(opus_pool *pool);
+void       opus_pool_release(opus_pool *pool, void *ele);
+
+#ifdef __cplusplus
+};
+#endif /* __cplusplus */
+
+#endif /* POOL_H */
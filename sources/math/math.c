@@ -569,7 +569,7 @@ uint8_t opus_mat_lup(opus_real *A, opus_real *LU, uint8_t *P, uint16_t n)
 		ind_max = i;
 		for (j = i + 1; j < n; ++j)
 			if (opus_abs(LU[n * P[j] + i]) > opus_abs(LU[n * P[ind_max] + i]))
-				//			if (r_abs(ele__(LU, n, P[j], i)) > r_abs(ele__(LU, n, P[ind_max], i)))
+				/*			if (r_abs(ele__(LU, n, P[j], i)) > r_abs(ele__(LU, n, P[ind_max], i))) */
 				ind_max = j;
 
 		tmp_int    = P[i];
@@ -1074,3 +1074,82 @@ void opus_mat2d_copy(opus_mat2d dst, opus_mat2d src)
 	dst[4] = src[4];
 	dst[5] = src[5];
 }
+
+/**
+ * @brief rotate by "rotation" then translate to "position"
+ * @param t
+ * @param rotation
+ * @param position
+ */
+void opus_transform_set(opus_transform *t, opus_real rotation, opus_vec2 position)
+{
+	t->c = opus_cos(rotation);
+	t->s = opus_sin(rotation);
+	t->p = position;
+}
+
+/**
+ * @brief local to world
+ * @param t
+ * @param v
+ * @return
+ */
+opus_vec2 opus_transform_apply(opus_transform *t, opus_vec2 v)
+{
+	opus_vec2 r;
+	r.x = t->c * v.x - t->s * v.y + t->p.x;
+	r.y = t->s * v.x + t->c * v.y + t->p.y;
+	return r;
+}
+
+/**
+ * @brief world to local
+ * @param t
+ * @param v
+ * @return
+ */
+opus_vec2 opus_transform_apply_inv(opus_transform *t, opus_vec2 v)
+{
+	opus_vec2 r;
+	opus_real x = v.x - t->p.x, y = v.y - t->p.y;
+	r.x = t->c * x + t->s * y;
+	r.y = -t->s * x + t->c * y;
+	return r;
+}
+
+/**
+ * @brief rotation only, for directions
+ * @param t
+ * @param v
+ * @return
+ */
+opus_vec2 opus_transform_rotate(opus_transform *t, opus_vec2 v)
+{
+	opus_vec2 r;
+	r.x = t->c * v.x - t->s * v.y;
+	r.y = t->s * v.x + t->c * v.y;
+	return r;
+}
+
+opus_vec2 opus_transform_rotate_inv(opus_transform *t, opus_vec2 v)
+{
+	opus_vec2 r;
+	r.x = t->c * v.x + t->s * v.y;
+	r.y = -t->s * v.x + t->c * v.y;
+	return r;
+}
+
+/**
+ * @brief the same transform as a float matrix, for rendering
+ * @param t
+ * @param mat
+ */
+void opus_transform_to_mat2d(opus_transform *t, opus_mat2d mat)
+{
+	mat[0] = (float) t->c;
+	mat[1] = (float) t->s;
+	mat[2] = (float) -t->s;
+	mat[3] = (float) t->c;
+	mat[4] = (float) t->p.x;
+	mat[5] = (float) t->p.y;
+}
@@ -19,11 +19,12 @@ extern "C" {
 #include <stdlib.h>
 #include "config.h"
 
-typedef OPUS_CONFIG_REAL opus_real;
-typedef struct opus_vec2 opus_vec2;
-typedef struct opus_vec3 opus_vec3;
-typedef struct opus_vec4 opus_vec4;
-typedef float            opus_mat2d[6];
+typedef OPUS_CONFIG_REAL      opus_real;
+typedef struct opus_vec2      opus_vec2;
+typedef struct opus_vec3      opus_vec3;
+typedef struct opus_vec4      opus_vec4;
+typedef float                 opus_mat2d[6];
+typedef struct opus_transform opus_transform;
 
 struct opus_vec2 {
 	opus_real x, y;
@@ -37,16 +38,29 @@ struct opus_vec4 {
 	opus_real x, y, z, w;
 };
 
+/**
+ * @brief rotation kept as its cosine and sine, then translation, at full precision
+ */
+struct opus_transform {
+	opus_vec2 p;
+	opus_real c, s;
+};
+
 #define OPUS_REAL_MAX OPUS_CONFIG_REAL_MAX
 #define OPUS_REAL_MIN OPUS_CONFIG_REAL_MIN
 #define OPUS_REAL_EPSILON OPUS_CONFIG_REAL_EPSILON
 
+/* strict C90 headers do not define it */
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 #define OPUS_PI ((opus_real) M_PI)
 #define OPUS_PI2 (OPUS_PI * OPUS_PI)
 
 #define OPUS_MAX_STATIC_MATRIX_DIMENSION (15)
 
-// opus_real opus_random(opus_real n) { return r_xrand() % n; }
+/* opus_real opus_random(opus_real n) { return r_xrand() % n; } */
 
 
 opus_vec2 opus_vec2_(opus_real x, opus_real y);
@@ -173,6 +187,13 @@ void      opus_mar2d_pre_mul_xy(opus_real *dx, opus_real *dy, const opus_mat2d m
 opus_vec2 opus_mat2d_pre_mul_vec(opus_mat2d mat, opus_vec2 src);
 void      opus_mat2d_copy(opus_mat2d dst, opus_mat2d src);
 
+void      opus_transform_set(opus_transform *t, opus_real rotation, opus_vec2 position);
+opus_vec2 opus_transform_apply(opus_transform *t, opus_vec2 v);
+opus_vec2 opus_transform_apply_inv(opus_transform *t, opus_vec2 v);
+opus_vec2 opus_transform_rotate(opus_transform *t, opus_vec2 v);
+opus_vec2 opus_transform_rotate_inv(opus_transform *t, opus_vec2 v);
+void      opus_transform_to_mat2d(opus_transform *t, opus_mat2d mat);
+
 #ifdef __cplusplus
 };
 #endif /* __cplusplus */
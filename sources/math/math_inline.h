@@ -0,0 +1,218 @@
+/**
+ * @file math_inline.h
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/4/5
+ *
+ * @example
+ *
+ * #include "math/math.h"
+ * #include "math/math_inline.h"
+ *
+ * opus_vec2_add(a, b);   inline
+ * (opus_vec2_add)(a, b); the function of math.c
+ *
+ * @brief the small vec2, mat2d and scalar helpers of math.h as static inline functions,
+ * 		for the translation units with hot loops (the physics, the polygons, the agents).
+ * 		After this header a call of one of them is expanded in place instead of going to
+ * 		math.c, which is a call the compiler can not see through without LTO. The names
+ * 		and the arithmetic do not change, so neither do the results. Define
+ * 		OPUS_MATH_NO_INLINE to turn it off, for debugging or to compare.
+ *
+ */
+#ifndef MATH_INLINE_H
+#define MATH_INLINE_H
+
+#include "math/math.h"
+#include "utils/utils.h"
+
+#ifndef OPUS_MATH_NO_INLINE
+
+static OPUS_INLINE opus_real opus_max_inline_(opus_real a, opus_real b) { return a > b ? a : b; }
+
+static OPUS_INLINE opus_real opus_min_inline_(opus_real a, opus_real b) { return a < b ? a : b; }
+
+static OPUS_INLINE int opus_max_i_inline_(int a, int b) { return a > b ? a : b; }
+
+static OPUS_INLINE int opus_min_i_inline_(int a, int b) { return a < b ? a : b; }
+
+static OPUS_INLINE opus_real opus_abs_inline_(opus_real x) { return x < 0 ? -x : x; }
+
+static OPUS_INLINE int opus_sign_inline_(opus_real a) { return (a > 0 ? 1 : (a < 0 ? -1 : 0)); }
+
+static OPUS_INLINE opus_real opus_clamp_inline_(opus_real num, opus_real min, opus_real max)
+{
+	return opus_max_inline_(min, opus_min_inline_(num, max));
+}
+
+static OPUS_INLINE opus_real opus_sqrt_inline_(opus_real x) { return (opus_real) sqrt((double) x); }
+
+static OPUS_INLINE opus_real opus_pow2_inline_(opus_real x) { return x * x; }
+
+static OPUS_INLINE opus_real opus_hypot2_inline_(opus_real a, opus_real b) { return a * a + b * b; }
+
+static OPUS_INLINE opus_real opus_hypot_inline_(opus_real a, opus_real b) { return opus_sqrt_inline_(a * a + b * b); }
+
+static OPUS_INLINE int opus_fuzzy_equal_inline_(opus_real a, opus_real b, opus_real epsilon)
+{
+	return opus_abs_inline_(a - b) < epsilon;
+}
+
+static OPUS_INLINE int opus_equal_inline_(opus_real a, opus_real b)
+{
+	return opus_abs_inline_(a - b) < OPUS_REAL_EPSILON;
+}
+
+static OPUS_INLINE opus_vec2 opus_vec2_inline_(opus_real x, opus_real y)
+{
+	opus_vec2 v;
+	v.x = x;
+	v.y = y;
+	return v;
+}
+
+static OPUS_INLINE int opus_vec2_equal_inline_(opus_vec2 a, opus_vec2 b, opus_real epsilon)
+{
+	return opus_abs_inline_(a.x - b.x) < epsilon && opus_abs_inline_(a.y - b.y) < epsilon;
+}
+
+static OPUS_INLINE opus_vec2 opus_vec2_add_inline_(opus_vec2 a, opus_vec2 b)
+{
+	return opus_vec2_inline_(a.x + b.x, a.y + b.y);
+}
+
+static OPUS_INLINE opus_vec2 opus_vec2_sub_inline_(opus_vec2 a, opus_vec2 b)
+{
+	return opus_vec2_inline_(a.x - b.x, a.y - b.y);
+}
+
+static OPUS_INLINE opus_vec2 opus_vec2_to_inline_(opus_vec2 a, opus_vec2 to)
+{
+	return opus_vec2_inline_(to.x - a.x, to.y - a.y);
+}
+
+static OPUS_INLINE opus_vec2 opus_vec2_scale_inline_(opus_vec2 a, opus_real scalar)
+{
+	return opus_vec2_inline_(a.x * scalar, a.y * scalar);
+}
+
+static OPUS_INLINE opus_real opus_vec2_dot_inline_(opus_vec2 a, opus_vec2 b) { return a.x * b.x + a.y * b.y; }
+
+static OPUS_INLINE opus_real opus_vec2_cross_inline_(opus_vec2 a, opus_vec2 b) { return a.x * b.y - b.x * a.y; }
+
+static OPUS_INLINE opus_real opus_vec2_len2_inline_(opus_vec2 a) { return a.x * a.x + a.y * a.y; }
+
+static OPUS_INLINE opus_real opus_vec2_len_inline_(opus_vec2 a) { return opus_sqrt_inline_(a.x * a.x + a.y * a.y); }
+
+/* "opus_inv_sqrt" is a plain division */
+static OPUS_INLINE opus_vec2 opus_vec2_norm_inline_(opus_vec2 a)
+{
+	return opus_vec2_scale_inline_(a, 1 / opus_sqrt_inline_(a.x * a.x + a.y * a.y));
+}
+
+static OPUS_INLINE opus_vec2 opus_vec2_neg_inline_(opus_vec2 a) { return opus_vec2_inline_(-a.x, -a.y); }
+
+static OPUS_INLINE opus_vec2 opus_vec2_perp_inline_(opus_vec2 v) { return opus_vec2_inline_(v.y, -v.x); }
+
+static OPUS_INLINE opus_vec2 opus_vec2_skew_inline_(opus_vec2 v) { return opus_vec2_inline_(-v.y, v.x); }
+
+static OPUS_INLINE opus_real opus_vec2_dist2_inline_(opus_vec2 a, opus_vec2 b)
+{
+	opus_vec2 c = opus_vec2_sub_inline_(a, b);
+	return c.x * c.x + c.y * c.y;
+}
+
+static OPUS_INLINE opus_real opus_vec2_cross3_inline_(opus_vec2 a, opus_vec2 b, opus_vec2 c)
+{
+	return ((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x));
+}
+
+static OPUS_INLINE opus_vec2 opus_mat2d_pre_mul_vec_inline_(const opus_mat2d mat, opus_vec2 src)
+{
+	opus_vec2 p;
+	p.x = src.x * mat[0] + src.y * mat[2] + mat[4];
+	p.y = src.x * mat[1] + src.y * mat[3] + mat[5];
+	return p;
+}
+
+static OPUS_INLINE opus_vec2 opus_transform_apply_inline_(opus_transform *t, opus_vec2 v)
+{
+	opus_vec2 r;
+	r.x = t->c * v.x - t->s * v.y + t->p.x;
+	r.y = t->s * v.x + t->c * v.y + t->p.y;
+	return r;
+}
+
+static OPUS_INLINE opus_vec2 opus_transform_apply_inv_inline_(opus_transform *t, opus_vec2 v)
+{
+	opus_vec2 r;
+	opus_real x = v.x - t->p.x, y = v.y - t->p.y;
+	r.x = t->c * x + t->s * y;
+	r.y = -t->s * x + t->c * y;
+	return r;
+}
+
+static OPUS_INLINE opus_vec2 opus_transform_rotate_inline_(opus_transform *t, opus_vec2 v)
+{
+	opus_vec2 r;
+	r.x = t->c * v.x - t->s * v.y;
+	r.y = t->s * v.x + t->c * v.y;
+	return r;
+}
+
+static OPUS_INLINE opus_vec2 opus_transform_rotate_inv_inline_(opus_transform *t, opus_vec2 v)
+{
+	opus_vec2 r;
+	r.x = t->c * v.x + t->s * v.y;
+	r.y = -t->s * v.x + t->c * v.y;
+	return r;
+}
+
+/* function-like, so that "(name)(...)" and "&name" still mean the function of math.c */
+#define opus_max(a, b) opus_max_inline_(a, b)
+#define opus_min(a, b) opus_min_inline_(a, b)
+#define opus_max_i(a, b) opus_max_i_inline_(a, b)
+#define opus_min_i(a, b) opus_min_i_inline_(a, b)
+#define opus_abs(x) opus_abs_inline_(x)
+#define opus_sign(a) opus_sign_inline_(a)
+#define opus_clamp(num, min, max) opus_clamp_inline_(num, min, max)
+#define opus_sqrt(x) opus_sqrt_inline_(x)
+#define opus_pow2(x) opus_pow2_inline_(x)
+#define opus_hypot2(a, b) opus_hypot2_inline_(a, b)
+#define opus_hypot(a, b) opus_hypot_inline_(a, b)
+#define opus_fuzzy_equal(a, b, epsilon) opus_fuzzy_equal_inline_(a, b, epsilon)
+#define opus_equal(a, b) opus_equal_inline_(a, b)
+
+#define opus_vec2_(x, y) opus_vec2_inline_(x, y)
+#define opus_vec2_equal_(a, b, epsilon) opus_vec2_equal_inline_(a, b, epsilon)
+#define opus_vec2_equal(a, b) opus_vec2_equal_inline_(a, b, OPUS_REAL_EPSILON)
+#define opus_vec2_add(a, b) opus_vec2_add_inline_(a, b)
+#define opus_vec2_sub(a, b) opus_vec2_sub_inline_(a, b)
+#define opus_vec2_to(a, to) opus_vec2_to_inline_(a, to)
+#define opus_vec2_scale(a, scalar) opus_vec2_scale_inline_(a, scalar)
+#define opus_vec2_dot(a, b) opus_vec2_dot_inline_(a, b)
+#define opus_vec2_cross(a, b) opus_vec2_cross_inline_(a, b)
+#define opus_vec2_len2(a) opus_vec2_len2_inline_(a)
+#define opus_vec2_len(a) opus_vec2_len_inline_(a)
+#define opus_vec2_get_length(a) opus_vec2_len_inline_(a)
+#define opus_vec2_norm(a) opus_vec2_norm_inline_(a)
+#define opus_vec2_neg(a) opus_vec2_neg_inline_(a)
+#define opus_vec2_inv(a) opus_vec2_neg_inline_(a)
+#define opus_vec2_perp(v) opus_vec2_perp_inline_(v)
+#define opus_vec2_skewT(v) opus_vec2_perp_inline_(v)
+#define opus_vec2_skew(v) opus_vec2_skew_inline_(v)
+#define opus_vec2_dist2(a, b) opus_vec2_dist2_inline_(a, b)
+#define opus_vec2_dist(a, b) opus_sqrt_inline_(opus_vec2_dist2_inline_(a, b))
+#define opus_vec2_cross3(a, b, c) opus_vec2_cross3_inline_(a, b, c)
+
+#define opus_mat2d_pre_mul_vec(mat, src) opus_mat2d_pre_mul_vec_inline_(mat, src)
+#define opus_transform_apply(t, v) opus_transform_apply_inline_(t, v)
+#define opus_transform_apply_inv(t, v) opus_transform_apply_inv_inline_(t, v)
+#define opus_transform_rotate(t, v) opus_transform_rotate_inline_(t, v)
+#define opus_transform_rotate_inv(t, v) opus_transform_rotate_inv_inline_(t, v)
+
+#endif /* OPUS_MATH_NO_INLINE */
+
+#endif /* MATH_INLINE_H */
@@ -17,6 +17,7 @@
 #include "utils/utils.h"
 #include "data_structure/array.h"
 #include "math/polygon/polygon.h"
+#include "math/math_inline.h"
 
 static opus_vec2 center__;
 static ptrdiff_t coord_offset__ = 0;
@@ -9,105 +9,305 @@
  * @example
  *
  * @development_log
+ * 		2023/3/22: nodes are stored in a pool and referenced by index, leaves keep fat aabbs
+ * 			and overlapping pairs are cached across steps
  *
  */
 
+#include <stddef.h>
+#include <string.h>
 #include "data_structure/array.h"
 #include "physics/opus/physics.h"
 #include "physics/opus/physics_private.h"
 
-static void opus_bvh_draw_internal(plutovg_t *pluto, opus_bvh_leaf *node, int flag)
+#define BVH_NULL (-1)
+#define BVH_SAH_BINS (16)
+
+static void opus_bvh_draw_internal(opus_debug_cmd **cmds, opus_bvh *bvh, int index, uint32_t color)
 {
-	if (node) {
-		if (!node->is_leaf) opus_bvh_draw_internal(pluto, node->left, 0);
-		plutovg_rect(pluto, node->aabb.min.x, node->aabb.min.y, node->aabb.max.x - node->aabb.min.x, node->aabb.max.y - node->aabb.min.y);
-		plutovg_stroke(pluto);
-		if (!node->is_leaf) opus_bvh_draw_internal(pluto, node->right, 1);
+	opus_bvh_node *node;
+	if (index != BVH_NULL) {
+		node = &bvh->nodes[index];
+		if (node->height > 0) opus_bvh_draw_internal(cmds, bvh, node->left, color);
+		opus_debug_draw_rect(cmds, node->aabb.min, node->aabb.max, 2, color);
+		if (node->height > 0) opus_bvh_draw_internal(cmds, bvh, node->right, color);
 	}
 }
 
-/* This function assumes that the type of "body" is "body_t *" defined in "physics.h" */
-static void bvh_get_body_aabb_default_(opus_aabb *aabb, void *b, int type)
+/* the field of the body keeping its leaf index */
+static int *bvh_proxy_(opus_bvh *bvh, opus_body *body)
+{
+	return (int *) ((char *) body + bvh->proxy_offset);
+}
+
+/* whether aabb "a" contains aabb "b" */
+static int bvh_aabb_contain_(opus_aabb *a, opus_aabb *b)
+{
+	return a->min.x <= b->min.x && a->min.y <= b->min.y && b->max.x <= a->max.x && b->max.y <= a->max.y;
+}
+
+/**
+ * @brief enlarge the bound of the body by the margin, and extend it in the direction
+ * 		the body is moving, so that the leaf stays valid for the next few steps
+ */
+static void bvh_fatten_(opus_bvh *bvh, opus_body *body, opus_real dt, opus_aabb *fat)
 {
-	opus_body *body;
-	body  = b;
-	*aabb = body->shape->bound;
+	opus_vec2 d;
+
+	*fat = body->shape->bound;
+	fat->min.x -= bvh->margin;
+	fat->min.y -= bvh->margin;
+	fat->max.x += bvh->margin;
+	fat->max.y += bvh->margin;
+
+	d = opus_vec2_scale(body->velocity, dt * bvh->velocity_factor);
+	if (d.x < 0) fat->min.x += d.x;
+	else fat->max.x += d.x;
+	if (d.y < 0) fat->min.y += d.y;
+	else fat->max.y += d.y;
 }
 
 static void opus_bvh_init(opus_bvh *bvh)
 {
-	bvh->hierarchy  = NULL;
-	bvh->leaf_count = 0;
+	int i;
+
+	bvh->root            = BVH_NULL;
+	bvh->leaf_count      = 0;
+	bvh->n_nodes         = 0;
+	bvh->capacity        = 16;
+	bvh->margin          = 2;
+	bvh->velocity_factor = 2;
+	bvh->proxy_offset    = offsetof(opus_body, proxy_id);
+
+	/* all the nodes are linked in the free list */
+	bvh->nodes = OPUS_CALLOC(bvh->capacity, sizeof(opus_bvh_node));
+	for (i = 0; i < bvh->capacity; i++) {
+		bvh->nodes[i].parent = i + 1;
+		bvh->nodes[i].height = -1;
+	}
+	bvh->nodes[bvh->capacity - 1].parent = BVH_NULL;
+	bvh->free_list                       = 0;
 
-	opus_arr_create(bvh->bodies, sizeof(opus_body));
+	opus_arr_create(bvh->moved_, sizeof(int));
+	opus_arr_create(bvh->stack_, sizeof(int));
+	opus_pair_cache_init(&bvh->pairs, 0);
 }
 
 opus_bvh *opus_bvh_create(void)
 {
-	opus_bvh *tree = (opus_bvh *) malloc(sizeof(opus_bvh));
-	opus_bvh_init(tree);
+	opus_bvh *tree = (opus_bvh *) OPUS_MALLOC(sizeof(opus_bvh));
+	if (tree) opus_bvh_init(tree);
 
 	return tree;
 }
 
-static void opus_bvh_destroy_hierarchy(opus_bvh_leaf *node)
+void opus_bvh_destroy(opus_bvh *bvh)
 {
-	if (node) {
-		if (!node->is_leaf) {
-			opus_bvh_destroy_hierarchy(node->left);
-			opus_bvh_destroy_hierarchy(node->right);
-		}
-		free(node);
-	}
+	int i;
+	for (i = 0; i < bvh->capacity; i++)
+		if (bvh->nodes[i].height == 0) *bvh_proxy_(bvh, bvh->nodes[i].body) = -1;
+
+	opus_pair_cache_done(&bvh->pairs);
+	opus_arr_destroy(bvh->stack_);
+	opus_arr_destroy(bvh->moved_);
+	OPUS_FREE(bvh->nodes);
+	OPUS_FREE(bvh);
 }
 
-void opus_bvh_destroy(opus_bvh *bvh)
+/**
+ * @brief take a node from the free list, the pool grows when the free list is empty,
+ * 		so pointers to the nodes are not valid after calling this
+ */
+static int bvh_node_allocate_(opus_bvh *bvh)
 {
-	opus_bvh_destroy_hierarchy(bvh->hierarchy);
-	bvh->hierarchy = NULL;
+	int            i, index;
+	opus_bvh_node *node;
+
+	if (bvh->free_list == BVH_NULL) {
+		OPUS_ASSERT(bvh->n_nodes == bvh->capacity);
+
+		bvh->nodes = OPUS_REALLOC(bvh->nodes, sizeof(opus_bvh_node) * bvh->capacity * 2);
+		memset(bvh->nodes + bvh->capacity, 0, sizeof(opus_bvh_node) * bvh->capacity);
+		for (i = bvh->capacity; i < bvh->capacity * 2; i++) {
+			bvh->nodes[i].parent = i + 1;
+			bvh->nodes[i].height = -1;
+		}
+		bvh->nodes[bvh->capacity * 2 - 1].parent = BVH_NULL;
+		bvh->free_list                           = bvh->capacity;
+		bvh->capacity *= 2;
+	}
 
-	opus_arr_destroy(bvh->bodies);
-	free(bvh);
+	index          = bvh->free_list;
+	node           = &bvh->nodes[index];
+	bvh->free_list = node->parent;
+	node->parent   = BVH_NULL;
+	node->left     = BVH_NULL;
+	node->right    = BVH_NULL;
+	node->height   = 0;
+	node->body     = NULL;
+	node->moved    = 0;
+	bvh->n_nodes++;
+
+	return index;
 }
 
-static void bvh_node_init(opus_bvh_leaf *node)
+static void bvh_node_free_(opus_bvh *bvh, int index)
 {
-	node->is_leaf = 0;
-	node->left    = NULL;
-	node->right   = NULL;
-	node->parent  = NULL;
-	node->height  = 1;
+	OPUS_ASSERT(0 <= index && index < bvh->capacity);
+	bvh->nodes[index].parent = bvh->free_list;
+	bvh->nodes[index].height = -1;
+	bvh->nodes[index].body   = NULL;
+	bvh->free_list           = index;
+	bvh->n_nodes--;
 }
 
-static opus_bvh_leaf *bvh_node_create(void)
+/**
+ * @brief build the subtree of leaves[begin, end) top-down, splitting at the best of the
+ * 		binned surface area (perimeter in 2D) heuristic along the longest centroid axis
+ * @return index of the root of the subtree
+ */
+static int bvh_build_SAH_(opus_bvh *bvh, int *leaves, int begin, int end)
 {
-	opus_bvh_leaf *node = (opus_bvh_leaf *) malloc(sizeof(opus_bvh_leaf));
-	bvh_node_init(node);
+	struct {
+		opus_aabb aabb;
+		int       count;
+	} bins[BVH_SAH_BINS];
+
+	opus_aabb right_aabbs[BVH_SAH_BINS];
+	int       right_counts[BVH_SAH_BINS];
+
+	opus_aabb  aabb, left_aabb;
+	opus_vec2  c, c_min, c_max;
+	opus_real  extent, lo, cost, best_cost;
+	int        i, j, k, b, axis, best_split, left_count, index, left, right;
+	opus_aabb *la;
+
+	if (end - begin == 1) return leaves[begin];
+
+	/* bound of the leaf centroids, leaves are split along its longest axis */
+	la    = &bvh->nodes[leaves[begin]].aabb;
+	c_min = c_max = opus_vec2_(0.5 * (la->min.x + la->max.x), 0.5 * (la->min.y + la->max.y));
+	for (i = begin + 1; i < end; i++) {
+		la      = &bvh->nodes[leaves[i]].aabb;
+		c       = opus_vec2_(0.5 * (la->min.x + la->max.x), 0.5 * (la->min.y + la->max.y));
+		c_min.x = opus_min(c_min.x, c.x);
+		c_min.y = opus_min(c_min.y, c.y);
+		c_max.x = opus_max(c_max.x, c.x);
+		c_max.y = opus_max(c_max.y, c.y);
+	}
+	axis   = c_max.x - c_min.x >= c_max.y - c_min.y ? 0 : 1;
+	lo     = axis == 0 ? c_min.x : c_min.y;
+	extent = axis == 0 ? c_max.x - c_min.x : c_max.y - c_min.y;
+
+	best_split = -1;
+	if (extent > 0) {
+		for (b = 0; b < BVH_SAH_BINS; b++) bins[b].count = 0;
+		for (i = begin; i < end; i++) {
+			la = &bvh->nodes[leaves[i]].aabb;
+			c  = opus_vec2_(0.5 * (la->min.x + la->max.x), 0.5 * (la->min.y + la->max.y));
+			b  = (int) (((axis == 0 ? c.x : c.y) - lo) / extent * BVH_SAH_BINS);
+			if (b >= BVH_SAH_BINS) b = BVH_SAH_BINS - 1;
+			if (bins[b].count++ == 0) bins[b].aabb = *la;
+			else opus_aabb_combine(&bins[b].aabb, la, &bins[b].aabb);
+		}
 
-	return node;
-}
+		/* sweep from the right to get the bound of bins[b..], then from the left to evaluate splits */
+		k = 0;
+		for (b = BVH_SAH_BINS - 1; b > 0; b--) {
+			if (bins[b].count) {
+				if (k == 0) aabb = bins[b].aabb;
+				else opus_aabb_combine(&aabb, &bins[b].aabb, &aabb);
+			}
+			k += bins[b].count;
+			right_aabbs[b]  = aabb;
+			right_counts[b] = k;
+		}
 
-static void bvh_node_destroy(opus_bvh_leaf *node)
-{
-	free(node);
+		best_cost  = 0;
+		left_count = 0;
+		for (b = 1; b < BVH_SAH_BINS; b++) {
+			if (bins[b - 1].count) {
+				if (left_count == 0) left_aabb = bins[b - 1].aabb;
+				else opus_aabb_combine(&left_aabb, &bins[b - 1].aabb, &left_aabb);
+			}
+			left_count += bins[b - 1].count;
+			if (left_count == 0 || right_counts[b] == 0) continue;
+
+			cost = opus_aabb_perimeter(&left_aabb) * left_count + opus_aabb_perimeter(&right_aabbs[b]) * right_counts[b];
+			if (best_split < 0 || cost < best_cost) {
+				best_cost  = cost;
+				best_split = b;
+			}
+		}
+	}
+
+	if (best_split < 0) {
+		/* all the centroids are at the same place */
+		k = begin + (end - begin) / 2;
+	} else {
+		/* partition the leaves in place by their bin */
+		j = begin;
+		for (i = begin; i < end; i++) {
+			la = &bvh->nodes[leaves[i]].aabb;
+			c  = opus_vec2_(0.5 * (la->min.x + la->max.x), 0.5 * (la->min.y + la->max.y));
+			b  = (int) (((axis == 0 ? c.x : c.y) - lo) / extent * BVH_SAH_BINS);
+			if (b >= BVH_SAH_BINS) b = BVH_SAH_BINS - 1;
+			if (b < best_split) {
+				index     = leaves[i];
+				leaves[i] = leaves[j];
+				leaves[j] = index;
+				j++;
+			}
+		}
+		k = j;
+	}
+
+	left  = bvh_build_SAH_(bvh, leaves, begin, k);
+	right = bvh_build_SAH_(bvh, leaves, k, end);
+	index = bvh_node_allocate_(bvh);
+
+	bvh->nodes[index].left    = left;
+	bvh->nodes[index].right   = right;
+	bvh->nodes[index].height  = 1 + opus_max(bvh->nodes[left].height, bvh->nodes[right].height);
+	bvh->nodes[left].parent   = index;
+	bvh->nodes[right].parent  = index;
+	opus_aabb_combine(&bvh->nodes[left].aabb, &bvh->nodes[right].aabb, &bvh->nodes[index].aabb);
+
+	return index;
 }
 
 /**
- * build from scratch using surface area heuristic
+ * build from scratch using surface area heuristic, useful after loading a level since
+ * 		incremental insertion builds a worse tree. Leaves keep their index, so the proxy
+ * 		ids of the bodies and the cached pairs stay valid.
  * @param bvh
  */
 void opus_bvh_build_SAH(opus_bvh *bvh)
 {
-	/* TODO: finish this (top-down method) */
+	int i, n, *leaves;
+
+	OPUS_RETURN_IF(, bvh->leaf_count == 0);
+
+	/* keep the leaves, and throw all the interior nodes back into the pool */
+	leaves = OPUS_MALLOC(sizeof(int) * bvh->leaf_count);
+	for (i = 0, n = 0; i < bvh->capacity; i++) {
+		if (bvh->nodes[i].height == 0) {
+			leaves[n++]          = i;
+			bvh->nodes[i].parent = BVH_NULL;
+		} else if (bvh->nodes[i].height > 0) {
+			bvh_node_free_(bvh, i);
+		}
+	}
+	OPUS_ASSERT(n == bvh->leaf_count);
+
+	bvh->root = bvh_build_SAH_(bvh, leaves, 0, bvh->leaf_count);
+	OPUS_FREE(leaves);
 }
 
-void opus_bvh_render(plutovg_t *pluto, opus_bvh *bvh)
+/* every node from the left to the right, into an opus_arr of opus_debug_cmd */
+void opus_bvh_debug_draw(opus_bvh *bvh, opus_debug_cmd **cmds, uint32_t color)
 {
-	if (bvh->hierarchy) {
-		plutovg_set_source_rgba(pluto, 0.3f, 0.4f, 0.5f, 0.3f);
-		plutovg_set_line_width(pluto, 2.f);
-		opus_bvh_draw_internal(pluto, bvh->hierarchy, 1);
-	}
+	opus_bvh_draw_internal(cmds, bvh, bvh->root, color);
 }
 
 /**
@@ -116,59 +316,64 @@ void opus_bvh_render(plutovg_t *pluto, opus_bvh *bvh)
  * @param index_node
  * @return  the new node whose location is the index_node you input
  */
-static opus_bvh_leaf *opus_bvh_balance_tree(opus_bvh *bvh, opus_bvh_leaf *index_node)
+static int opus_bvh_balance_tree(opus_bvh *bvh, int index_node)
 {
-	int              balance;
-	opus_bvh_leaf   *A, *B, *C;
+	int            balance, iB, iC;
+	opus_bvh_node *A, *B, *C, *nodes;
 
-	OPUS_ASSERT(index_node != NULL);
+	OPUS_ASSERT(index_node != BVH_NULL);
 
-	A = index_node;
-	if (A->is_leaf || A->height < 2) {
-		return A;
+	nodes = bvh->nodes;
+	A     = &nodes[index_node];
+	if (A->height < 2) {
+		return index_node;
 	}
 
-	B = A->left;
-	C = A->right;
+	iB = A->left;
+	iC = A->right;
+	B  = &nodes[iB];
+	C  = &nodes[iC];
 
 	balance = C->height - B->height;
 
 	/* Rotate C up */
 	if (balance > 1) {
-		opus_bvh_leaf *F = C->left;
-		opus_bvh_leaf *G = C->right;
+		int            iF = C->left;
+		int            iG = C->right;
+		opus_bvh_node *F  = &nodes[iF];
+		opus_bvh_node *G  = &nodes[iG];
 
 		/* Swap A and C */
-		C->left   = A;
+		C->left   = index_node;
 		C->parent = A->parent;
-		A->parent = C;
+		A->parent = iC;
 
 		/* A's old parent should point to C */
-		if (C->parent != NULL) {
-			if (C->parent->left == A) {
-				C->parent->left = C;
+		if (C->parent != BVH_NULL) {
+			if (nodes[C->parent].left == index_node) {
+				nodes[C->parent].left = iC;
 			} else {
-				OPUS_ASSERT(C->parent->right == A);
-				C->parent->right = C;
+				OPUS_ASSERT(nodes[C->parent].right == index_node);
+				nodes[C->parent].right = iC;
 			}
 		} else {
-			bvh->hierarchy = C;
+			bvh->root = iC;
 		}
 
 		/* Rotate */
 		if (F->height > G->height) {
-			C->right  = F;
-			A->right  = G;
-			G->parent = A;
+			C->right  = iF;
+			A->right  = iG;
+			G->parent = index_node;
 			opus_aabb_combine(&(B->aabb), &(G->aabb), &(A->aabb));
 			opus_aabb_combine(&(A->aabb), &(F->aabb), &(C->aabb));
 
 			A->height = 1 + opus_max(B->height, G->height);
 			C->height = 1 + opus_max(A->height, F->height);
 		} else {
-			C->right  = G;
-			A->right  = F;
-			F->parent = A;
+			C->right  = iG;
+			A->right  = iF;
+			F->parent = index_node;
 			opus_aabb_combine(&(B->aabb), &(F->aabb), &(A->aabb));
 			opus_aabb_combine(&(A->aabb), &(G->aabb), &(C->aabb));
 
@@ -176,45 +381,47 @@ static opus_bvh_leaf *opus_bvh_balance_tree(opus_bvh *bvh, opus_bvh_leaf *index_
 			C->height = 1 + opus_max(A->height, G->height);
 		}
 
-		return C;
+		return iC;
 	}
 
 	/* Rotate B up */
 	if (balance < -1) {
-		opus_bvh_leaf *D = B->left;
-		opus_bvh_leaf *E = B->right;
+		int            iD = B->left;
+		int            iE = B->right;
+		opus_bvh_node *D  = &nodes[iD];
+		opus_bvh_node *E  = &nodes[iE];
 
 		/* Swap A and B */
-		B->left   = A;
+		B->left   = index_node;
 		B->parent = A->parent;
-		A->parent = B;
+		A->parent = iB;
 
 		/* A's old parent should point to B */
-		if (B->parent != NULL) {
-			if (B->parent->left == A) {
-				B->parent->left = B;
+		if (B->parent != BVH_NULL) {
+			if (nodes[B->parent].left == index_node) {
+				nodes[B->parent].left = iB;
 			} else {
-				OPUS_ASSERT(B->parent->right == A);
-				B->parent->right = B;
+				OPUS_ASSERT(nodes[B->parent].right == index_node);
+				nodes[B->parent].right = iB;
 			}
 		} else {
-			bvh->hierarchy = B;
+			bvh->root = iB;
 		}
 
 		/* Rotate */
 		if (D->height > E->height) {
-			B->right  = D;
-			A->left   = E;
-			E->parent = A;
+			B->right  = iD;
+			A->left   = iE;
+			E->parent = index_node;
 			opus_aabb_combine(&(C->aabb), &(E->aabb), &(A->aabb));
 			opus_aabb_combine(&(A->aabb), &(D->aabb), &(B->aabb));
 
 			A->height = 1 + opus_max(C->height, E->height);
 			B->height = 1 + opus_max(A->height, D->height);
 		} else {
-			B->right  = E;
-			A->left   = D;
-			D->parent = A;
+			B->right  = iE;
+			A->left   = iD;
+			D->parent = index_node;
 			opus_aabb_combine(&(C->aabb), &(D->aabb), &(A->aabb));
 			opus_aabb_combine(&(A->aabb), &(E->aabb), &(B->aabb));
 
@@ -222,53 +429,64 @@ static opus_bvh_leaf *opus_bvh_balance_tree(opus_bvh *bvh, opus_bvh_leaf *index_
 			B->height = 1 + opus_max(A->height, E->height);
 		}
 
-		return B;
+		return iB;
 	}
 
-	return A;
+	return index_node;
+}
+
+/* walk up from the node, re-balancing and refitting all the ancestors */
+static void bvh_refit_(opus_bvh *bvh, int index)
+{
+	int left, right;
+
+	while (index != BVH_NULL) {
+		index = opus_bvh_balance_tree(bvh, index);
+
+		left  = bvh->nodes[index].left;
+		right = bvh->nodes[index].right;
+		OPUS_ASSERT(left != BVH_NULL && right != BVH_NULL);
+
+		opus_aabb_combine(&(bvh->nodes[left].aabb), &(bvh->nodes[right].aabb), &(bvh->nodes[index].aabb));
+		bvh->nodes[index].height = 1 + opus_max(bvh->nodes[left].height, bvh->nodes[right].height);
+
+		index = bvh->nodes[index].parent;
+	}
 }
 
 /**
- * Dynamically insert a leaf into the BVH tree, will re-balance the tree for better destroy_leaves_ efficiency.
+ * Dynamically insert a leaf into the BVH tree, will re-balance the tree for better query efficiency.
  * This algorithm is originally from Box2D's dynamic tree by Erin Catto, I am really benefited a lot from this.
- * @param bvh the BVH tree (binary and AVL-conformed)
- * @param body the body you want to insert into the tree
- * @param type the type of the body (or shape if you want to say), you can leave whatever you want
- * @return the leaf contains the body you insert
  */
-opus_bvh_leaf *opus_bvh_insert(opus_bvh *bvh, opus_body *body)
+static void bvh_insert_leaf_(opus_bvh *bvh, int leaf)
 {
-	opus_bvh_leaf   *leaf, *index_node;
-	opus_aabb       *leaf_aabb, *combined_aabb;
-	opus_bvh_leaf   *best_sibling, *new_parent, *old_parent, *refit_current;
-
-	leaf           = bvh_node_create();
-	leaf->is_leaf  = 1;
-	leaf->right    = (void *) body;
-	opus_aabb_copy(&(leaf->aabb), &(body->shape->bound)); /* copy aabb of the container directly since there is only one body */
+	opus_aabb      leaf_aabb, combined_aabb, aabb;
+	int            index_node, best_sibling, new_parent, old_parent;
+	opus_bvh_node *node;
 
 	/* the bvh tree is empty, directly insert the body */
-	if (bvh->hierarchy == NULL) {
-		bvh->leaf_count++;
-		bvh->hierarchy = leaf; /* update new hierarchy */
-		leaf->parent   = NULL;
-		leaf->height   = 1;
-		return leaf;
+	if (bvh->root == BVH_NULL) {
+		bvh->root                = leaf;
+		bvh->nodes[leaf].parent  = BVH_NULL;
+		return;
 	}
 
 	/* stage 1: find the best sibling */
-	index_node    = bvh->hierarchy; /* current node we are searching */
-	leaf_aabb     = &(leaf->aabb);
-	combined_aabb = opus_aabb_create(0.0, 0.0, 0.0, 0.0);
-	while (!index_node->is_leaf) {
-		opus_aabb aabb;
+	index_node = bvh->root; /* current node we are searching */
+	leaf_aabb  = bvh->nodes[leaf].aabb;
+	while (bvh->nodes[index_node].height > 0) {
+		opus_bvh_node *left, *right;
 		double cost1; /* cost of descending into left */
 		double cost2; /* cost of descending into right */
-		double area, combined_area, cost, inheritance_cost, perimeter_aabb;
+		double area, combined_area, cost, inheritance_cost;
+
+		node  = &bvh->nodes[index_node];
+		left  = &bvh->nodes[node->left];
+		right = &bvh->nodes[node->right];
 
-		area = opus_aabb_perimeter(&(index_node->aabb));
-		opus_aabb_combine(&(index_node->aabb), leaf_aabb, combined_aabb);
-		combined_area = opus_aabb_perimeter(combined_aabb);
+		area = opus_aabb_perimeter(&(node->aabb));
+		opus_aabb_combine(&(node->aabb), &leaf_aabb, &combined_aabb);
+		combined_area = opus_aabb_perimeter(&combined_aabb);
 
 		/* cost of creating a new parent for this node and the new leaf */
 		cost = 2.0 * combined_area;
@@ -276,26 +494,18 @@ opus_bvh_leaf *opus_bvh_insert(opus_bvh *bvh, opus_body *body)
 		/* minimum cost of pushing the leaf further down the tree */
 		inheritance_cost = 2.0 * (combined_area - area);
 
-		opus_aabb_combine(leaf_aabb, &(index_node->left->aabb), &aabb);
-		if (index_node->left->is_leaf) {
+		opus_aabb_combine(&leaf_aabb, &(left->aabb), &aabb);
+		if (left->height == 0) {
 			cost1 = opus_aabb_perimeter(&aabb) + inheritance_cost;
 		} else {
-			double old_area, new_area;
-
-			old_area = opus_aabb_perimeter(&(index_node->left->aabb));
-			new_area = opus_aabb_perimeter(&aabb);
-			cost1    = new_area - old_area + inheritance_cost;
+			cost1 = opus_aabb_perimeter(&aabb) - opus_aabb_perimeter(&(left->aabb)) + inheritance_cost;
 		}
 
-		opus_aabb_combine(leaf_aabb, &(index_node->right->aabb), &aabb);
-		if (index_node->right->is_leaf) {
+		opus_aabb_combine(&leaf_aabb, &(right->aabb), &aabb);
+		if (right->height == 0) {
 			cost2 = opus_aabb_perimeter(&aabb) + inheritance_cost;
 		} else {
-			double old_area, new_area;
-
-			old_area = opus_aabb_perimeter(&(index_node->right->aabb));
-			new_area = opus_aabb_perimeter(&aabb);
-			cost2    = new_area - old_area + inheritance_cost;
+			cost2 = opus_aabb_perimeter(&aabb) - opus_aabb_perimeter(&(right->aabb)) + inheritance_cost;
 		}
 
 		/* descend according to the minimum cost. */
@@ -304,232 +514,369 @@ opus_bvh_leaf *opus_bvh_insert(opus_bvh *bvh, opus_body *body)
 		}
 
 		/* descend */
-		if (cost1 < cost2) {
-			index_node = index_node->left;
-		} else {
-			index_node = index_node->right;
-		}
+		index_node = cost1 < cost2 ? node->left : node->right;
 	}
-	opus_aabb_destroy(combined_aabb);
 
 	/* stage 2: create new parent node */
-	best_sibling       = index_node; /* the best node to insert the body */
-	new_parent         = bvh_node_create();
-	old_parent         = index_node->parent;
-	new_parent->parent = old_parent;
-	new_parent->height = best_sibling->height + 1;
-	opus_aabb_combine(leaf_aabb, &best_sibling->aabb, &new_parent->aabb);
-	if (old_parent == NULL) { /* the best_sibling is the root */
-		bvh->hierarchy       = new_parent;
-		new_parent->left     = best_sibling;
-		new_parent->right    = leaf;
-		leaf->parent         = new_parent;
-		best_sibling->parent = new_parent;
+	best_sibling = index_node; /* the best node to insert the body */
+	new_parent   = bvh_node_allocate_(bvh);
+	old_parent   = bvh->nodes[best_sibling].parent;
+
+	node         = &bvh->nodes[new_parent];
+	node->parent = old_parent;
+	node->height = bvh->nodes[best_sibling].height + 1;
+	node->left   = best_sibling;
+	node->right  = leaf;
+	opus_aabb_combine(&leaf_aabb, &bvh->nodes[best_sibling].aabb, &node->aabb);
+
+	if (old_parent == BVH_NULL) { /* the best_sibling is the root */
+		bvh->root = new_parent;
 	} else { /* the best_sibling is not the root */
-		if (old_parent->left == best_sibling) {
-			old_parent->left = new_parent;
+		if (bvh->nodes[old_parent].left == best_sibling) {
+			bvh->nodes[old_parent].left = new_parent;
 		} else {
-			old_parent->right = new_parent;
+			bvh->nodes[old_parent].right = new_parent;
 		}
-
-		new_parent->left     = best_sibling;
-		new_parent->right    = leaf;
-		new_parent->parent   = old_parent;
-		best_sibling->parent = new_parent;
-		leaf->parent         = new_parent;
 	}
+	bvh->nodes[best_sibling].parent = new_parent;
+	bvh->nodes[leaf].parent         = new_parent;
 
 	/* stage 3: refit all the parents to ensure parent node enclose children */
+	bvh_refit_(bvh, new_parent);
+}
 
-	/* if we choose best_node children as best sibling, start refitting from best_node, otherwise from its parent */
-	refit_current = leaf->parent;
-	while (refit_current != NULL) {
-		opus_bvh_leaf *left, *right;
+/* detach the leaf from the tree, the node itself is kept */
+static void bvh_remove_leaf_(opus_bvh *bvh, int leaf)
+{
+	int parent, grand_parent, sibling;
 
-		refit_current = opus_bvh_balance_tree(bvh, refit_current);
+	if (leaf == bvh->root) {
+		bvh->root = BVH_NULL;
+		return;
+	}
 
-		left  = refit_current->left;
-		right = refit_current->right;
+	parent       = bvh->nodes[leaf].parent;
+	grand_parent = bvh->nodes[parent].parent;
+	sibling      = bvh->nodes[parent].left == leaf ? bvh->nodes[parent].right : bvh->nodes[parent].left;
 
-		if (left == NULL || right == NULL) {
-			OPUS_ERROR("Insert leaf failed, the tree structure is invalid. (function: opus_bvh_insert)\n");
-			exit(-1);
+	if (grand_parent != BVH_NULL) {
+		/* Destroy parent and connect sibling to grandParent. */
+		if (bvh->nodes[grand_parent].left == parent) {
+			bvh->nodes[grand_parent].left = sibling;
+		} else {
+			bvh->nodes[grand_parent].right = sibling;
 		}
+		bvh->nodes[sibling].parent = grand_parent;
+		bvh_node_free_(bvh, parent);
 
-		opus_aabb_combine(&(left->aabb), &(right->aabb), &(refit_current->aabb));
-		refit_current->height = 1 + opus_max(left->height, right->height);
-
+		/* Adjust ancestor bounds. */
+		bvh_refit_(bvh, grand_parent);
+	} else {
+		bvh->root                  = sibling;
+		bvh->nodes[sibling].parent = BVH_NULL;
+		bvh_node_free_(bvh, parent);
+	}
+}
 
-		refit_current = refit_current->parent;
+static void bvh_mark_moved_(opus_bvh *bvh, int leaf)
+{
+	if (!bvh->nodes[leaf].moved) {
+		bvh->nodes[leaf].moved = 1;
+		opus_arr_push(bvh->moved_, &leaf);
 	}
+}
+
+/**
+ * @brief insert the body into the tree with a fat aabb, its pairs are found in the next update
+ * @param bvh the BVH tree (binary and AVL-conformed)
+ * @param body the body you want to insert into the tree
+ * @return index of the leaf, also stored in the body, see "proxy_offset"
+ */
+int opus_bvh_insert(opus_bvh *bvh, opus_body *body)
+{
+	int leaf;
 
+	leaf                  = bvh_node_allocate_(bvh);
+	bvh->nodes[leaf].body = body;
+	bvh_fatten_(bvh, body, 0, &bvh->nodes[leaf].aabb);
+	bvh_insert_leaf_(bvh, leaf);
+	bvh_mark_moved_(bvh, leaf);
+	bvh->leaf_count++;
+
+	*bvh_proxy_(bvh, body) = leaf;
 	return leaf;
 }
 
 /**
- *
+ * @brief remove the body from the tree together with all of its cached pairs
  * @param bvh
- * @param leaf
+ * @param body
  */
-void opus_bvh_remove(opus_bvh *bvh, opus_bvh_leaf *leaf)
+void opus_bvh_remove(opus_bvh *bvh, opus_body *body)
 {
-	opus_bvh_leaf *parent, *grandParent, *sibling;
-	if (leaf == bvh->hierarchy) {
-		bvh->hierarchy = NULL;
-		return;
+	int              leaf, i;
+	uint64_t         j;
+	uint32_t         a, b;
+	opus_pair_entry *entry;
+
+	OPUS_RETURN_IF(, *bvh_proxy_(bvh, body) < 0);
+	leaf = *bvh_proxy_(bvh, body);
+	OPUS_ASSERT(bvh->nodes[leaf].body == body);
+
+	/* entries are shifted backward on removal, so only advance when nothing is removed */
+	j = 0;
+	while (j < bvh->pairs.capacity) {
+		entry = &bvh->pairs.entries[j];
+		a     = (uint32_t) (entry->key >> 32);
+		b     = (uint32_t) entry->key;
+		if (entry->key != OPUS_PAIR_KEY_EMPTY && (a == (uint32_t) leaf || b == (uint32_t) leaf)) {
+			opus_pair_cache_remove_at(&bvh->pairs, j);
+			continue;
+		}
+		j++;
 	}
 
-	parent      = leaf->parent;
-	grandParent = parent->parent;
-	if (parent->left == leaf) {
-		sibling = parent->right;
-	} else {
-		sibling = parent->left;
+	if (bvh->nodes[leaf].moved) {
+		for (i = 0; i < (int) opus_arr_len(bvh->moved_); i++) {
+			if (bvh->moved_[i] == leaf) {
+				opus_arr_remove(bvh->moved_, i);
+				break;
+			}
+		}
 	}
 
-	if (grandParent != NULL) {
-		opus_bvh_leaf *index;
+	bvh_remove_leaf_(bvh, leaf);
+	bvh_node_free_(bvh, leaf);
+	bvh->leaf_count--;
+	*bvh_proxy_(bvh, body) = -1;
+}
 
-		/* Destroy parent and connect sibling to grandParent. */
-		if (grandParent->left == parent) {
-			grandParent->left = sibling;
+/**
+ * @brief call "callback" for every leaf whose fat aabb overlaps "aabb", stop once the
+ * 		callback returns 0
+ * @param bvh
+ * @param aabb
+ * @param callback
+ * @param data
+ */
+void opus_bvh_query(opus_bvh *bvh, opus_aabb *aabb, opus_bvh_query_cb callback, void *data)
+{
+	int            index;
+	opus_bvh_node *node;
+
+	OPUS_RETURN_IF(, bvh->root == BVH_NULL);
+
+	opus_arr_clear(bvh->stack_);
+	opus_arr_push(bvh->stack_, &bvh->root);
+	while (opus_arr_len(bvh->stack_) > 0) {
+		index = bvh->stack_[opus_arr_len(bvh->stack_) - 1];
+		opus_arr_pop(bvh->stack_);
+
+		node = &bvh->nodes[index];
+		if (!opus_aabb_is_overlap(aabb, &node->aabb)) continue;
+
+		if (node->height == 0) {
+			if (!callback(bvh, index, data)) return;
 		} else {
-			grandParent->right = sibling;
+			opus_arr_push(bvh->stack_, &node->left);
+			opus_arr_push(bvh->stack_, &node->right);
 		}
-		sibling->parent = grandParent;
-		bvh_node_destroy(parent);
-
-		/* Adjust ancestor bounds. */
-		index = grandParent;
-		while (index != NULL) {
-			opus_bvh_leaf *left, *right;
+	}
+}
 
-			index = opus_bvh_balance_tree(bvh, index);
+struct bvh_pair_query_ {
+	int leaf;
+};
 
-			left  = index->left;
-			right = index->right;
+static int bvh_add_pair_(opus_bvh *bvh, int leaf, void *data)
+{
+	int query = ((struct bvh_pair_query_ *) data)->leaf;
 
-			opus_aabb_combine(&(left->aabb), &(right->aabb), &(index->aabb));
-			index->height = 1 + opus_max(left->height, right->height);
+	/* both leaves moved, the pair is added when querying the one with the smaller index */
+	if (leaf == query || (bvh->nodes[leaf].moved && leaf < query)) return 1;
+	opus_pair_cache_insert(&bvh->pairs, opus_pair_key((uint64_t) leaf, (uint64_t) query), NULL);
+	return 1;
+}
 
-			index = index->parent;
-		}
-	} else {
-		bvh->hierarchy  = sibling;
-		sibling->parent = NULL;
-		bvh_node_destroy(parent);
+/* refresh the bounds of the bodies, leaves are only reinserted when the body leaves its fat aabb.
+ * 	sleeping bodies keep the bound they had when they fell asleep */
+static void bvh_refresh_(opus_bvh *bvh, opus_real dt)
+{
+	int            i;
+	opus_body     *body;
+	opus_bvh_node *node;
+
+	for (i = 0; i < bvh->capacity; i++) {
+		node = &bvh->nodes[i];
+		if (node->height != 0) continue;
+
+		body = node->body;
+		if (body->is_sleeping) continue;
+		body->shape->update_bound(body->shape, body->rotation, body->position);
+		if (bvh_aabb_contain_(&node->aabb, &body->shape->bound)) continue;
+
+		bvh_remove_leaf_(bvh, i);
+		bvh_fatten_(bvh, body, dt, &bvh->nodes[i].aabb);
+		bvh_insert_leaf_(bvh, i);
+		bvh_mark_moved_(bvh, i);
 	}
 }
 
+static void bvh_clear_moved_(opus_bvh *bvh)
+{
+	size_t k;
+	for (k = 0; k < opus_arr_len(bvh->moved_); k++) bvh->nodes[bvh->moved_[k]].moved = 0;
+	opus_arr_clear(bvh->moved_);
+}
+
 /**
- * find the leaf with body container contains the body you input, if the body is not in the tree, return NULL
+ * @brief refresh the bounds of all the bodies, leaves are only reinserted when the body
+ * 		leaves its fat aabb, and only those leaves are queried for new pairs
  * @param bvh
- * @param body
- * @param type
- * @return
+ * @param dt time step, used to predict the fat aabbs along the velocity
  */
-opus_bvh_leaf *opus_bvh_find(opus_bvh *bvh, opus_body *body)
+void opus_bvh_update(opus_bvh *bvh, opus_real dt)
 {
-	opus_aabb         aabb;
-	opus_bvh_leaf   **stack;
-	aabb = body->shape->bound;
-	opus_arr_create(stack, 10);
-	opus_arr_push(stack, &(bvh->hierarchy));
-
-	while (opus_arr_len(stack) > 0) {
-		opus_bvh_leaf *current = stack[opus_arr_len(stack) - 1];
-		opus_arr_pop(stack);
-
-		if (current->is_leaf) {
-			if (current->right == (void *) body) {
-				return current;
-			}
-		} else {
-			if (current->left && opus_aabb_is_overlap(&aabb, &(current->left->aabb))) {
-				opus_arr_push(stack, &(current->left));
-			}
-			if (current->right && opus_aabb_is_overlap(&aabb, &(current->right->aabb))) {
-				opus_arr_push(stack, &(current->right));
-			}
-		}
-	}
+	size_t                 k;
+	struct bvh_pair_query_ query;
+
+	bvh_refresh_(bvh, dt);
 
-	opus_arr_destroy(stack);
-	return NULL;
+	/* new pairs can only be caused by the moved leaves */
+	for (k = 0; k < opus_arr_len(bvh->moved_); k++) {
+		query.leaf = bvh->moved_[k];
+		opus_bvh_query(bvh, &bvh->nodes[query.leaf].aabb, bvh_add_pair_, &query);
+	}
+	bvh_clear_moved_(bvh);
 }
 
 /**
- * @brief Get an array of bodies (in container 'struct Collisions_BVH_Body *") which might possibly collide with the body you passed into.
- * 		This might cost much CPU, so do not use this if you have to deal with hordes of bodies at a time
- * @param bvh BVH tree
- * @param leaf the leaf containing the body you want to check, you can use 'magnum_bvh_find_leaf' to find the leaf in the BVH tree
- * @param result array (in magnum_array2.h)
+ * @brief the same as "opus_bvh_update" without looking for pairs, for trees that are only queried
+ * @param bvh
+ * @param dt
  */
-opus_body **opus_bvh_potentials(opus_bvh *bvh, opus_bvh_leaf *leaf, opus_body **result)
+void opus_bvh_refresh(opus_bvh *bvh, opus_real dt)
 {
-	opus_bvh_leaf **stack;
-	opus_arr_create(stack, 10);
-	opus_arr_push(stack, &(bvh->hierarchy));
-
-	opus_arr_clear(result);
-	while (opus_arr_len(stack) > 0) {
-		opus_bvh_leaf *current = stack[opus_arr_len(stack) - 1];
-		if (current == NULL) break;
-		opus_arr_pop(stack);
-
-		if (current->is_leaf) {
-			if (current->right != leaf->right)
-				opus_arr_push(result, &(current->right));
-		} else {
-			if (current->left && opus_aabb_is_overlap(&(leaf->aabb), &(current->left->aabb)))
-				opus_arr_push(stack, &(current->left));
-			if (current->right && opus_aabb_is_overlap(&(leaf->aabb), &(current->right->aabb)))
-				opus_arr_push(stack, &(current->right));
-		}
-	}
-
-	opus_arr_destroy(stack);
-
-	return result;
+	bvh_refresh_(bvh, dt);
+	bvh_clear_moved_(bvh);
 }
 
-static void bvh_check_two_branches(opus_bvh_leaf *n1, opus_bvh_leaf *n2, void (*callback)(opus_body *, opus_body *, void *), void *data)
+/* the part of the ray ([0, max_fraction] of the translation) that is inside the aabb, if any */
+static int bvh_ray_overlap_(opus_vec2 origin, opus_vec2 translation, opus_vec2 inv, opus_aabb *aabb, opus_real max_fraction)
 {
-	if (n1 == NULL || n2 == NULL) {
-		if (n1 == NULL) opus_bvh_for_each_potential(n2, callback, data);
-		if (n2 == NULL) opus_bvh_for_each_potential(n1, callback, data);
-		return;
+	opus_real t0, t1, a, b, t;
+
+	t0 = 0, t1 = max_fraction;
+	if (translation.x == 0) {
+		if (origin.x < aabb->min.x || origin.x > aabb->max.x) return 0;
+	} else {
+		a = (aabb->min.x - origin.x) * inv.x;
+		b = (aabb->max.x - origin.x) * inv.x;
+		if (a > b) {
+			t = a;
+			a = b;
+			b = t;
+		}
+		t0 = opus_max(t0, a);
+		t1 = opus_min(t1, b);
 	}
+	if (translation.y == 0) {
+		if (origin.y < aabb->min.y || origin.y > aabb->max.y) return 0;
+	} else {
+		a = (aabb->min.y - origin.y) * inv.y;
+		b = (aabb->max.y - origin.y) * inv.y;
+		if (a > b) {
+			t = a;
+			a = b;
+			b = t;
+		}
+		t0 = opus_max(t0, a);
+		t1 = opus_min(t1, b);
+	}
+	return t0 <= t1;
+}
 
-	if (opus_aabb_is_overlap(&(n1->aabb), &(n2->aabb))) {
-		if (n1->is_leaf) {
-			if (n2->is_leaf) {
-				callback((opus_body *) n1->right, (opus_body *) n2->right, data);
-			} else {
-				bvh_check_two_branches(n2->left, n1, callback, data);
-				bvh_check_two_branches(n2->right, n1, callback, data);
-			}
+/**
+ * @brief call "callback" for every leaf whose fat aabb is crossed by the ray from "origin"
+ * 		to "origin + translation". The callback returns the fraction to clip the ray to,
+ * 		so that farther leaves are skipped once something is hit, 0 to stop.
+ * @param bvh
+ * @param origin
+ * @param translation
+ * @param callback
+ * @param data
+ */
+void opus_bvh_ray_query(opus_bvh *bvh, opus_vec2 origin, opus_vec2 translation, opus_bvh_ray_cb callback, void *data)
+{
+	int            index;
+	opus_real      max_fraction, fraction;
+	opus_vec2      inv;
+	opus_bvh_node *node;
+
+	OPUS_RETURN_IF(, bvh->root == BVH_NULL);
+
+	/* the divisions are done once for the whole traversal */
+	inv.x        = translation.x != 0 ? 1 / translation.x : 0;
+	inv.y        = translation.y != 0 ? 1 / translation.y : 0;
+	max_fraction = 1;
+
+	opus_arr_clear(bvh->stack_);
+	opus_arr_push(bvh->stack_, &bvh->root);
+	while (opus_arr_len(bvh->stack_) > 0) {
+		index = bvh->stack_[opus_arr_len(bvh->stack_) - 1];
+		opus_arr_pop(bvh->stack_);
+
+		node = &bvh->nodes[index];
+		if (!bvh_ray_overlap_(origin, translation, inv, &node->aabb, max_fraction)) continue;
+
+		if (node->height == 0) {
+			fraction = callback(bvh, index, data);
+			if (fraction <= 0) return;
+			max_fraction = opus_min(max_fraction, fraction);
 		} else {
-			if (n2->is_leaf) {
-				bvh_check_two_branches(n1->left, n2, callback, data);
-				bvh_check_two_branches(n1->right, n2, callback, data);
-			} else {
-				bvh_check_two_branches(n1->left, n2->left, callback, data);
-				bvh_check_two_branches(n1->left, n2->right, callback, data);
-				bvh_check_two_branches(n1->right, n2->left, callback, data);
-				bvh_check_two_branches(n1->right, n2->right, callback, data);
-			}
+			opus_arr_push(bvh->stack_, &node->left);
+			opus_arr_push(bvh->stack_, &node->right);
 		}
 	}
-	opus_bvh_for_each_potential(n1, callback, data);
-	opus_bvh_for_each_potential(n2, callback, data);
 }
 
-void opus_bvh_for_each_potential(opus_bvh_leaf *bvh_node, void (*callback)(opus_body *, opus_body *, void *), void *data)
+/**
+ * @brief call "callback" for every cached pair whose bounds overlap and which can collide,
+ * 		at least one body of which is awake. Pairs whose fat aabbs stopped overlapping are
+ * 		dropped here.
+ * @param bvh
+ * @param callback
+ * @param data
+ */
+void opus_bvh_for_each_pair(opus_bvh *bvh, opus_sap_cb callback, void *data)
 {
-	if (bvh_node == NULL) return;
+	uint64_t         i;
+	opus_pair_entry *entry;
+	opus_bvh_node   *na, *nb;
+
+	/* the slot may be refilled by a shifted entry on removal, so only advance when nothing is removed */
+	i = 0;
+	while (i < bvh->pairs.capacity) {
+		entry = &bvh->pairs.entries[i];
+		if (entry->key != OPUS_PAIR_KEY_EMPTY) {
+			na = &bvh->nodes[entry->key >> 32];
+			nb = &bvh->nodes[entry->key & 0xffffffffu];
+			if (!opus_aabb_is_overlap(&na->aabb, &nb->aabb)) {
+				opus_pair_cache_remove_at(&bvh->pairs, i);
+				continue;
+			}
+		}
+		i++;
+	}
 
-	if (!bvh_node->is_leaf) {
-		bvh_check_two_branches(bvh_node->left, bvh_node->right, callback, data);
+	opus_pair_cache_foreach_start(&bvh->pairs, entry, i)
+	{
+		na = &bvh->nodes[entry->key >> 32];
+		nb = &bvh->nodes[entry->key & 0xffffffffu];
+		if (!(na->body->bitmask & nb->body->bitmask)) continue;
+		if (opus_sleeping_is_pair_asleep(na->body, nb->body)) continue;
+		if (!opus_aabb_is_overlap(&na->body->shape->bound, &nb->body->shape->bound)) continue;
+		callback(na->body, nb->body, data);
 	}
+	opus_pair_cache_foreach_end();
 }
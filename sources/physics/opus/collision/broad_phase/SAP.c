@@ -14,20 +14,51 @@
 #include "physics/opus/physics.h"
 #include "physics/opus/physics_private.h"
 
-static int bodies_sort_x_(const void *a, const void *b)
+static int bodies_compare_x_(const void *a, const void *b)
 {
 	opus_body *ba = *(opus_body **) a;
 	opus_body *bb = *(opus_body **) b;
 	return opus_sign(ba->shape->bound.min.x - bb->shape->bound.min.x);
 }
 
+/* insertion sort, the array is kept sorted from the last step and resting bodies do not
+ * 		move, so it is almost sorted. Falls back to qsort when it is not (the first step) */
+static void bodies_sort_x_(opus_body **bodies, size_t n)
+{
+	size_t     i, j, moves;
+	opus_body *cur;
+	opus_real  x;
+
+	for (i = 1, moves = 0; i < n; i++) {
+		cur = bodies[i];
+		x   = cur->shape->bound.min.x;
+		for (j = i; j > 0 && bodies[j - 1]->shape->bound.min.x > x; j--) bodies[j] = bodies[j - 1];
+		bodies[j] = cur;
+
+		moves += i - j;
+		if (moves > n * 8) {
+			qsort(bodies, n, sizeof(opus_body *), bodies_compare_x_);
+			return;
+		}
+	}
+}
+
+/**
+ * @brief find all the pairs whose bounds overlap, at least one body of which is awake.
+ * 		The bounds of the sleeping bodies are not updated, they have not moved since they
+ * 		fell asleep, and the sweep of a resting body (static or sleeping) jumps over the
+ * 		other resting ones.
+ * @param bodies sorted by the minimum x of their bounds in place
+ * @param n
+ * @param callback
+ * @param data
+ */
 void opus_SAP(opus_body **bodies, size_t n, opus_sap_cb callback, void *data)
 {
-	size_t i, j;
+	size_t i, j, *next;
+	int    is_awake;
 
 	opus_body *A, *B;
-
-	opus_mat2d ta, tb;
 	opus_aabb  ba, bb;
 
 	/* if no bodies exist, exit */
@@ -36,35 +67,374 @@ void opus_SAP(opus_body **bodies, size_t n, opus_sap_cb callback, void *data)
 	/* update AABB */
 	for (i = 0; i < n; i++) {
 		A = bodies[i];
+		if (A->is_sleeping) continue;
 		A->shape->update_bound(A->shape, A->rotation, A->position);
 	}
 
 	/* sort bodies by X in ascending order */
-	qsort(bodies, n, sizeof(opus_body *), bodies_sort_x_);
-	for (i = 0; i < n; i++) {
-		A = bodies[i];
+	bodies_sort_x_(bodies, n);
 
-		for (j = i + 1; j < n; j++) {
-			B = bodies[j];
+	/* the first awake body from each index on, every body is visited if it cannot be allocated */
+	next = OPUS_MALLOC(sizeof(size_t) * (n + 1));
+	if (next) {
+		next[n] = n;
+		for (i = n; i-- > 0;) next[i] = opus_sleeping_is_awake(bodies[i]) ? i : next[i + 1];
+	}
 
-			/* calculate rigid body transformation matrix */
-			opus_mat2d_rotate_about(ta, (float) A->rotation, A->position);
-			opus_mat2d_rotate_about(tb, (float) B->rotation, B->position);
+	for (i = 0; i < n; i++) {
+		A        = bodies[i];
+		ba       = A->shape->bound;
+		is_awake = opus_sleeping_is_awake(A);
 
-			ba = A->shape->bound;
+		for (j = i + 1; j < n; j++) {
+			if (!is_awake) {
+				if (next) j = next[j];
+				if (j == n) break;
+			}
+			B  = bodies[j];
 			bb = B->shape->bound;
 
 			/* X-axis: we have already sorted all the bodies in X axis */
 			if (bb.min.x > ba.max.x) break;
 
+			/* two resting bodies cannot start touching */
+			if (!is_awake && !opus_sleeping_is_awake(B)) continue;
+
 			/* Y-axis: check AABB bounding box to check the two bodies can collide */
 			if (ba.max.y < bb.min.y || ba.min.y > bb.max.y) continue;
 
 			/* check bitmask to determine if the two can collide */
 			if (!(A->bitmask & B->bitmask)) continue;
 
-			callback(A, B, ta, tb, data);
+			callback(A, B, data);
 		}
 	}
+	OPUS_FREE(next);
+}
+
+/*
+ * Incremental sweep and prune
+ *
+ * The endpoints of all proxies are kept sorted on both axes between steps. Since bodies
+ * barely move between frames, the arrays are almost sorted and insertion sort repairs them
+ * in near linear time. Every swap of a min endpoint and a max endpoint is exactly the
+ * moment two boxes may start or stop overlapping on that axis, so the persistent pair set
+ * is updated only there and the overlap events are reported.
+ */
+
+#define SAP_PROXY_NEW (1)
+#define SAP_PROXY_FREE (2)
+
+static opus_real sap_endpoint_value_(opus_sap *sap, opus_sap_endpoint *e, int axis)
+{
+	opus_aabb *aabb = &sap->proxies[e->proxy].aabb;
+	if (axis == 0) return e->is_max ? aabb->max.x : aabb->min.x;
+	return e->is_max ? aabb->max.y : aabb->min.y;
+}
+
+/* endpoints with the same value keep min before max, so touching boxes are overlapping */
+static int sap_endpoint_less_(opus_sap_endpoint *a, opus_sap_endpoint *b)
+{
+	return a->value < b->value || (a->value == b->value && a->is_max < b->is_max);
+}
+
+static int sap_endpoint_compare_(const void *a, const void *b)
+{
+	opus_sap_endpoint *ea = (opus_sap_endpoint *) a;
+	opus_sap_endpoint *eb = (opus_sap_endpoint *) b;
+	if (sap_endpoint_less_(ea, eb)) return -1;
+	if (sap_endpoint_less_(eb, ea)) return 1;
+	return 0;
+}
+
+static void sap_report_(opus_sap *sap, uint32_t a, uint32_t b, int is_begin)
+{
+	if (sap->on_event) sap->on_event(sap->proxies[a].body, sap->proxies[b].body, is_begin, sap->data);
+}
+
+static void sap_add_pair_(opus_sap *sap, uint32_t a, uint32_t b)
+{
+	uint64_t key = opus_pair_key(a, b);
+	if (opus_pair_cache_find(&sap->pairs, key)) return;
+	opus_pair_cache_insert(&sap->pairs, key, NULL);
+	sap_report_(sap, a, b, 1);
+}
+
+static void sap_remove_pair_(opus_sap *sap, uint32_t a, uint32_t b)
+{
+	uint64_t key = opus_pair_key(a, b);
+	if (!opus_pair_cache_find(&sap->pairs, key)) return;
+	opus_pair_cache_remove(&sap->pairs, key);
+	sap_report_(sap, a, b, 0);
+}
+
+opus_sap *opus_sap_create(opus_sap_event_cb on_event, void *data)
+{
+	opus_sap *sap = OPUS_CALLOC(1, sizeof(opus_sap));
+	if (sap) {
+		sap->on_event = on_event;
+		sap->data     = data;
+		opus_arr_create(sap->proxies, sizeof(opus_sap_proxy));
+		opus_arr_create(sap->free_proxies, sizeof(uint32_t));
+		opus_arr_create(sap->endpoints[0], sizeof(opus_sap_endpoint));
+		opus_arr_create(sap->endpoints[1], sizeof(opus_sap_endpoint));
+		opus_arr_create(sap->active_, sizeof(uint32_t));
+		opus_pair_cache_init(&sap->pairs, 0);
+	}
+	return sap;
+}
+
+void opus_sap_destroy(opus_sap *sap)
+{
+	size_t i;
+	for (i = 0; i < opus_arr_len(sap->proxies); i++)
+		if (!(sap->proxies[i].flags & SAP_PROXY_FREE)) sap->proxies[i].body->proxy_id = -1;
+	opus_pair_cache_done(&sap->pairs);
+	opus_arr_destroy(sap->active_);
+	opus_arr_destroy(sap->endpoints[1]);
+	opus_arr_destroy(sap->endpoints[0]);
+	opus_arr_destroy(sap->free_proxies);
+	opus_arr_destroy(sap->proxies);
+	OPUS_FREE(sap);
+}
+
+/**
+ * @brief add a body into the sweep and prune, its pairs are reported in the next update
+ * @param sap
+ * @param body
+ * @return id of the proxy, also stored in "body->proxy_id"
+ */
+int opus_sap_add(opus_sap *sap, opus_body *body)
+{
+	uint32_t          id;
+	opus_sap_proxy    proxy, *p;
+	opus_sap_endpoint e;
+	int               axis;
+
+	if (opus_arr_len(sap->free_proxies) > 0) {
+		id = sap->free_proxies[opus_arr_len(sap->free_proxies) - 1];
+		opus_arr_pop(sap->free_proxies);
+	} else {
+		id = (uint32_t) opus_arr_len(sap->proxies);
+		memset(&proxy, 0, sizeof(proxy));
+		opus_arr_push(sap->proxies, &proxy);
+	}
+
+	p        = &sap->proxies[id];
+	p->body  = body;
+	p->flags = SAP_PROXY_NEW;
+	p->aabb  = body->shape->bound;
+
+	/* appended endpoints are placed when the new proxies are merged in the next update */
+	e.proxy = id;
+	for (axis = 0; axis < 2; axis++) {
+		e.is_max = 0;
+		opus_arr_push(sap->endpoints[axis], &e);
+		e.is_max = 1;
+		opus_arr_push(sap->endpoints[axis], &e);
+	}
+	sap->n_new_++;
+
+	body->proxy_id = (int) id;
+	return (int) id;
+}
+
+/**
+ * @brief remove the body from the sweep and prune, end events are reported for all its pairs
+ * @param sap
+ * @param body
+ */
+void opus_sap_remove(opus_sap *sap, opus_body *body)
+{
+	uint32_t         id, a, b;
+	uint64_t         i;
+	size_t           j, k;
+	int              axis;
+	opus_pair_entry *entry;
+
+	OPUS_RETURN_IF(, body->proxy_id < 0);
+	id = (uint32_t) body->proxy_id;
+
+	for (axis = 0; axis < 2; axis++) {
+		for (j = 0, k = 0; j < opus_arr_len(sap->endpoints[axis]); j++)
+			if (sap->endpoints[axis][j].proxy != id) sap->endpoints[axis][k++] = sap->endpoints[axis][j];
+		opus_arr_set_len(sap->endpoints[axis], k);
+	}
+
+	/* entries are shifted backward on removal, so only advance when nothing is removed */
+	i = 0;
+	while (i < sap->pairs.capacity) {
+		entry = &sap->pairs.entries[i];
+		a     = (uint32_t) (entry->key >> 32);
+		b     = (uint32_t) entry->key;
+		if (entry->key != OPUS_PAIR_KEY_EMPTY && (a == id || b == id)) {
+			opus_pair_cache_remove_at(&sap->pairs, i);
+			sap_report_(sap, a, b, 0);
+			continue;
+		}
+		i++;
+	}
+
+	if (sap->proxies[id].flags & SAP_PROXY_NEW) sap->n_new_--;
+	sap->proxies[id].flags = SAP_PROXY_FREE;
+	sap->proxies[id].body  = NULL;
+	opus_arr_push(sap->free_proxies, &id);
+	body->proxy_id = -1;
+}
+
+/* insertion sort which reports the overlap changes of old proxies on the swaps */
+static void sap_sort_axis_(opus_sap *sap, int axis)
+{
+	opus_sap_endpoint *endpoints = sap->endpoints[axis], cur, *prev;
+	opus_sap_proxy    *pc, *pp;
+	size_t             i, j, n;
+
+	n = opus_arr_len(endpoints);
+	for (i = 1; i < n; i++) {
+		cur = endpoints[i];
+		j   = i;
+		while (j > 0 && sap_endpoint_less_(&cur, &endpoints[j - 1])) {
+			prev = &endpoints[j - 1];
+			pc   = &sap->proxies[cur.proxy];
+			pp   = &sap->proxies[prev->proxy];
+
+			/* swapping with new proxies is handled when they are merged */
+			if (cur.is_max != prev->is_max && cur.proxy != prev->proxy && !((pc->flags | pp->flags) & SAP_PROXY_NEW)) {
+				if (!cur.is_max) {
+					/* a min moves before a max: may begin overlapping */
+					if (opus_aabb_is_overlap(&pc->aabb, &pp->aabb)) sap_add_pair_(sap, cur.proxy, prev->proxy);
+				} else {
+					/* a max moves before a min: stop overlapping for sure */
+					sap_remove_pair_(sap, cur.proxy, prev->proxy);
+				}
+			}
+
+			endpoints[j] = *prev;
+			j--;
+		}
+		endpoints[j] = cur;
+	}
+}
+
+/* drop all the pairs which are not overlapping any more, used after sorting from scratch */
+static void sap_prune_pairs_(opus_sap *sap)
+{
+	uint32_t         a, b;
+	uint64_t         i;
+	opus_pair_entry *entry;
+
+	/* entries are shifted backward on removal, so only advance when nothing is removed */
+	i = 0;
+	while (i < sap->pairs.capacity) {
+		entry = &sap->pairs.entries[i];
+		a     = (uint32_t) (entry->key >> 32);
+		b     = (uint32_t) entry->key;
+		if (entry->key != OPUS_PAIR_KEY_EMPTY && !opus_aabb_is_overlap(&sap->proxies[a].aabb, &sap->proxies[b].aabb)) {
+			opus_pair_cache_remove_at(&sap->pairs, i);
+			sap_report_(sap, a, b, 0);
+			continue;
+		}
+		i++;
+	}
+}
+
+/**
+ * sweep along x once to find all the pairs involving new proxies,
+ * or all the overlapping pairs if "all" is set
+ */
+static void sap_sweep_(opus_sap *sap, int all)
+{
+	opus_sap_endpoint *e;
+	opus_sap_proxy    *p, *q;
+	size_t             i, j, n;
+
+	n = opus_arr_len(sap->endpoints[0]);
+	opus_arr_clear(sap->active_);
+	for (i = 0; i < n; i++) {
+		e = &sap->endpoints[0][i];
+		p = &sap->proxies[e->proxy];
+		if (e->is_max) {
+			for (j = 0; j < opus_arr_len(sap->active_); j++) {
+				if (sap->active_[j] == e->proxy) {
+					sap->active_[j] = sap->active_[opus_arr_len(sap->active_) - 1];
+					opus_arr_pop(sap->active_);
+					break;
+				}
+			}
+			continue;
+		}
+		for (j = 0; j < opus_arr_len(sap->active_); j++) {
+			q = &sap->proxies[sap->active_[j]];
+			if (!all && !((p->flags | q->flags) & SAP_PROXY_NEW)) continue;
+			if (p->aabb.max.y < q->aabb.min.y || p->aabb.min.y > q->aabb.max.y) continue;
+			sap_add_pair_(sap, e->proxy, sap->active_[j]);
+		}
+		opus_arr_push(sap->active_, &e->proxy);
+	}
+
+	for (i = 0; i < opus_arr_len(sap->proxies); i++) sap->proxies[i].flags &= ~SAP_PROXY_NEW;
+	sap->n_new_ = 0;
+}
+
+/**
+ * @brief update the bounds of all the proxies (once per step), repair the
+ * 		sorted endpoint lists and report pairs whose overlapping status changed.
+ * 		Sleeping bodies keep the bound they had when they fell asleep.
+ * @param sap
+ */
+void opus_sap_update(opus_sap *sap)
+{
+	opus_sap_proxy *p;
+	opus_body      *body;
+	size_t          i, n;
+	int             axis, from_scratch;
+
+	for (i = 0; i < opus_arr_len(sap->proxies); i++) {
+		p = &sap->proxies[i];
+		if (p->flags & SAP_PROXY_FREE) continue;
+		body = p->body;
+		if (body->is_sleeping) continue;
+		body->shape->update_bound(body->shape, body->rotation, body->position);
+		p->aabb = body->shape->bound;
+	}
+
+	/* lots of new proxies (level loading), sorting and sweeping from scratch is cheaper */
+	from_scratch = sap->n_new_ * 4 > opus_arr_len(sap->endpoints[0]);
+
+	for (axis = 0; axis < 2; axis++) {
+		n = opus_arr_len(sap->endpoints[axis]);
+		for (i = 0; i < n; i++)
+			sap->endpoints[axis][i].value = sap_endpoint_value_(sap, &sap->endpoints[axis][i], axis);
+
+		if (from_scratch) qsort(sap->endpoints[axis], n, sizeof(opus_sap_endpoint), sap_endpoint_compare_);
+		else sap_sort_axis_(sap, axis);
+	}
+
+	if (from_scratch) sap_prune_pairs_(sap);
+	if (sap->n_new_ || from_scratch) sap_sweep_(sap, from_scratch);
+}
+
+/**
+ * @brief call "callback" for every overlapping pair which can collide, at least one body
+ * 		of which is awake. The pairs of resting bodies stay in the set until they separate.
+ * @param sap
+ * @param callback
+ * @param data
+ */
+void opus_sap_for_each_pair(opus_sap *sap, opus_sap_cb callback, void *data)
+{
+	uint64_t         i;
+	opus_pair_entry *entry;
+	opus_sap_proxy  *pa, *pb;
+
+	opus_pair_cache_foreach_start(&sap->pairs, entry, i)
+	{
+		pa = &sap->proxies[entry->key >> 32];
+		pb = &sap->proxies[entry->key & 0xffffffffu];
+		if (!(pa->body->bitmask & pb->body->bitmask)) continue;
+		if (opus_sleeping_is_pair_asleep(pa->body, pb->body)) continue;
+		callback(pa->body, pb->body, data);
+	}
+	opus_pair_cache_foreach_end();
 }
 
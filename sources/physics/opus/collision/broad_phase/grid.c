@@ -6,7 +6,193 @@
  *             / ___ \| | | | | | | (_| \__ \
  *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/2/28
  *
- * @brief uniform grid
+ * @brief uniform grid, cells are hashed into buckets which are rebuilt every step with
+ * 		a counting sort, so all the entries of a bucket are stored contiguously.
+ * 		Works best when the bodies are about the same size (particles, piles of boxes).
  *
  */
 
+#include <math.h>
+#include <string.h>
+#include "data_structure/array.h"
+#include "physics/opus/physics.h"
+#include "physics/opus/physics_private.h"
+
+#define GRID_MIN_BUCKETS (16)
+
+static OPUS_INLINE uint32_t grid_hash_(int32_t x, int32_t y)
+{
+	return (uint32_t) x * 73856093u ^ (uint32_t) y * 19349663u;
+}
+
+opus_grid *opus_grid_create(void)
+{
+	opus_grid *grid = OPUS_CALLOC(1, sizeof(opus_grid));
+	if (grid) {
+		opus_arr_create(grid->items, sizeof(opus_grid_item));
+		opus_arr_create(grid->buckets, sizeof(uint32_t));
+		opus_arr_create(grid->ranges, sizeof(opus_grid_range));
+	}
+	return grid;
+}
+
+void opus_grid_destroy(opus_grid *grid)
+{
+	opus_arr_destroy(grid->ranges);
+	opus_arr_destroy(grid->buckets);
+	opus_arr_destroy(grid->items);
+	OPUS_FREE(grid);
+}
+
+/* the average extent of the bounds of the bodies which move, each covers about 4 cells.
+ * 	The static ones are left out, a large ground would make the cells too big */
+static opus_real grid_auto_cell_size_(opus_body **bodies, size_t n)
+{
+	size_t     i, count;
+	opus_real  sum;
+	opus_aabb *b;
+
+	for (i = 0, count = 0, sum = 0; i < n; i++) {
+		if (bodies[i]->type == OPUS_BODY_STATIC) continue;
+		b = &bodies[i]->shape->bound;
+		sum += opus_max(b->max.x - b->min.x, b->max.y - b->min.y);
+		count++;
+	}
+	return count && sum > 0 ? sum / (opus_real) count : 1;
+}
+
+/* cells covered by a bound */
+static void grid_range_(opus_grid_range *range, opus_aabb *bound, opus_real inv_cell)
+{
+	range->x0 = (int32_t) floor(bound->min.x * inv_cell);
+	range->y0 = (int32_t) floor(bound->min.y * inv_cell);
+	range->x1 = (int32_t) floor(bound->max.x * inv_cell);
+	range->y1 = (int32_t) floor(bound->max.y * inv_cell);
+}
+
+/**
+ * @brief find all the pairs whose bounds overlap, at least one body of which is awake.
+ * 		A pair sharing several cells is only reported in the cell containing the minimum
+ * 		corner of the overlapping region, so no set of reported pairs is needed.
+ * 		Only the awake bodies are binned. The resting ones (static or sleeping) look up the
+ * 		awake bodies in the cells they cover, and the sleeping ones keep the bound they had
+ * 		when they fell asleep.
+ * @param grid
+ * @param bodies
+ * @param n
+ * @param cell_size size of the cells, about the size of a typical body is a good choice,
+ * 		pass 0 to use the average size of the bodies which are not static
+ * @param callback
+ * @param data
+ */
+void opus_grid_for_each_pair(opus_grid *grid, opus_body **bodies, size_t n, opus_real cell_size, opus_sap_cb callback, void *data)
+{
+	size_t           i, n_items;
+	uint32_t         b, n_buckets, *buckets, end;
+	int32_t          x, y;
+	opus_body       *A, *B;
+	opus_grid_item  *items, *p, *q;
+	opus_grid_range *ranges, *ra, *rb, rest;
+	opus_real        inv_cell;
+
+	if (bodies == NULL || n == 0) return;
+
+	/* update AABB */
+	opus_arr_resize(grid->ranges, n);
+	ranges = grid->ranges;
+	for (i = 0; i < n; i++) {
+		A = bodies[i];
+		if (A->is_sleeping) continue;
+		A->shape->update_bound(A->shape, A->rotation, A->position);
+	}
+
+	if (cell_size <= 0) cell_size = grid_auto_cell_size_(bodies, n);
+	grid->cell_size = cell_size;
+	inv_cell        = 1 / cell_size;
+
+	/* cells covered by each awake body, none for the resting ones */
+	for (i = 0, n_items = 0; i < n; i++) {
+		if (!opus_sleeping_is_awake(bodies[i])) {
+			ranges[i].x0 = ranges[i].y0 = 0;
+			ranges[i].x1 = ranges[i].y1 = -1;
+			continue;
+		}
+		grid_range_(&ranges[i], &bodies[i]->shape->bound, inv_cell);
+		n_items += (size_t) (ranges[i].x1 - ranges[i].x0 + 1) * (size_t) (ranges[i].y1 - ranges[i].y0 + 1);
+	}
+
+	n_buckets = GRID_MIN_BUCKETS;
+	while (n_buckets < n_items) n_buckets *= 2;
+	opus_arr_resize(grid->buckets, n_buckets + 1);
+	opus_arr_resize(grid->items, n_items);
+	buckets = grid->buckets;
+	items   = grid->items;
+	memset(buckets, 0, sizeof(uint32_t) * (n_buckets + 1));
+
+	/* counting sort: count, prefix sum to the end of each bucket, then fill backward
+	 * 		so that "buckets[b]" ends up at the start of the bucket */
+	for (i = 0; i < n; i++)
+		for (y = ranges[i].y0; y <= ranges[i].y1; y++)
+			for (x = ranges[i].x0; x <= ranges[i].x1; x++)
+				buckets[grid_hash_(x, y) & (n_buckets - 1)]++;
+	for (b = 1; b < n_buckets; b++) buckets[b] += buckets[b - 1];
+	buckets[n_buckets] = (uint32_t) n_items;
+	for (i = n; i-- > 0;) {
+		for (y = ranges[i].y0; y <= ranges[i].y1; y++) {
+			for (x = ranges[i].x0; x <= ranges[i].x1; x++) {
+				p       = &items[--buckets[grid_hash_(x, y) & (n_buckets - 1)]];
+				p->body = (uint32_t) i;
+				p->x    = x;
+				p->y    = y;
+			}
+		}
+	}
+
+	for (b = 0; b < n_buckets; b++) {
+		end = buckets[b + 1];
+		for (p = &items[buckets[b]]; p < &items[end]; p++) {
+			for (q = p + 1; q < &items[end]; q++) {
+				/* different cells hashed into the same bucket */
+				if (p->x != q->x || p->y != q->y) continue;
+
+				/* report in the home cell only, it is covered by both the bodies */
+				ra = &ranges[p->body];
+				rb = &ranges[q->body];
+				if (p->x != opus_max_i(ra->x0, rb->x0) || p->y != opus_max_i(ra->y0, rb->y0)) continue;
+
+				A = bodies[p->body];
+				B = bodies[q->body];
+				if (!opus_aabb_is_overlap(&A->shape->bound, &B->shape->bound)) continue;
+				if (!(A->bitmask & B->bitmask)) continue;
+
+				callback(A, B, data);
+			}
+		}
+	}
+
+	/* the resting bodies against the awake ones in the cells they cover */
+	for (i = 0; i < n; i++) {
+		A = bodies[i];
+		if (opus_sleeping_is_awake(A)) continue;
+		grid_range_(&rest, &A->shape->bound, inv_cell);
+
+		for (y = rest.y0; y <= rest.y1; y++) {
+			for (x = rest.x0; x <= rest.x1; x++) {
+				b   = grid_hash_(x, y) & (n_buckets - 1);
+				end = buckets[b + 1];
+				for (q = &items[buckets[b]]; q < &items[end]; q++) {
+					if (q->x != x || q->y != y) continue;
+
+					rb = &ranges[q->body];
+					if (x != opus_max_i(rest.x0, rb->x0) || y != opus_max_i(rest.y0, rb->y0)) continue;
+
+					B = bodies[q->body];
+					if (!opus_aabb_is_overlap(&A->shape->bound, &B->shape->bound)) continue;
+					if (!(A->bitmask & B->bitmask)) continue;
+
+					callback(A, B, data);
+				}
+			}
+		}
+	}
+}
@@ -16,56 +16,96 @@
 #include "physics/opus/physics.h"
 #include "physics/opus/physics_private.h"
 
-opus_contact* opus_contact_create(opus_body* A, opus_body* B, opus_vec2 pa, opus_vec2 pb, opus_vec2 normal, opus_real depth)
+static void contact_init_(opus_contact* contact, opus_body* A, opus_body* B, opus_vec2 pa, opus_vec2 pb, opus_vec2 normal, opus_real depth)
 {
-	opus_contact* contact = OPUS_CALLOC(1, sizeof(opus_contact));
-	if (contact) {
-		contact->A         = A;
-		contact->B         = B;
-		contact->pa        = pa;
-		contact->pb        = pb;
-		contact->depth     = depth;
-		contact->normal    = normal;
-		contact->tangent   = opus_vec2_perp(normal);
-		contact->is_active = 1;
-	}
-	return contact;
+	memset(contact, 0, sizeof(opus_contact));
+	contact->A         = A;
+	contact->B         = B;
+	contact->pa        = pa;
+	contact->pb        = pb;
+	contact->depth     = depth;
+	contact->normal    = normal;
+	contact->tangent   = opus_vec2_perp(normal);
+	contact->is_active = 1;
 }
 
-void opus_contact_destroy(opus_contact* contact)
+uint64_t opus_contacts_key(opus_body* A, opus_body* B)
 {
-	free(contact);
-}
-
-char* opus_contacts_id(opus_body* A, opus_body* B)
-{
-	static char id[32];
-
-	uint64_t id_min = A->id < B->id ? A->id : B->id;
-	uint64_t id_max = A->id > B->id ? A->id : B->id;
-
-	snprintf(id, 32, "%d,%d", id_min, id_max);
-	return id;
+	return opus_pair_key(A->id, B->id);
 }
 
-opus_contacts* opus_contacts_create(opus_body* A, opus_body* B)
+opus_contacts* opus_contacts_create(opus_pool* pool, opus_body* A, opus_body* B)
 {
-	opus_contacts* contacts = OPUS_CALLOC(1, sizeof(opus_contacts));
+	opus_contacts* contacts = opus_pool_acquire(pool);
 	if (contacts) {
+		memset(contacts, 0, sizeof(opus_contacts));
 		contacts->A = A->id < B->id ? A : B;
 		contacts->B = A->id > B->id ? A : B;
 
 		contacts->friction    = opus_sqrt(A->friction * B->friction);
 		contacts->restitution = opus_sqrt(A->restitution * B->restitution);
 
-		strcpy(contacts->id, opus_contacts_id(A, B));
-		opus_arr_create(contacts->contacts, sizeof(opus_contact*));
+		contacts->key = opus_contacts_key(A, B);
 	}
 	return contacts;
 }
 
-void opus_contacts_destroy(opus_contacts* contacts)
+void opus_contacts_destroy(opus_pool* pool, opus_contacts* contacts)
+{
+	opus_pool_release(pool, contacts);
+}
+
+/**
+ * @brief find the points of the last step with the same feature ids as the new ones, and
+ * 		drop the points matching nothing to make room for the new ones. The kept points stay
+ * 		in the same order.
+ * @param contacts
+ * @param cr
+ * @param match index of the contact matching each support, -1 if there is none, -2 if
+ * 		it has the same id as a support before it (nothing to do)
+ */
+void opus_contacts_match(opus_contacts* contacts, opus_clip_result* cr, int match[OPUS_MAX_CONTACTS])
+{
+	int i, j, n, keep;
+
+	for (i = 0; i < OPUS_MAX_CONTACTS; i++) {
+		match[i] = -1;
+		if (i >= (int) cr->n_support) continue;
+		for (j = 0; j < i && match[i] == -1; j++)
+			if (cr->ids[j] == cr->ids[i]) match[i] = -2;
+		for (j = 0; j < contacts->n_contacts && match[i] == -1; j++)
+			if (contacts->contacts[j].id == cr->ids[i]) match[i] = j;
+	}
+
+	for (j = 0, n = 0; j < contacts->n_contacts; j++) {
+		keep = contacts->contacts[j].is_active;
+		for (i = 0; i < OPUS_MAX_CONTACTS; i++)
+			if (match[i] == j) keep = 1, match[i] = n;
+		if (keep) contacts->contacts[n++] = contacts->contacts[j];
+	}
+	contacts->n_contacts = n;
+}
+
+/**
+ * @brief add a contact point
+ * @return NULL if the manifold is full
+ */
+opus_contact* opus_contacts_add(opus_contacts* contacts, opus_body* A, opus_body* B, opus_vec2 pa, opus_vec2 pb, opus_vec2 normal, opus_real depth)
+{
+	opus_contact* contact;
+
+	if (contacts->n_contacts == OPUS_MAX_CONTACTS) return NULL;
+
+	contact = &contacts->contacts[contacts->n_contacts++];
+	contact_init_(contact, A, B, pa, pb, normal, depth);
+	return contact;
+}
+
+/* keep the order of the active points */
+void opus_contacts_remove_inactive(opus_contacts* contacts)
 {
-	opus_arr_destroy(contacts->contacts);
-	free(contacts);
+	int i, n;
+	for (i = 0, n = 0; i < contacts->n_contacts; i++)
+		if (contacts->contacts[i].is_active) contacts->contacts[n++] = contacts->contacts[i];
+	contacts->n_contacts = n;
 }
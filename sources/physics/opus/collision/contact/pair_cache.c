@@ -0,0 +1,223 @@
+/**
+ * @file pair_cache.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/3/20
+ *
+ * @brief open-addressing table keyed by a packed (min_id, max_id) pair, used to cache
+ * 		contact manifolds (and broad phase pairs) without formatting or hashing strings
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "physics/opus/physics.h"
+#include "physics/opus/physics_private.h"
+
+#define PAIR_CACHE_MIN_CAPACITY (16)
+#define PAIR_CACHE_GROW_AT_FACTOR (0.75)
+
+/**
+ * @brief mix both halves of the key (murmur3 finalizer), so that sequential ids
+ * 		do not cluster in the table
+ */
+static OPUS_INLINE uint64_t pair_hash_(uint64_t key)
+{
+	uint32_t h;
+	h = (uint32_t) key * 0xcc9e2d51u;
+	h ^= (uint32_t) (key >> 32) * 0x1b873593u;
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+static uint64_t get_proper_capacity_(uint64_t desired_capacity)
+{
+	uint64_t n_cap = PAIR_CACHE_MIN_CAPACITY;
+	while (n_cap < desired_capacity)
+		n_cap *= 2;
+	return n_cap;
+}
+
+static void clear_entries_(opus_pair_entry *entries, uint64_t n)
+{
+	uint64_t i;
+	for (i = 0; i < n; i++) {
+		entries[i].key   = OPUS_PAIR_KEY_EMPTY;
+		entries[i].value = NULL;
+	}
+}
+
+/**
+ * @brief pack two ids into one key, the smaller id is always stored in the upper half
+ * 		so that (a, b) and (b, a) produce the same key
+ * @param a
+ * @param b
+ * @return
+ */
+uint64_t opus_pair_key(uint64_t a, uint64_t b)
+{
+	OPUS_ASSERT(a <= 0xffffffffu && b <= 0xffffffffu);
+	return a < b ? (a << 32) | b : (b << 32) | a;
+}
+
+opus_pair_cache *opus_pair_cache_init(opus_pair_cache *cache, uint64_t capacity)
+{
+	if (!cache) return NULL;
+	cache->capacity = get_proper_capacity_(capacity);
+	cache->mask_    = cache->capacity - 1;
+	cache->count    = 0;
+	cache->grow_at_ = (uint64_t) ((double) cache->capacity * PAIR_CACHE_GROW_AT_FACTOR);
+	cache->entries  = OPUS_MALLOC(sizeof(opus_pair_entry) * cache->capacity);
+	if (!cache->entries) return NULL;
+	clear_entries_(cache->entries, cache->capacity);
+	return cache;
+}
+
+void opus_pair_cache_done(opus_pair_cache *cache)
+{
+	OPUS_FREE(cache->entries);
+	cache->capacity = 0;
+	cache->count    = 0;
+}
+
+void opus_pair_cache_clear(opus_pair_cache *cache)
+{
+	clear_entries_(cache->entries, cache->capacity);
+	cache->count = 0;
+}
+
+static int grow_(opus_pair_cache *cache)
+{
+	opus_pair_entry *old_entries, *new_entries;
+	uint64_t         i, j, old_capacity, new_capacity, mask;
+
+	old_entries  = cache->entries;
+	old_capacity = cache->capacity;
+	new_capacity = old_capacity * 2;
+	new_entries  = OPUS_MALLOC(sizeof(opus_pair_entry) * new_capacity);
+	if (!new_entries) return 0;
+	clear_entries_(new_entries, new_capacity);
+
+	/* re-insert all the entries, keys are unique so no comparison is needed */
+	mask = new_capacity - 1;
+	for (i = 0; i < old_capacity; i++) {
+		if (old_entries[i].key == OPUS_PAIR_KEY_EMPTY) continue;
+		j = pair_hash_(old_entries[i].key) & mask;
+		while (new_entries[j].key != OPUS_PAIR_KEY_EMPTY)
+			j = (j + 1) & mask;
+		new_entries[j] = old_entries[i];
+	}
+
+	OPUS_FREE(old_entries);
+	cache->entries  = new_entries;
+	cache->capacity = new_capacity;
+	cache->mask_    = mask;
+	cache->grow_at_ = (uint64_t) ((double) new_capacity * PAIR_CACHE_GROW_AT_FACTOR);
+	return 1;
+}
+
+/**
+ * @brief find the entry of the key
+ * @param cache
+ * @param key
+ * @return NULL if the key is not in the cache
+ */
+opus_pair_entry *opus_pair_cache_find(opus_pair_cache *cache, uint64_t key)
+{
+	opus_pair_entry *entry;
+	uint64_t         i;
+
+	i = pair_hash_(key) & cache->mask_;
+	for (;;) {
+		entry = &cache->entries[i];
+		if (entry->key == key) return entry;
+		if (entry->key == OPUS_PAIR_KEY_EMPTY) return NULL;
+		i = (i + 1) & cache->mask_;
+	}
+}
+
+/**
+ * @brief insert the key into the cache, if the key already exists, its value is replaced
+ * @param cache
+ * @param key
+ * @param value
+ * @return the entry holding the key, NULL if there is no enough memory
+ */
+opus_pair_entry *opus_pair_cache_insert(opus_pair_cache *cache, uint64_t key, void *value)
+{
+	opus_pair_entry *entry;
+	uint64_t         i;
+
+	OPUS_ASSERT(key != OPUS_PAIR_KEY_EMPTY);
+
+	if (cache->count >= cache->grow_at_ && !grow_(cache)) return NULL;
+
+	i = pair_hash_(key) & cache->mask_;
+	for (;;) {
+		entry = &cache->entries[i];
+		if (entry->key == OPUS_PAIR_KEY_EMPTY) {
+			entry->key = key;
+			cache->count++;
+			break;
+		}
+		if (entry->key == key) break;
+		i = (i + 1) & cache->mask_;
+	}
+	entry->value = value;
+	return entry;
+}
+
+/**
+ * @brief remove the entry at the slot and shift the following entries of the same
+ * 		cluster backward (no tombstones).
+ * 		NOTICE: the slot may be refilled by a shifted entry, so if you are iterating
+ * 		the cache, visit the same index again instead of advancing.
+ * @param cache
+ * @param index
+ */
+void opus_pair_cache_remove_at(opus_pair_cache *cache, uint64_t index)
+{
+	opus_pair_entry *entries = cache->entries;
+	uint64_t         hole, i, home;
+
+	OPUS_ASSERT(entries[index].key != OPUS_PAIR_KEY_EMPTY);
+
+	hole = index;
+	i    = (index + 1) & cache->mask_;
+	while (entries[i].key != OPUS_PAIR_KEY_EMPTY) {
+		home = pair_hash_(entries[i].key) & cache->mask_;
+		/* move the entry into the hole if its home slot is not in (hole, i] */
+		if (((i - home) & cache->mask_) >= ((i - hole) & cache->mask_)) {
+			entries[hole] = entries[i];
+			hole          = i;
+		}
+		i = (i + 1) & cache->mask_;
+	}
+	entries[hole].key   = OPUS_PAIR_KEY_EMPTY;
+	entries[hole].value = NULL;
+	cache->count--;
+}
+
+/**
+ * @brief remove the key from the cache
+ * @param cache
+ * @param key
+ * @return value of the removed entry, NULL if not found
+ */
+void *opus_pair_cache_remove(opus_pair_cache *cache, uint64_t key)
+{
+	opus_pair_entry *entry;
+	void            *value;
+
+	entry = opus_pair_cache_find(cache, key);
+	if (!entry) return NULL;
+	value = entry->value;
+	opus_pair_cache_remove_at(cache, (uint64_t) (entry - cache->entries));
+	return value;
+}
@@ -8,6 +8,13 @@
  *
  * @example
  *
+ * @brief bodies sleep by islands: the awake bodies are joined by union find over the touching
+ * 		contacts, joints and constraints at the end of every step, and an island falls asleep
+ * 		when all of its bodies have been resting long enough. Static and kinematic bodies do
+ * 		not join islands, so a pile on the ground is one island and not the whole level.
+ * 		The bodies of a sleeping island are linked in a ring, so that touching any of them
+ * 		wakes up all of them.
+ *
  * @development_log
  *
  */
@@ -16,134 +23,180 @@
 #include "physics/opus/physics_private.h"
 #include "data_structure/array.h"
 
-void opus_sleeping_wake_up(opus_body *body)
+/**
+ * @brief wake up the body and its whole island
+ * @param body
+ * @return number of bodies woken up
+ */
+int opus_sleeping_wake_up(opus_body *body)
 {
-	if (body->type != OPUS_BODY_STATIC) {
+	opus_body *b, *next;
+	int        n;
+
+	if (!body->island_next_) {
+		n                   = body->is_sleeping;
 		body->is_sleeping   = 0;
 		body->sleep_counter = 0;
+		return n;
 	}
+
+	/* break the ring */
+	b = body, n = 0;
+	do {
+		next             = b->island_next_;
+		b->island_next_  = NULL;
+		b->is_sleeping   = 0;
+		b->sleep_counter = 0;
+		n++;
+		b = next;
+	} while (b && b != body);
+
+	return n;
 }
 
-void opus_sleeping_fall_asleep(opus_physics_world *world, opus_body *body)
+/* awake bodies move and push the others, static and sleeping ones do not */
+int opus_sleeping_is_awake(opus_body *body)
 {
-	if (body->type != OPUS_BODY_KINEMATIC && body->joint_count == 0) {
-		body->is_sleeping   = 1;
-		body->sleep_counter = world->body_sleep_delay_counter;
-		opus_vec2_set(&body->velocity, 0, 0);
-		body->angular_velocity = 0;
-		body->motion           = 0;
-	}
+	return body->type != OPUS_BODY_STATIC && !body->is_sleeping;
 }
 
-void opus_sleeping_update(opus_physics_world *world, opus_real dt)
+/* neither body can move, nothing to detect or solve */
+int opus_sleeping_is_pair_asleep(opus_body *A, opus_body *B)
 {
-	uint64_t i;
+	return (!A || !opus_sleeping_is_awake(A)) && (!B || !opus_sleeping_is_awake(B));
+}
 
+/**
+ * @brief wake up the islands with forces applied by the user, called before the gravity is applied
+ * @param world
+ */
+void opus_sleeping_wake_forced(opus_physics_world *world)
+{
+	size_t     i;
 	opus_body *body;
-	opus_real  min_motion, max_motion;
-	opus_real  time_factor;
-
-	if (!world->enable_sleeping) return;
 
-	time_factor = dt * dt * dt;
 	for (i = 0; i < opus_arr_len(world->bodies); i++) {
 		body = world->bodies[i];
+		if (body->is_sleeping && (body->force.x != 0 || body->force.y != 0 || body->torque != 0))
+			world->woken_ += opus_sleeping_wake_up(body);
+	}
+}
 
-		/* an external force is applied */
-		if (!opus_vec2_equal(body->force, opus_vec2_(0, 0))) {
-			opus_sleeping_wake_up(body);
-			continue;
-		}
-
-		/* biased average motion estimation between frames */
-		min_motion        = opus_min(body->motion, body->prev_motion);
-		max_motion        = opus_max(body->motion, body->prev_motion);
-		body->prev_motion = body->motion;
-		body->motion      = world->body_min_motion_bias * min_motion +
-		               (1 - world->body_min_motion_bias) * max_motion;
-
-		if (body->is_sleeping) continue;
-
-		if (world->body_sleep_counter_threshold && body->motion < time_factor * world->body_sleep_motion_threshold) {
-			body->sleep_counter++;
-
-			if (body->sleep_counter >= world->body_sleep_counter_threshold)
-				opus_sleeping_fall_asleep(world, body);
-		} else {
-			if (body->sleep_counter > 0)
-				body->sleep_counter--;
-		}
+static int island_find_(int *parent, int i)
+{
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]]; /* path halving */
+		i         = parent[i];
 	}
+	return i;
 }
 
-void opus_sleeping_before_resolution(opus_physics_world *world)
+/* only the bodies which can sleep join islands */
+static void island_union_(int *parent, opus_body *A, opus_body *B)
 {
-	uint64_t i;
+	int a, b;
 
-	opus_contacts *contacts;
-	opus_body     *A, *B;
-
-	if (!world->enable_sleeping) return;
-
-	//	opus_hashmap_foreach_start(&world->contacts, contacts, i)
-	//	{
-	//		contacts = *(opus_contacts **) contacts;
-	//
-	//		A = contacts->A;
-	//		B = contacts->B;
-	//
-	//		opus_sleeping_wake_up(A);
-	//		opus_sleeping_wake_up(B);
-	//	}
-	//	opus_hashmap_foreach_end();
+	if (!A || !B) return;
+	if (A->type != OPUS_BODY_DYNAMIC && A->type != OPUS_BODY_BULLET) return;
+	if (B->type != OPUS_BODY_DYNAMIC && B->type != OPUS_BODY_BULLET) return;
+	if (A->is_sleeping || B->is_sleeping) return;
+
+	a = island_find_(parent, A->island_);
+	b = island_find_(parent, B->island_);
+	if (a != b) parent[a > b ? a : b] = a < b ? a : b; /* the smaller index is the root */
 }
 
-void opus_sleeping_after_collision(opus_physics_world *world, opus_real dt)
+/**
+ * @brief update the motion of the awake bodies, build the islands and put the resting ones
+ * 		to sleep. Called after the position resolution, when the contacts touching in the
+ * 		step are still active.
+ * @param world
+ * @param dt
+ */
+void opus_sleeping_update(opus_physics_world *world, opus_real dt)
 {
-	int      has_active_contact;
-	uint64_t i, j, n;
-
+	size_t         i, n;
+	int            j, root, *parent, *sleepy, *head;
+	int            has_active_contact;
+	opus_body     *body, *A, *B, *first;
 	opus_contacts *contacts;
-	opus_contact  *contact;
-	opus_body     *A, *B, *sleeping_body, *moving_body;
-	opus_real      wake_threshold, time_factor;
+	opus_real      min_motion, max_motion, threshold;
+
+	n = opus_arr_len(world->bodies);
+	opus_arr_resize(world->island_parent_, n);
+	opus_arr_resize(world->island_sleepy_, n);
+	parent = world->island_parent_;
+	sleepy = world->island_sleepy_;
+
+	/* biased average motion estimation between frames, count the resting steps */
+	threshold = dt * dt * dt * world->body_sleep_motion_threshold;
+	for (i = 0; i < n; i++) {
+		body          = world->bodies[i];
+		body->island_ = (int) i;
+		parent[i]     = (int) i;
+		sleepy[i]     = 1;
+		if (!opus_sleeping_is_awake(body)) continue;
 
-	if (!world->enable_sleeping) return;
+		min_motion        = opus_min(body->motion, body->prev_motion);
+		max_motion        = opus_max(body->motion, body->prev_motion);
+		body->prev_motion = body->motion;
+		body->motion      = world->body_min_motion_bias * min_motion + (1 - world->body_min_motion_bias) * max_motion;
 
-	time_factor    = dt * dt * dt;
-	wake_threshold = world->body_wake_motion_threshold * time_factor;
-	opus_hashmap_foreach_start(&world->contacts, contacts, i)
-	{
-		contacts = *(opus_contacts **) contacts;
+		if (body->motion < threshold) body->sleep_counter++;
+		else body->sleep_counter = 0;
+	}
 
-		n = opus_arr_len(contacts->contacts);
-		if (n == 0) continue;
+	for (i = 0; i < opus_arr_len(world->awake_contacts_); i++) {
+		contacts           = world->awake_contacts_[i];
 		has_active_contact = 0;
-		for (j = 0; j < n; j++) {
-			contact = contacts->contacts[j];
-			if (contact->is_active) {
-				has_active_contact       = 1;
-				contact->is_active       = 0;
-				contact->normal_impulse  = 0;
-				contact->tangent_impulse = 0;
-			}
-		}
-		if (!has_active_contact) continue;
+		for (j = 0; j < contacts->n_contacts; j++)
+			if (contacts->contacts[j].is_active) has_active_contact = 1;
+		if (has_active_contact) island_union_(parent, contacts->A, contacts->B);
+	}
+	for (i = 0; i < opus_arr_len(world->joints); i++) {
+		opus_joint_get_bodies(world->joints[i], &A, &B);
+		island_union_(parent, A, B);
+	}
+	for (i = 0; i < opus_arr_len(world->constraints); i++) {
+		opus_constraint_get_bodies(world->constraints[i], &A, &B);
+		island_union_(parent, A, B);
+	}
 
-		A = contacts->A;
-		B = contacts->B;
+	/* an island sleeps only if all of its bodies can, kinematic bodies never sleep */
+	for (i = 0; i < n; i++) {
+		body = world->bodies[i];
+		if (!opus_sleeping_is_awake(body)) continue;
+		if (body->type == OPUS_BODY_KINEMATIC || !world->body_sleep_counter_threshold ||
+		    body->sleep_counter < world->body_sleep_counter_threshold)
+			sleepy[island_find_(parent, (int) i)] = 0;
+	}
 
-		if (A->is_sleeping && B->is_sleeping) continue;
-		if (A->type == OPUS_BODY_STATIC || B->type == OPUS_BODY_STATIC) continue;
+	/* link the bodies of each sleeping island into a ring, the "sleepy" slot of the root
+	 * 		is reused to find the first body of the island */
+	for (i = 0; i < n; i++) {
+		body = world->bodies[i];
+		if (!opus_sleeping_is_awake(body) || body->type == OPUS_BODY_KINEMATIC) continue;
+		root = island_find_(parent, (int) i);
+		if (!sleepy[root]) continue;
+
+		head = &sleepy[root];
+		if (*head == 1) {
+			/* first body of the island, "sleepy" now stores its index offset by 2 */
+			body->island_next_ = body;
+			*head              = (int) i + 2;
+		} else {
+			first               = world->bodies[*head - 2];
+			body->island_next_  = first->island_next_;
+			first->island_next_ = body;
+		}
 
-		if (A->is_sleeping || B->is_sleeping) {
-			sleeping_body = (A->is_sleeping && A->type != OPUS_BODY_STATIC) ? A : B,
-			moving_body   = sleeping_body == A ? B : A;
+		body->is_sleeping      = 1;
+		body->sleep_counter    = 0;
+		body->motion           = 0;
+		body->angular_velocity = 0;
+		opus_vec2_set(&body->velocity, 0, 0);
 
-			if (sleeping_body->type != OPUS_BODY_STATIC && moving_body->motion > wake_threshold) {
-				opus_sleeping_wake_up(sleeping_body);
-			}
-		}
+		/* the broad phase does not update the bound of a sleeping body, it stays as it is now */
+		body->shape->update_bound(body->shape, body->rotation, body->position);
 	}
-	opus_hashmap_foreach_end();
 }
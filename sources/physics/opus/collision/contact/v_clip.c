@@ -11,10 +11,6 @@
  * @development_log
  *
  */
-#include "vg/vg_utils.h"
-#include "vg/vg_color.h"
-#include <stdio.h>
-
 #include <string.h>
 #include "physics/opus/physics.h"
 #include "physics/opus/physics_private.h"
@@ -47,9 +43,9 @@ static int VCLIP_polygon_polygon_find_clip_edge_(opus_vec2 *inc_s, opus_vec2 *in
                                                  opus_vec2 *ref_s, opus_vec2 *ref_e,
                                                  uint64_t *ref_idx, uint64_t *inc_idx,
                                                  opus_polygon *A,
-                                                 opus_polygon *B, opus_mat2d ta,
-                                                 opus_mat2d tb,
-                                                 opus_vec2  normal)
+                                                 opus_polygon *B, opus_transform *ta,
+                                                 opus_transform *tb,
+                                                 opus_vec2       normal)
 {
 	uint64_t  index_sa, index_sb; /* index of support point */
 	opus_vec2 sa, sb;             /* support point of A and B */
@@ -61,15 +57,15 @@ static int VCLIP_polygon_polygon_find_clip_edge_(opus_vec2 *inc_s, opus_vec2 *in
 	/* get support point */
 	sa = A->_.get_support((void *) A, ta, normal, &index_sa);
 	sb = B->_.get_support((void *) B, tb, opus_vec2_neg(normal), &index_sb);
-	sa = opus_mat2d_pre_mul_vec(ta, sa);
-	sb = opus_mat2d_pre_mul_vec(tb, sb);
+	sa = opus_transform_apply(ta, sa);
+	sb = opus_transform_apply(tb, sb);
 
 	idx1 = (B->n + index_sb - 1) % B->n;
 	idx2 = (index_sb + 1) % B->n;
 	p1   = B->vertices[idx1]; /* prev */
 	p2   = B->vertices[idx2]; /* next */
-	p1   = opus_mat2d_pre_mul_vec(tb, p1);
-	p2   = opus_mat2d_pre_mul_vec(tb, p2);
+	p1   = opus_transform_apply(tb, p1);
+	p2   = opus_transform_apply(tb, p2);
 	r1   = opus_vec2_dot(opus_vec2_to(p1, sb), normal);
 	r2   = opus_vec2_dot(opus_vec2_to(p2, sb), normal);
 	if (opus_abs(r1) < opus_abs(r2)) {
@@ -79,15 +75,15 @@ static int VCLIP_polygon_polygon_find_clip_edge_(opus_vec2 *inc_s, opus_vec2 *in
 	} else {
 		*inc_s   = sb;
 		*inc_e   = p2;
-		*inc_idx = idx2;
+		*inc_idx = index_sb;
 	}
 
 	idx1 = (A->n + index_sa - 1) % A->n;
 	idx2 = (index_sa + 1) % A->n;
 	p1   = A->vertices[idx1]; /* prev */
 	p2   = A->vertices[idx2]; /* next */
-	p1   = opus_mat2d_pre_mul_vec(ta, p1);
-	p2   = opus_mat2d_pre_mul_vec(ta, p2);
+	p1   = opus_transform_apply(ta, p1);
+	p2   = opus_transform_apply(ta, p2);
 	r1   = opus_vec2_dot(opus_vec2_to(p1, sa), normal);
 	r2   = opus_vec2_dot(opus_vec2_to(p2, sa), normal);
 	if (opus_abs(r1) < opus_abs(r2)) {
@@ -97,15 +93,16 @@ static int VCLIP_polygon_polygon_find_clip_edge_(opus_vec2 *inc_s, opus_vec2 *in
 	} else {
 		*ref_s   = sa;
 		*ref_e   = p2;
-		*ref_idx = idx2;
+		*ref_idx = index_sa;
 	}
 
 	/* compare which edge is more perpendicular to normal */
 	r1 = opus_abs(opus_vec2_dot(opus_vec2_to(*ref_s, *ref_e), normal));
 	r2 = opus_abs(opus_vec2_dot(opus_vec2_to(*inc_s, *inc_e), normal));
 
-	/* swap, reference edge should be more perpendicular to normal */
-	if (r1 > r2) {
+	/* swap, reference edge should be more perpendicular to normal, parallel edges (a resting
+	 * stack) only differ by rounding and keep the one SAT chose */
+	if (r1 - r2 > 64 * OPUS_REAL_EPSILON * opus_vec2_len(opus_vec2_to(*ref_s, *ref_e))) {
 		opus_vec2_swap(inc_s, ref_s);
 		opus_vec2_swap(inc_e, ref_e);
 		return 0;
@@ -134,7 +131,7 @@ static opus_clip_result VCLIP_polygon_polygon_(opus_overlap_result overlap)
 	/* get reference edge and incident edge */
 	is_ref_on_A = VCLIP_polygon_polygon_find_clip_edge_(&inc_s, &inc_e, &ref_s, &ref_e,
 	                                                    &ref_idx, &inc_idx,
-	                                                    A, B, overlap.transform_a, overlap.transform_b,
+	                                                    A, B, &overlap.transform_a, &overlap.transform_b,
 	                                                    overlap.normal);
 	OPUS_ASSERT(is_ref_on_A);
 
@@ -156,7 +153,6 @@ static opus_clip_result VCLIP_polygon_polygon_(opus_overlap_result overlap)
 	should_clip_e = !opus_is_point_on_same_side(ref_s, ref_e, p1, inc_e);
 	if (should_clip_s && !should_clip_e) inc_s = VCLIP_intersect_(ref_s, ref_e, inc_s, inc_e);
 	if (!should_clip_s && should_clip_e) inc_e = VCLIP_intersect_(ref_s, ref_e, inc_s, inc_e);
-	if (should_clip_s && should_clip_e) { printf("<0\n"); }
 
 	/* last we project incident edge points on reference edge */
 	p1 = opus_nearest_point_on_line(ref_s, ref_e, inc_s);
@@ -174,6 +170,8 @@ static opus_clip_result VCLIP_polygon_polygon_(opus_overlap_result overlap)
 	result.B       = (void *) B;
 	result.ref_idx = ref_idx;
 	result.inc_idx = inc_idx;
+	result.ids[0]  = opus_feature_id(ref_idx, inc_idx, 0);
+	result.ids[1]  = opus_feature_id(ref_idx, inc_idx, 1);
 
 	return result;
 }
@@ -182,9 +180,9 @@ opus_clip_result VCLIP_polygon_circle_(opus_overlap_result overlap)
 {
 	opus_clip_result result = {0};
 
-	opus_polygon *A;
-	opus_circle  *B;
-	opus_mat2d    ta, tb;
+	opus_polygon   *A;
+	opus_circle    *B;
+	opus_transform *ta, *tb;
 
 	opus_vec2 support_a, center, support_b, p1, p2;
 	opus_vec2 ref_s, ref_e;
@@ -194,16 +192,16 @@ opus_clip_result VCLIP_polygon_circle_(opus_overlap_result overlap)
 	OPUS_ASSERT(overlap.A->type_ == OPUS_SHAPE_POLYGON);
 	OPUS_ASSERT(overlap.B->type_ == OPUS_SHAPE_CIRCLE);
 
-	A = (void *) overlap.A;
-	opus_mat2d_copy(ta, overlap.transform_a);
-	B = (void *) overlap.B;
-	opus_mat2d_copy(tb, overlap.transform_b);
+	A  = (void *) overlap.A;
+	ta = &overlap.transform_a;
+	B  = (void *) overlap.B;
+	tb = &overlap.transform_b;
 
 	support_a = A->_.get_support((void *) A, ta, overlap.normal, &index_support);
-	support_a = opus_mat2d_pre_mul_vec(ta, support_a);
+	support_a = opus_transform_apply(ta, support_a);
 
 	/* get support of the circle */
-	center    = opus_mat2d_pre_mul_vec(tb, opus_vec2_(0, 0)); /* real center of the circle */
+	center    = tb->p; /* real center of the circle */
 	support_b = opus_vec2_neg(overlap.normal);
 	support_b = opus_vec2_scale(support_b, B->radius);
 	support_b = opus_vec2_add(support_b, center);
@@ -211,8 +209,8 @@ opus_clip_result VCLIP_polygon_circle_(opus_overlap_result overlap)
 	/* get reference edge of the polygon */
 	p1 = A->vertices[(A->n + index_support - 1) % A->n]; /* prev */
 	p2 = A->vertices[(index_support + 1) % A->n];        /* next */
-	p1 = opus_mat2d_pre_mul_vec(ta, p1);
-	p2 = opus_mat2d_pre_mul_vec(ta, p2);
+	p1 = opus_transform_apply(ta, p1);
+	p2 = opus_transform_apply(ta, p2);
 	r1 = opus_vec2_dot(opus_vec2_to(p1, support_a), overlap.normal);
 	r2 = opus_vec2_dot(opus_vec2_to(p2, support_a), overlap.normal);
 	if (opus_abs(r1) < opus_abs(r2)) {
@@ -223,12 +221,6 @@ opus_clip_result VCLIP_polygon_circle_(opus_overlap_result overlap)
 		ref_e = p2;
 	}
 
-	extern plutovg_t *pl;
-	opus_pl_line_vec(pl, ref_s, ref_e);
-	plutovg_set_source_rgb(pl, COLOR_RED);
-	plutovg_set_line_width(pl, 2);
-	plutovg_stroke(pl);
-
 	result.A              = (void *) A;
 	result.B              = (void *) B;
 	result.n_support      = 1;
@@ -238,6 +230,26 @@ opus_clip_result VCLIP_polygon_circle_(opus_overlap_result overlap)
 	return result;
 }
 
+static opus_clip_result VCLIP_circle_circle_(opus_overlap_result overlap)
+{
+	opus_clip_result result = {0};
+	opus_circle     *A, *B;
+	opus_vec2        ca, cb;
+
+	A  = (void *) overlap.A;
+	B  = (void *) overlap.B;
+	ca = overlap.transform_a.p;
+	cb = overlap.transform_b.p;
+
+	result.A              = (void *) A;
+	result.B              = (void *) B;
+	result.n_support      = 1;
+	result.supports[0][0] = opus_vec2_add(ca, opus_vec2_scale(overlap.normal, A->radius));
+	result.supports[0][1] = opus_vec2_sub(cb, opus_vec2_scale(overlap.normal, B->radius));
+
+	return result;
+}
+
 /**
  * @brief Sutherland Hodgman polygon clipping method
  * @param overlap
@@ -256,5 +268,7 @@ opus_clip_result opus_VCLIP(opus_overlap_result overlap)
 		return VCLIP_polygon_circle_(overlap);
 	if (A->type_ == OPUS_SHAPE_CIRCLE && B->type_ == OPUS_SHAPE_POLYGON)
 		return VCLIP_polygon_circle_(overlap);
+	if (A->type_ == OPUS_SHAPE_CIRCLE && B->type_ == A->type_)
+		return VCLIP_circle_circle_(overlap);
 	return r0;
 }
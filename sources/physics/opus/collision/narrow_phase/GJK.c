@@ -8,6 +8,496 @@
  *
  * @example
  *
+ * opus_gjk_simplex simplex = {0}; // keep it with the pair between the steps
+ * opus_overlap_result r = opus_GJK(A, B, ta, tb, &simplex);
+ *
+ * @brief GJK works on the Minkowski difference A - B through the support callbacks of the
+ * 		shapes, the simplex is solved for the closest point to the origin with barycentric
+ * 		coordinates (so it also gives the distance and the closest points). If the
+ * 		origin is inside, EPA expands the simplex to find the penetration.
+ * 		Circles never go through GJK, they have analytic kernels.
+ *
  * @development_log
  *
  */
+
+#include "physics/opus/physics.h"
+#include "physics/opus/physics_private.h"
+
+#define GJK_MAX_ITERATIONS (32)
+#define GJK_TOLERANCE (1e-9)
+#define EPA_MAX_VERTICES (48)
+#define EPA_TOLERANCE (1e-6)
+
+typedef struct gjk_vertex_ gjk_vertex_;
+
+struct gjk_vertex_ {
+	opus_vec2 a, b; /* support points of A and B in world space */
+	opus_vec2 w;    /* a - b */
+	opus_vec2 dir;  /* search direction the vertex is found with */
+	opus_real u;    /* barycentric coordinate of the closest point */
+};
+
+typedef struct gjk_simplex_ {
+	gjk_vertex_ v[3];
+	int         n;
+} gjk_simplex_;
+
+static opus_vec2 GJK_center_(opus_transform *transform)
+{
+	return transform->p;
+}
+
+/* world space support point of the shape in the direction */
+static opus_vec2 GJK_support_(opus_shape *shape, opus_transform *transform, opus_vec2 dir)
+{
+	size_t    index;
+	opus_real len;
+
+	/* the support callback of the circle gives a direction instead of a local point */
+	if (shape->type_ == OPUS_SHAPE_CIRCLE) {
+		len = opus_vec2_len(dir);
+		if (len == 0) return GJK_center_(transform);
+		return opus_vec2_add(GJK_center_(transform), opus_vec2_scale(dir, ((opus_circle *) shape)->radius / len));
+	}
+	return opus_transform_apply(transform, shape->get_support(shape, transform, dir, &index));
+}
+
+static void GJK_vertex_(gjk_vertex_ *v, opus_shape *A, opus_shape *B, opus_transform *ta, opus_transform *tb, opus_vec2 dir)
+{
+	v->dir = dir;
+	v->a   = GJK_support_(A, ta, dir);
+	v->b   = GJK_support_(B, tb, opus_vec2_neg(dir));
+	v->w   = opus_vec2_sub(v->a, v->b);
+	v->u   = 1;
+}
+
+/* closest point of the segment to the origin */
+static void GJK_solve2_(gjk_simplex_ *s)
+{
+	opus_vec2 w1 = s->v[0].w, w2 = s->v[1].w, e12;
+	opus_real d12_1, d12_2;
+
+	e12   = opus_vec2_sub(w2, w1);
+	d12_2 = -opus_vec2_dot(w1, e12);
+	if (d12_2 <= 0) { /* w1 region */
+		s->v[0].u = 1;
+		s->n      = 1;
+		return;
+	}
+	d12_1 = opus_vec2_dot(w2, e12);
+	if (d12_1 <= 0) { /* w2 region */
+		s->v[0]   = s->v[1];
+		s->v[0].u = 1;
+		s->n      = 1;
+		return;
+	}
+	s->v[0].u = d12_1 / (d12_1 + d12_2);
+	s->v[1].u = d12_2 / (d12_1 + d12_2);
+	s->n      = 2;
+}
+
+/* closest point of the triangle to the origin, n stays 3 if the origin is inside */
+static void GJK_solve3_(gjk_simplex_ *s)
+{
+	opus_vec2 w1 = s->v[0].w, w2 = s->v[1].w, w3 = s->v[2].w;
+	opus_vec2 e12, e13, e23;
+	opus_real d12_1, d12_2, d13_1, d13_2, d23_1, d23_2;
+	opus_real n123, d123_1, d123_2, d123_3, inv;
+
+	e12   = opus_vec2_sub(w2, w1);
+	d12_1 = opus_vec2_dot(w2, e12);
+	d12_2 = -opus_vec2_dot(w1, e12);
+
+	e13   = opus_vec2_sub(w3, w1);
+	d13_1 = opus_vec2_dot(w3, e13);
+	d13_2 = -opus_vec2_dot(w1, e13);
+
+	e23   = opus_vec2_sub(w3, w2);
+	d23_1 = opus_vec2_dot(w3, e23);
+	d23_2 = -opus_vec2_dot(w2, e23);
+
+	n123   = opus_vec2_cross(e12, e13);
+	d123_1 = n123 * opus_vec2_cross(w2, w3);
+	d123_2 = n123 * opus_vec2_cross(w3, w1);
+	d123_3 = n123 * opus_vec2_cross(w1, w2);
+
+	if (d12_2 <= 0 && d13_2 <= 0) { /* w1 region */
+		s->v[0].u = 1;
+		s->n      = 1;
+	} else if (d12_1 > 0 && d12_2 > 0 && d123_3 <= 0) { /* e12 region */
+		inv       = 1 / (d12_1 + d12_2);
+		s->v[0].u = d12_1 * inv;
+		s->v[1].u = d12_2 * inv;
+		s->n      = 2;
+	} else if (d13_1 > 0 && d13_2 > 0 && d123_2 <= 0) { /* e13 region */
+		inv       = 1 / (d13_1 + d13_2);
+		s->v[0].u = d13_1 * inv;
+		s->v[1]   = s->v[2];
+		s->v[1].u = d13_2 * inv;
+		s->n      = 2;
+	} else if (d12_1 <= 0 && d23_2 <= 0) { /* w2 region */
+		s->v[0]   = s->v[1];
+		s->v[0].u = 1;
+		s->n      = 1;
+	} else if (d13_1 <= 0 && d23_1 <= 0) { /* w3 region */
+		s->v[0]   = s->v[2];
+		s->v[0].u = 1;
+		s->n      = 1;
+	} else if (d23_1 > 0 && d23_2 > 0 && d123_1 <= 0) { /* e23 region */
+		inv       = 1 / (d23_1 + d23_2);
+		s->v[0]   = s->v[2];
+		s->v[0].u = d23_2 * inv;
+		s->v[1].u = d23_1 * inv;
+		s->n      = 2;
+	} else { /* inside */
+		inv       = 1 / (d123_1 + d123_2 + d123_3);
+		s->v[0].u = d123_1 * inv;
+		s->v[1].u = d123_2 * inv;
+		s->v[2].u = d123_3 * inv;
+	}
+}
+
+static opus_vec2 GJK_closest_(gjk_simplex_ *s)
+{
+	int       i;
+	opus_vec2 p = opus_vec2_(0, 0);
+	for (i = 0; i < s->n; i++) p = opus_vec2_add(p, opus_vec2_scale(s->v[i].w, s->v[i].u));
+	return p;
+}
+
+/* towards the origin, perpendicular to the edge so that it does not suffer from the
+ * 		precision of the closest point */
+static opus_vec2 GJK_search_dir_(gjk_simplex_ *s)
+{
+	opus_vec2 e12;
+	if (s->n == 1) return opus_vec2_neg(s->v[0].w);
+	e12 = opus_vec2_sub(s->v[1].w, s->v[0].w);
+	if (opus_vec2_cross(e12, opus_vec2_neg(s->v[0].w)) > 0) return opus_vec2_(-e12.y, e12.x);
+	return opus_vec2_(e12.y, -e12.x);
+}
+
+/**
+ * @brief run GJK, the simplex is warm started from "cache" if it has any vertex
+ * @return 1 if the origin is inside the simplex (the shapes overlap)
+ */
+static int GJK_run_(gjk_simplex_ *s, opus_shape *A, opus_shape *B, opus_transform *ta, opus_transform *tb,
+                    opus_gjk_simplex *cache)
+{
+	int       i, iter, is_overlap = 0;
+	opus_vec2 d, p;
+	opus_real len2;
+
+	s->n = 0;
+	if (cache)
+		for (i = 0; i < cache->n && i < 3; i++) GJK_vertex_(&s->v[s->n++], A, B, ta, tb, cache->dirs[i]);
+	if (s->n == 0) {
+		d = opus_vec2_sub(GJK_center_(tb), GJK_center_(ta));
+		if (opus_vec2_len2(d) == 0) d = opus_vec2_(1, 0);
+		GJK_vertex_(&s->v[s->n++], A, B, ta, tb, d);
+	}
+
+	for (iter = 0; iter < GJK_MAX_ITERATIONS; iter++) {
+		if (s->n == 2) GJK_solve2_(s);
+		if (s->n == 3) GJK_solve3_(s);
+		if (s->n == 3) {
+			is_overlap = 1;
+			break;
+		}
+
+		d    = GJK_search_dir_(s);
+		len2 = opus_vec2_len2(d);
+		/* the origin is on the simplex, touching counts as overlapping here */
+		if (len2 < GJK_TOLERANCE * GJK_TOLERANCE) {
+			is_overlap = 1;
+			break;
+		}
+
+		/* no progress towards the origin, converged */
+		p = GJK_closest_(s);
+		GJK_vertex_(&s->v[s->n], A, B, ta, tb, d);
+		if (opus_vec2_dot(opus_vec2_sub(s->v[s->n].w, p), d) <= GJK_TOLERANCE * opus_sqrt(len2)) break;
+		s->n++;
+	}
+	/* out of iterations, the last vertex is not solved yet */
+	if (iter == GJK_MAX_ITERATIONS) {
+		if (s->n == 2) GJK_solve2_(s);
+		if (s->n == 3) GJK_solve3_(s);
+		is_overlap = s->n == 3;
+	}
+
+	if (cache) {
+		cache->n = s->n;
+		for (i = 0; i < s->n; i++) cache->dirs[i] = s->v[i].dir;
+	}
+
+	return is_overlap;
+}
+
+/**
+ * @brief expand the triangle containing the origin to the edge of A - B closest to the origin
+ * @param s
+ * @param normal from A to B
+ * @return penetration depth
+ */
+static opus_real EPA_run_(gjk_simplex_ *s, opus_shape *A, opus_shape *B, opus_transform *ta, opus_transform *tb,
+                          opus_vec2 *normal)
+{
+	gjk_vertex_ poly[EPA_MAX_VERTICES], v;
+	size_t      i, j, n, closest;
+	opus_vec2   e, nrm, best_n;
+	opus_real   dist, best, len, d;
+
+	poly[0] = s->v[0];
+	poly[1] = s->v[1];
+	poly[2] = s->v[2];
+	n       = 3;
+	/* make it counter clockwise, so that (e.y, -e.x) points outside */
+	if (opus_vec2_cross(opus_vec2_sub(poly[1].w, poly[0].w), opus_vec2_sub(poly[2].w, poly[0].w)) < 0) {
+		v       = poly[1];
+		poly[1] = poly[2];
+		poly[2] = v;
+	}
+
+	best_n = opus_vec2_(0, 0);
+	best   = 0;
+	for (;;) {
+		closest = 0;
+		best    = OPUS_REAL_MAX;
+		for (i = 0; i < n; i++) {
+			j   = (i + 1) % n;
+			e   = opus_vec2_sub(poly[j].w, poly[i].w);
+			len = opus_vec2_len(e);
+			if (len == 0) continue;
+			nrm  = opus_vec2_(e.y / len, -e.x / len);
+			dist = opus_vec2_dot(nrm, poly[i].w);
+			if (dist < best) {
+				best    = dist;
+				best_n  = nrm;
+				closest = i;
+			}
+		}
+		if (best == OPUS_REAL_MAX) return 0; /* degenerated */
+
+		GJK_vertex_(&v, A, B, ta, tb, best_n);
+		d = opus_vec2_dot(v.w, best_n);
+		if (d - best <= EPA_TOLERANCE * opus_max(1, opus_abs(d)) || n == EPA_MAX_VERTICES) break;
+
+		/* insert the new vertex between the two of the closest edge */
+		for (i = n; i > closest + 1; i--) poly[i] = poly[i - 1];
+		poly[closest + 1] = v;
+		n++;
+	}
+
+	*normal = best_n;
+	return best;
+}
+
+/* the same choice as "VCLIP_polygon_polygon_find_clip_edge_", the edge at the support point
+ * 		more perpendicular to the normal is the reference edge */
+static opus_real GJK_clip_edge_alignment_(opus_polygon *polygon, opus_transform *transform, opus_vec2 dir, opus_vec2 normal)
+{
+	size_t    index;
+	opus_vec2 s, p1, p2;
+	opus_real r1, r2;
+
+	s  = opus_transform_apply(transform, polygon->_.get_support((void *) polygon, transform, dir, &index));
+	p1 = opus_transform_apply(transform, polygon->vertices[(polygon->n + index - 1) % polygon->n]);
+	p2 = opus_transform_apply(transform, polygon->vertices[(index + 1) % polygon->n]);
+	r1 = opus_vec2_dot(opus_vec2_to(p1, s), normal);
+	r2 = opus_vec2_dot(opus_vec2_to(p2, s), normal);
+	return opus_abs(r1) < opus_abs(r2) ? opus_abs(r1) : opus_abs(r2);
+}
+
+static opus_overlap_result GJK_polygon_polygon_(opus_polygon *A, opus_polygon *B, opus_transform *ta, opus_transform *tb,
+                                                opus_gjk_simplex *cache)
+{
+	opus_overlap_result result = {0};
+	gjk_simplex_        s;
+	opus_vec2           normal;
+	opus_real           depth;
+
+	if (!GJK_run_(&s, (opus_shape *) A, (opus_shape *) B, ta, tb, cache)) return result;
+	/* touching only, nothing to resolve */
+	if (s.n < 3) return result;
+
+	depth = EPA_run_(&s, (opus_shape *) A, (opus_shape *) B, ta, tb, &normal);
+	if (depth <= 0) return result;
+
+	result.is_overlap = 1;
+	result.separation = depth;
+
+	/* "opus_VCLIP" expects the reference edge on A */
+	if (GJK_clip_edge_alignment_(A, ta, normal, normal) <= GJK_clip_edge_alignment_(B, tb, opus_vec2_neg(normal), normal)) {
+		result.A           = (opus_shape *) A;
+		result.B           = (opus_shape *) B;
+		result.normal      = normal;
+		result.transform_a = *ta;
+		result.transform_b = *tb;
+	} else {
+		result.A           = (opus_shape *) B;
+		result.B           = (opus_shape *) A;
+		result.normal      = opus_vec2_neg(normal);
+		result.transform_a = *tb;
+		result.transform_b = *ta;
+	}
+
+	return result;
+}
+
+/**
+ * @brief
+ * @param A
+ * @param B
+ * @param transform_a
+ * @param transform_b
+ * @return normal from A to B and the penetration depth
+ */
+opus_overlap_result opus_collide_circle_circle(opus_circle *A, opus_circle *B, opus_transform *transform_a, opus_transform *transform_b)
+{
+	opus_overlap_result result = {0};
+	opus_vec2           d;
+	opus_real           dist, depth;
+
+	d     = opus_vec2_sub(GJK_center_(transform_b), GJK_center_(transform_a));
+	dist  = opus_vec2_len(d);
+	depth = A->radius + B->radius - dist;
+	if (depth <= 0) return result;
+
+	result.is_overlap  = 1;
+	result.separation  = depth;
+	result.normal      = dist > 0 ? opus_vec2_scale(d, 1 / dist) : opus_vec2_(0, 1);
+	result.A           = (opus_shape *) A;
+	result.B           = (opus_shape *) B;
+	result.transform_a = *transform_a;
+	result.transform_b = *transform_b;
+
+	return result;
+}
+
+/**
+ * @brief the face of the polygon with maximum separation from the center of the circle, or
+ * 		one of its vertices if the center is outside the face, solved in the local space
+ * 		of the polygon
+ * @param A
+ * @param B
+ * @param transform_a
+ * @param transform_b
+ * @return normal from A to B and the penetration depth
+ */
+opus_overlap_result opus_collide_polygon_circle(opus_polygon *A, opus_circle *B, opus_transform *transform_a, opus_transform *transform_b)
+{
+	opus_overlap_result result = {0};
+
+	size_t    i, face;
+	opus_vec2 c, d, e, v1, v2, n, face_n;
+	opus_real s, separation, len, u1, u2, depth;
+
+	/* center of the circle in the space of the polygon, the inverse of the rotation is its transpose */
+	d = opus_vec2_sub(GJK_center_(transform_b), GJK_center_(transform_a));
+	c = opus_transform_rotate_inv(transform_a, d);
+
+	separation = -OPUS_REAL_MAX;
+	face       = 0;
+	face_n     = opus_vec2_(0, 0);
+	for (i = 0; i < A->n; i++) {
+		v1  = A->vertices[i];
+		e   = opus_vec2_sub(A->vertices[(i + 1) % A->n], v1);
+		len = opus_vec2_len(e);
+		if (len == 0) continue;
+		n = opus_vec2_(e.y / len, -e.x / len);
+		if (opus_vec2_dot(n, v1) < 0) n = opus_vec2_neg(n); /* the polygon is centered on the origin */
+
+		s = opus_vec2_dot(n, opus_vec2_sub(c, v1));
+		if (s > B->radius) return result;
+		if (s > separation) {
+			separation = s;
+			face       = i;
+			face_n     = n;
+		}
+	}
+
+	v1 = A->vertices[face];
+	v2 = A->vertices[(face + 1) % A->n];
+	n  = face_n;
+	if (separation > 0) {
+		u1 = opus_vec2_dot(opus_vec2_sub(c, v1), opus_vec2_sub(v2, v1));
+		u2 = opus_vec2_dot(opus_vec2_sub(c, v2), opus_vec2_sub(v1, v2));
+		if (u1 <= 0 || u2 <= 0) {
+			/* vertex region */
+			d   = opus_vec2_sub(c, u1 <= 0 ? v1 : v2);
+			len = opus_vec2_len(d);
+			if (len >= B->radius) return result;
+			n          = opus_vec2_scale(d, 1 / len);
+			separation = len;
+		}
+	}
+	depth = B->radius - separation;
+	if (depth <= 0) return result;
+
+	result.is_overlap  = 1;
+	result.separation  = depth;
+	result.normal      = opus_transform_rotate(transform_a, n);
+	result.A           = (opus_shape *) A;
+	result.B           = (opus_shape *) B;
+	result.transform_a = *transform_a;
+	result.transform_b = *transform_b;
+
+	return result;
+}
+
+/**
+ * @brief overlap test with penetration, the result can be passed to "opus_VCLIP" like the
+ * 		one of "opus_SAT"
+ * @param A
+ * @param B
+ * @param transform_a
+ * @param transform_b
+ * @param simplex warm start of the pair (A, B) from the last step, updated for the next one,
+ * 		can be NULL
+ * @return
+ */
+opus_overlap_result opus_GJK(opus_shape *A, opus_shape *B, opus_transform *transform_a, opus_transform *transform_b,
+                             opus_gjk_simplex *simplex)
+{
+	opus_overlap_result r0 = {0}; /* just for invalid return */
+	if (A->type_ == OPUS_SHAPE_CIRCLE && B->type_ == OPUS_SHAPE_CIRCLE)
+		return opus_collide_circle_circle((void *) A, (void *) B, transform_a, transform_b);
+	if (A->type_ == OPUS_SHAPE_POLYGON && B->type_ == OPUS_SHAPE_CIRCLE)
+		return opus_collide_polygon_circle((void *) A, (void *) B, transform_a, transform_b);
+	if (A->type_ == OPUS_SHAPE_CIRCLE && B->type_ == OPUS_SHAPE_POLYGON)
+		return opus_collide_polygon_circle((void *) B, (void *) A, transform_b, transform_a);
+	if (A->type_ == OPUS_SHAPE_POLYGON && B->type_ == OPUS_SHAPE_POLYGON)
+		return GJK_polygon_polygon_((void *) A, (void *) B, transform_a, transform_b, simplex);
+	return r0;
+}
+
+/**
+ * @brief distance between two convex shapes
+ * @param A
+ * @param B
+ * @param transform_a
+ * @param transform_b
+ * @param simplex warm start, can be NULL
+ * @param pa closest point on A, can be NULL
+ * @param pb closest point on B, can be NULL
+ * @return 0 if overlapping
+ */
+opus_real opus_GJK_distance(opus_shape *A, opus_shape *B, opus_transform *transform_a, opus_transform *transform_b,
+                            opus_gjk_simplex *simplex, opus_vec2 *pa, opus_vec2 *pb)
+{
+	gjk_simplex_ s;
+	opus_vec2    a, b;
+	int          i;
+
+	if (GJK_run_(&s, A, B, transform_a, transform_b, simplex)) return 0;
+
+	a = b = opus_vec2_(0, 0);
+	for (i = 0; i < s.n; i++) {
+		a = opus_vec2_add(a, opus_vec2_scale(s.v[i].a, s.v[i].u));
+		b = opus_vec2_add(b, opus_vec2_scale(s.v[i].b, s.v[i].u));
+	}
+	if (pa) *pa = a;
+	if (pb) *pb = b;
+	return opus_vec2_dist(a, b);
+}
@@ -12,27 +12,36 @@
  *
  */
 
-#include <string.h>
 #include <stdlib.h>
+#include "data_structure/array.h"
 #include "physics/opus/physics.h"
 #include "physics/opus/physics_private.h"
 #include "math/geometry.h"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SAT_SSE2_
+#include <emmintrin.h>
+#endif
+
+#define SAT_PAD (4) /* vertices of a cached polygon are padded to a multiple of this */
+#define SAT_REFERENCE_TOLERANCE (0.05) /* B only takes the reference edge from a parallel edge of A if it is better by this much */
+#define SAT_PARALLEL_TOLERANCE (0.05)  /* sine of the angle between two edges taken as parallel */
+
 struct overlap_ {
 	opus_real overlap;
 	opus_vec2 axis;
 };
 
-static opus_vec2 *SAT_get_transformed_vertices_(opus_polygon *polygon,
-                                                opus_mat2d    transform)
+static opus_vec2 *SAT_get_transformed_vertices_(opus_polygon   *polygon,
+                                                opus_transform *transform)
 {
 	size_t     i;
 	opus_vec2 *vertices = malloc(sizeof(opus_vec2) * polygon->n);
 	if (vertices) {
-		memcpy(vertices, polygon->vertices, sizeof(opus_vec2) * polygon->n);
 		for (i = 0; i < polygon->n; i++)
-			opus_mar2d_pre_mul_xy(&vertices[i].x, &vertices[i].y, transform, vertices[i].x,
-			                      vertices[i].y);
+			vertices[i] = opus_transform_apply(transform, polygon->vertices[i]);
 	}
 	return vertices;
 }
@@ -93,18 +102,51 @@ static int SAT_overlap_axes_(struct overlap_ *result, opus_vec2 *verts_a, opus_v
 	return 1; /* overlap */
 }
 
-static opus_overlap_result SAT_polygon_polygon_(opus_polygon *A,
-                                                opus_polygon *B,
-                                                opus_mat2d transform_a, opus_mat2d transform_b)
+/* "rb" is the result of the axes of B and "ra" of the axes of A, both overlapping */
+static void SAT_set_polygon_polygon_result_(opus_overlap_result *result, struct overlap_ *ra, struct overlap_ *rb,
+                                            opus_polygon *A, opus_polygon *B,
+                                            opus_transform *transform_a, opus_transform *transform_b)
+{
+	struct overlap_ r;
+	opus_vec2       c1, c2;
+	int             swap_factor = 1;
+
+	result->is_overlap = 1; /* has an axis, then it is overlapping */
+
+	/* meet detector result requirements */
+	/* 1st: make sure A is where reference edge lies. Two parallel faces (of a resting stack)
+	 * 		are almost equally good, do not let the reference flip between them every step. */
+	if (ra->overlap < rb->overlap ||
+	    (ra->overlap < rb->overlap + SAT_REFERENCE_TOLERANCE && opus_abs(opus_vec2_cross(ra->axis, rb->axis)) < SAT_PARALLEL_TOLERANCE)) {
+		r                   = *ra;
+		result->transform_a = *transform_a;
+		result->transform_b = *transform_b;
+		result->A           = (opus_shape *) A;
+		result->B           = (opus_shape *) B;
+	} else {
+		r                   = *rb;
+		swap_factor         = -1;
+		result->transform_a = *transform_b;
+		result->transform_b = *transform_a;
+		result->A           = (opus_shape *) B;
+		result->B           = (opus_shape *) A;
+	}
+	/* 2nd: make sure normal is pointing to B */
+	c1                 = transform_a->p;
+	c2                 = transform_b->p;
+	result->normal     = opus_vec2_dot(opus_vec2_to(c1, c2), r.axis) * swap_factor < 0 ? opus_vec2_neg(r.axis) : r.axis;
+	result->separation = r.overlap;
+}
+
+static opus_overlap_result SAT_polygon_polygon_(opus_polygon   *A,
+                                                opus_polygon   *B,
+                                                opus_transform *transform_a, opus_transform *transform_b)
 {
 	opus_overlap_result result = {0};
-	struct overlap_     r, ra, rb;
+	struct overlap_     ra, rb;
 
-	opus_vec2  c1, c2;
 	opus_vec2 *verts_a = NULL, *verts_b = NULL;
 
-	int swap_factor = 1;
-
 	/* when using SAT, we must first translate the local vertices to world vertices */
 	verts_a = SAT_get_transformed_vertices_(A, transform_a);
 	verts_b = SAT_get_transformed_vertices_(B, transform_b);
@@ -116,31 +158,7 @@ static opus_overlap_result SAT_polygon_polygon_(opus_polygon *A,
 	if (rb.overlap <= 0) goto EXIT_AND_CLEANUP;
 	SAT_overlap_axes_(&ra, verts_b, verts_a, B->n, A->n);
 	if (ra.overlap <= 0) goto EXIT_AND_CLEANUP;
-	result.is_overlap = 1; /* has an axis, then it is overlapping */
-
-	/* meet detector result requirements */
-	/* 1st: make sure A is where reference edge lies */
-	if (ra.overlap < rb.overlap) {
-		r = ra;
-		opus_mat2d_copy(result.transform_a, transform_a);
-		opus_mat2d_copy(result.transform_b, transform_b);
-		result.A = (opus_shape *) A;
-		result.B = (opus_shape *) B;
-	} else {
-		r           = rb;
-		swap_factor = -1;
-		opus_mat2d_copy(result.transform_a, transform_b);
-		opus_mat2d_copy(result.transform_b, transform_a);
-		result.A = (opus_shape *) B;
-		result.B = (opus_shape *) A;
-	}
-	/* 2nd: make sure normal is pointing to B */
-	opus_mar2d_pre_mul_xy(&c1.x, &c1.y, transform_a, 0, 0);
-	opus_mar2d_pre_mul_xy(&c2.x, &c2.y, transform_b, 0, 0);
-	result.normal     = opus_vec2_dot(opus_vec2_to(c1, c2), r.axis) * swap_factor < 0 ? opus_vec2_neg(r.axis) : r.axis;
-	result.separation = r.overlap;
-
-	return result;
+	SAT_set_polygon_polygon_result_(&result, &ra, &rb, A, B, transform_a, transform_b);
 
 EXIT_AND_CLEANUP:
 	if (verts_a) free(verts_a);
@@ -149,9 +167,26 @@ EXIT_AND_CLEANUP:
 	return result;
 }
 
-static opus_overlap_result SAT_polygon_circle_(opus_polygon *A,
-                                               opus_circle  *B,
-                                               opus_mat2d transform_a, opus_mat2d transform_b)
+static void SAT_set_polygon_circle_result_(opus_overlap_result *result, opus_real min_overlap, opus_vec2 min_axis,
+                                           opus_vec2 center_a, opus_vec2 center_b, opus_polygon *A, opus_circle *B,
+                                           opus_transform *transform_a, opus_transform *transform_b)
+{
+	result->is_overlap = 1; /* has an axis, then it is overlapping */
+
+	/* meet detector result requirements */
+	result->normal     = opus_vec2_dot(opus_vec2_to(center_a, center_b), min_axis) < 0 ? opus_vec2_inv(min_axis) : min_axis;
+	result->separation = min_overlap;
+
+	/* set basic information */
+	result->transform_a = *transform_a;
+	result->transform_b = *transform_b;
+	result->A           = (opus_shape *) A;
+	result->B           = (opus_shape *) B;
+}
+
+static opus_overlap_result SAT_polygon_circle_(opus_polygon   *A,
+                                               opus_circle    *B,
+                                               opus_transform *transform_a, opus_transform *transform_b)
 {
 	opus_overlap_result result = {0};
 
@@ -167,8 +202,8 @@ static opus_overlap_result SAT_polygon_circle_(opus_polygon *A,
 	/* when using SAT, we must first translate the local vertices to world vertices */
 	verts_a = SAT_get_transformed_vertices_(A, transform_a);
 	if (!verts_a) return result; /* no enough memory, can not proceed this algorithm */
-	center_a = opus_mat2d_pre_mul_vec(transform_a, opus_vec2_(0, 0));
-	center_b = opus_mat2d_pre_mul_vec(transform_b, opus_vec2_(0, 0));
+	center_a = transform_a->p;
+	center_b = transform_b->p;
 
 	/* check overlapping axes */
 	min_overlap = OPUS_REAL_MAX;
@@ -199,27 +234,21 @@ static opus_overlap_result SAT_polygon_circle_(opus_polygon *A,
 			min_axis    = axis;
 
 			/* no overlap for sure, exit */
-			if (overlap <= 0) return result;
+			if (overlap <= 0) {
+				free(verts_a);
+				return result;
+			}
 		}
 	}
-	result.is_overlap = 1; /* has an axis, then it is overlapping */
-
-	/* meet detector result requirements */
-	result.normal     = opus_vec2_dot(opus_vec2_to(center_a, center_b), min_axis) < 0 ? opus_vec2_inv(min_axis) : min_axis;
-	result.separation = min_overlap;
-
-	/* set basic information */
-	opus_mat2d_copy(result.transform_a, transform_a);
-	opus_mat2d_copy(result.transform_b, transform_b);
-	result.A = (opus_shape *) A;
-	result.B = (opus_shape *) B;
+	free(verts_a);
+	SAT_set_polygon_circle_result_(&result, min_overlap, min_axis, center_a, center_b, A, B, transform_a, transform_b);
 
 	return result;
 }
 
 
-opus_overlap_result opus_SAT(opus_shape *A, opus_shape *B, opus_mat2d transform_a,
-                             opus_mat2d transform_b)
+opus_overlap_result opus_SAT(opus_shape *A, opus_shape *B, opus_transform *transform_a,
+                             opus_transform *transform_b)
 {
 	opus_overlap_result r0 = {0}; /* just for invalid return */
 	if (A->type_ == OPUS_SHAPE_POLYGON && B->type_ == A->type_)
@@ -228,5 +257,271 @@ opus_overlap_result opus_SAT(opus_shape *A, opus_shape *B, opus_mat2d transform_
 		return SAT_polygon_circle_((void *) A, (void *) B, transform_a, transform_b);
 	if (A->type_ == OPUS_SHAPE_CIRCLE && B->type_ == OPUS_SHAPE_POLYGON)
 		return SAT_polygon_circle_((void *) B, (void *) A, transform_b, transform_a);
+	if (A->type_ == OPUS_SHAPE_CIRCLE && B->type_ == A->type_)
+		return opus_collide_circle_circle((void *) A, (void *) B, transform_a, transform_b);
 	return r0;
 }
+
+void opus_sat_cache_init(opus_sat_cache *cache)
+{
+	opus_arr_create(cache->x, sizeof(opus_real));
+	opus_arr_create(cache->y, sizeof(opus_real));
+	opus_arr_create(cache->nx, sizeof(opus_real));
+	opus_arr_create(cache->ny, sizeof(opus_real));
+}
+
+void opus_sat_cache_done(opus_sat_cache *cache)
+{
+	opus_arr_destroy(cache->ny);
+	opus_arr_destroy(cache->nx);
+	opus_arr_destroy(cache->y);
+	opus_arr_destroy(cache->x);
+}
+
+static OPUS_INLINE size_t SAT_padded_(size_t n)
+{
+	return (n + SAT_PAD - 1) / SAT_PAD * SAT_PAD;
+}
+
+/**
+ * @brief transform the vertices and compute the edge normals of all the polygon bodies, the
+ * 		same way as "opus_SAT" does for every pair. Arrays only grow, so once the cache
+ * 		is warm the narrow phase does not allocate.
+ * @param cache
+ * @param bodies
+ * @param n
+ */
+void opus_sat_cache_update(opus_sat_cache *cache, opus_body **bodies, size_t n)
+{
+	size_t        i, j, k, total, offset;
+	opus_body    *body;
+	opus_polygon *polygon;
+	opus_vec2     p;
+	opus_real    *x, *y;
+	opus_vec2     axis;
+
+	for (i = 0, total = 0; i < n; i++)
+		if (bodies[i]->shape->type_ == OPUS_SHAPE_POLYGON)
+			total += SAT_padded_(((opus_polygon *) bodies[i]->shape)->n);
+
+	opus_arr_resize(cache->x, total);
+	opus_arr_resize(cache->y, total);
+	opus_arr_resize(cache->nx, total);
+	opus_arr_resize(cache->ny, total);
+
+	for (i = 0, offset = 0; i < n; i++) {
+		body = bodies[i];
+		if (body->shape->type_ != OPUS_SHAPE_POLYGON) {
+			body->sat_offset_ = -1;
+			continue;
+		}
+
+		polygon           = (opus_polygon *) body->shape;
+		body->sat_offset_ = (int) offset;
+		x                 = cache->x + offset;
+		y                 = cache->y + offset;
+
+		for (j = 0; j < polygon->n; j++) {
+			p    = opus_transform_apply(&body->transform, polygon->vertices[j]);
+			x[j] = p.x;
+			y[j] = p.y;
+		}
+		/* repeating the last vertex does not change the range of the projection */
+		for (; j < SAT_padded_(polygon->n); j++) {
+			x[j] = x[polygon->n - 1];
+			y[j] = y[polygon->n - 1];
+		}
+
+		for (j = 0; j < polygon->n; j++) {
+			k    = (j + 1) % polygon->n;
+			axis = opus_vec2_norm(opus_vec2_perp(opus_vec2_(x[j] - x[k], y[j] - y[k])));
+
+			cache->nx[offset + j] = axis.x;
+			cache->ny[offset + j] = axis.y;
+		}
+
+		offset += SAT_padded_(polygon->n);
+	}
+}
+
+/* project "n" vertices ("n" is a multiple of SAT_PAD) on the axis */
+static void SAT_project_(const opus_real *x, const opus_real *y, size_t n, opus_real ax, opus_real ay,
+                         opus_real *min, opus_real *max)
+{
+	size_t i;
+#if defined(OPUS_CONFIG_USE_FLOAT) && (defined(__AVX__) || defined(SAT_SSE2_))
+	/* 4 floats a vector, the same as the padding */
+	__m128 vx, vy, d, lo, hi;
+	float  l[4], h[4];
+
+	vx = _mm_set1_ps(ax);
+	vy = _mm_set1_ps(ay);
+	lo = _mm_set1_ps(OPUS_REAL_MAX);
+	hi = _mm_set1_ps(-OPUS_REAL_MAX);
+	for (i = 0; i < n; i += 4) {
+		d  = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i), vx), _mm_mul_ps(_mm_loadu_ps(y + i), vy));
+		lo = _mm_min_ps(lo, d);
+		hi = _mm_max_ps(hi, d);
+	}
+	_mm_storeu_ps(l, lo);
+	_mm_storeu_ps(h, hi);
+	*min = opus_min(opus_min(l[0], l[1]), opus_min(l[2], l[3]));
+	*max = opus_max(opus_max(h[0], h[1]), opus_max(h[2], h[3]));
+#elif defined(__AVX__)
+	__m256d vx, vy, d, lo, hi;
+	double  l[4], h[4];
+
+	vx = _mm256_set1_pd(ax);
+	vy = _mm256_set1_pd(ay);
+	lo = _mm256_set1_pd(OPUS_REAL_MAX);
+	hi = _mm256_set1_pd(-OPUS_REAL_MAX);
+	for (i = 0; i < n; i += 4) {
+		d  = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(x + i), vx), _mm256_mul_pd(_mm256_loadu_pd(y + i), vy));
+		lo = _mm256_min_pd(lo, d);
+		hi = _mm256_max_pd(hi, d);
+	}
+	_mm256_storeu_pd(l, lo);
+	_mm256_storeu_pd(h, hi);
+	*min = opus_min(opus_min(l[0], l[1]), opus_min(l[2], l[3]));
+	*max = opus_max(opus_max(h[0], h[1]), opus_max(h[2], h[3]));
+#elif defined(SAT_SSE2_)
+	__m128d vx, vy, d, lo, hi;
+	double  l[2], h[2];
+
+	vx = _mm_set1_pd(ax);
+	vy = _mm_set1_pd(ay);
+	lo = _mm_set1_pd(OPUS_REAL_MAX);
+	hi = _mm_set1_pd(-OPUS_REAL_MAX);
+	for (i = 0; i < n; i += 2) {
+		d  = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(x + i), vx), _mm_mul_pd(_mm_loadu_pd(y + i), vy));
+		lo = _mm_min_pd(lo, d);
+		hi = _mm_max_pd(hi, d);
+	}
+	_mm_storeu_pd(l, lo);
+	_mm_storeu_pd(h, hi);
+	*min = opus_min(l[0], l[1]);
+	*max = opus_max(h[0], h[1]);
+#else
+	opus_real dot;
+
+	*min = OPUS_REAL_MAX;
+	*max = -OPUS_REAL_MAX;
+	for (i = 0; i < n; i++) {
+		dot = x[i] * ax + y[i] * ay;
+		if (dot > *max) *max = dot;
+		if (dot < *min) *min = dot;
+	}
+#endif
+}
+
+/* the same as "SAT_overlap_axes_" with the axes of the cached polygon at "b" */
+static int SAT_overlap_axes_cached_(struct overlap_ *result, opus_sat_cache *cache, size_t a, size_t na, size_t b, size_t nb)
+{
+	size_t    i;
+	opus_real overlap, min_a, max_a, min_b, max_b;
+
+	result->overlap = OPUS_REAL_MAX;
+
+	for (i = 0; i < nb; i++) {
+		SAT_project_(cache->x + a, cache->y + a, SAT_padded_(na), cache->nx[b + i], cache->ny[b + i], &min_a, &max_a);
+		SAT_project_(cache->x + b, cache->y + b, SAT_padded_(nb), cache->nx[b + i], cache->ny[b + i], &min_b, &max_b);
+
+		overlap = opus_min(max_a - min_b, max_b - min_a);
+		if (overlap < result->overlap) {
+			result->overlap = overlap;
+			result->axis    = opus_vec2_(cache->nx[b + i], cache->ny[b + i]);
+
+			/* no overlap for sure, exit */
+			if (overlap <= 0) return 0;
+		}
+	}
+
+	return 1; /* overlap */
+}
+
+static opus_overlap_result SAT_polygon_polygon_cached_(opus_sat_cache *cache, opus_body *A, opus_body *B,
+                                                       opus_transform *transform_a, opus_transform *transform_b)
+{
+	opus_overlap_result result = {0};
+	struct overlap_     ra, rb;
+	opus_polygon       *pa, *pb;
+
+	pa = (opus_polygon *) A->shape;
+	pb = (opus_polygon *) B->shape;
+
+	SAT_overlap_axes_cached_(&rb, cache, A->sat_offset_, pa->n, B->sat_offset_, pb->n);
+	if (rb.overlap <= 0) return result;
+	SAT_overlap_axes_cached_(&ra, cache, B->sat_offset_, pb->n, A->sat_offset_, pa->n);
+	if (ra.overlap <= 0) return result;
+
+	SAT_set_polygon_polygon_result_(&result, &ra, &rb, pa, pb, transform_a, transform_b);
+
+	return result;
+}
+
+static opus_overlap_result SAT_polygon_circle_cached_(opus_sat_cache *cache, opus_body *A, opus_body *B,
+                                                      opus_transform *transform_a, opus_transform *transform_b)
+{
+	opus_overlap_result result = {0};
+	opus_polygon       *polygon;
+	opus_circle        *circle;
+
+	size_t    i, a;
+	opus_vec2 center_a, center_b, axis, min_axis, p;
+	opus_real overlap, min_overlap, min_a, max_a, min_b, max_b;
+
+	polygon  = (opus_polygon *) A->shape;
+	circle   = (opus_circle *) B->shape;
+	a        = A->sat_offset_;
+	center_a = transform_a->p;
+	center_b = transform_b->p;
+
+	min_overlap = OPUS_REAL_MAX;
+	for (i = 0; i < polygon->n; i++) {
+		axis = opus_vec2_(cache->nx[a + i], cache->ny[a + i]);
+
+		SAT_project_(cache->x + a, cache->y + a, SAT_padded_(polygon->n), axis.x, axis.y, &min_a, &max_a);
+
+		/* project circle B on the axis */
+		p     = opus_vec2_scale(axis, circle->radius);
+		max_b = opus_vec2_dot(opus_vec2_add(center_b, p), axis);
+		min_b = opus_vec2_dot(opus_vec2_sub(center_b, p), axis);
+		if (min_b > max_b) opus_swap(&min_b, &max_b);
+
+		overlap = opus_min(max_a - min_b, max_b - min_a);
+		if (overlap < min_overlap) {
+			min_overlap = overlap;
+			min_axis    = axis;
+
+			/* no overlap for sure, exit */
+			if (overlap <= 0) return result;
+		}
+	}
+	SAT_set_polygon_circle_result_(&result, min_overlap, min_axis, center_a, center_b, polygon, circle, transform_a, transform_b);
+
+	return result;
+}
+
+/**
+ * @brief "opus_SAT" on the world vertices cached by "opus_sat_cache_update", the results are
+ * 		the same. Falls back to "opus_SAT" if a polygon is not in the cache.
+ * @param cache
+ * @param A
+ * @param B
+ * @param transform_a
+ * @param transform_b
+ * @return
+ */
+opus_overlap_result opus_SAT_cached(opus_sat_cache *cache, opus_body *A, opus_body *B,
+                                    opus_transform *transform_a, opus_transform *transform_b)
+{
+	int ta = A->shape->type_, tb = B->shape->type_;
+
+	if (ta == OPUS_SHAPE_POLYGON && tb == OPUS_SHAPE_POLYGON && A->sat_offset_ >= 0 && B->sat_offset_ >= 0)
+		return SAT_polygon_polygon_cached_(cache, A, B, transform_a, transform_b);
+	if (ta == OPUS_SHAPE_POLYGON && tb == OPUS_SHAPE_CIRCLE && A->sat_offset_ >= 0)
+		return SAT_polygon_circle_cached_(cache, A, B, transform_a, transform_b);
+	if (ta == OPUS_SHAPE_CIRCLE && tb == OPUS_SHAPE_POLYGON && B->sat_offset_ >= 0)
+		return SAT_polygon_circle_cached_(cache, B, A, transform_b, transform_a);
+	return opus_SAT(A->shape, B->shape, transform_a, transform_b);
+}
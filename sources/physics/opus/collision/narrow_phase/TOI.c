@@ -0,0 +1,143 @@
+/**
+ * @file TOI.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/3/28
+ *
+ * @example
+ *
+ * opus_sweep sa, sb; // start and end pose of the bodies over the step
+ * if (opus_TOI(A, &sa, B, &sb, target, &t, &normal, &point)) ...
+ *
+ * @brief time of impact by conservative advancement: the GJK distance at time t divided by
+ * 		a bound of the approaching speed is a step that can never pass through the other
+ * 		shape, so the shapes are advanced until they are "target" apart. Shapes already
+ * 		overlapping at the start are left to the discrete narrow phase.
+ *
+ * @development_log
+ *
+ */
+
+#include "physics/opus/physics.h"
+#include "physics/opus/physics_private.h"
+
+#define TOI_MAX_ITERATIONS (32)
+
+/**
+ * @brief the pose at "t" in [0, 1] of the sweep
+ * @param sweep
+ * @param t
+ * @param transform
+ */
+void opus_sweep_transform(opus_sweep *sweep, opus_real t, opus_transform *transform)
+{
+	opus_vec2 p;
+	opus_real r;
+
+	p.x = sweep->p0.x + (sweep->p1.x - sweep->p0.x) * t;
+	p.y = sweep->p0.y + (sweep->p1.y - sweep->p0.y) * t;
+	r   = sweep->r0 + (sweep->r1 - sweep->r0) * t;
+	opus_transform_set(transform, r, p);
+}
+
+/**
+ * @brief distance from the origin of the shape to its farthest point
+ * @param shape
+ * @return
+ */
+opus_real opus_sweep_radius(opus_shape *shape)
+{
+	opus_polygon *polygon;
+	opus_real     r;
+	size_t        i;
+
+	if (shape->type_ == OPUS_SHAPE_CIRCLE) return ((opus_circle *) shape)->radius;
+
+	polygon = (void *) shape;
+	for (i = 0, r = 0; i < polygon->n; i++) r = opus_max(r, opus_vec2_len(polygon->vertices[i]));
+	return r;
+}
+
+/**
+ * @brief radius of the biggest circle around the origin inside the shape, a shape moving less
+ * 		than this keeps overlapping where it was, so it can not pass through anything
+ * @param shape
+ * @return
+ */
+opus_real opus_sweep_core(opus_shape *shape)
+{
+	opus_polygon *polygon;
+	opus_vec2     a, b, e;
+	opus_real     r, len;
+	size_t        i;
+
+	if (shape->type_ == OPUS_SHAPE_CIRCLE) return ((opus_circle *) shape)->radius;
+
+	polygon = (void *) shape;
+	for (i = 0, r = OPUS_REAL_MAX; i < polygon->n; i++) {
+		a   = polygon->vertices[i];
+		b   = polygon->vertices[(i + 1) % polygon->n];
+		e   = opus_vec2_sub(b, a);
+		len = opus_vec2_len(e);
+		if (len > 0) r = opus_min(r, opus_abs(opus_vec2_cross(e, a)) / len);
+	}
+	return r == OPUS_REAL_MAX ? 0 : r;
+}
+
+/**
+ * @brief first time the two sweeps come within "target" of each other
+ * @param A
+ * @param sa
+ * @param B
+ * @param sb
+ * @param target distance to stop at, the shapes never touch
+ * @param t time of impact in [0, 1]
+ * @param normal points to B from A
+ * @param point middle of the closest points
+ * @return 1 if the shapes come that close in the step while approaching
+ */
+int opus_TOI(opus_shape *A, opus_sweep *sa, opus_shape *B, opus_sweep *sb, opus_real target,
+             opus_real *t, opus_vec2 *normal, opus_vec2 *point)
+{
+	opus_gjk_simplex simplex;
+	opus_transform   ta, tb;
+	opus_vec2        da, db, pa, pb, n;
+	opus_real        d, bound, tolerance, time;
+	int              i;
+
+	da        = opus_vec2_sub(sa->p1, sa->p0);
+	db        = opus_vec2_sub(sb->p1, sb->p0);
+	tolerance = target * 0.25;
+	time      = 0;
+
+	simplex.n = 0;
+	for (i = 0; i < TOI_MAX_ITERATIONS; i++) {
+		opus_sweep_transform(sa, time, &ta);
+		opus_sweep_transform(sb, time, &tb);
+		d = opus_GJK_distance(A, B, &ta, &tb, &simplex, &pa, &pb);
+		if (d <= 0) return 0; /* overlapping, no direction to advance along */
+
+		n = opus_vec2_scale(opus_vec2_sub(pb, pa), 1 / d);
+
+		/* touching already, only a hit if still moving into each other */
+		if (d < target + tolerance) {
+			if (time == 0 && opus_vec2_dot(opus_vec2_sub(da, db), n) <= 0) return 0;
+			*t      = time;
+			*normal = n;
+			*point  = opus_vec2_scale(opus_vec2_add(pa, pb), 0.5);
+			return 1;
+		}
+
+		/* the closest points can not approach faster than this along the normal */
+		bound = opus_vec2_dot(opus_vec2_sub(da, db), n) +
+		        opus_abs(sa->r1 - sa->r0) * sa->radius + opus_abs(sb->r1 - sb->r0) * sb->radius;
+		if (bound <= 0) return 0;
+
+		time += (d - target) / bound;
+		if (time >= 1) return 0;
+	}
+
+	return 0;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file debug_draw.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/4/2
+ *
+ * @example
+ *
+ * world->debug_draw = OPUS_DEBUG_DRAW_CONTACTS | OPUS_DEBUG_DRAW_JOINTS;
+ * opus_physics_world_step(world, dt);
+ * for (i = 0; i < opus_arr_len(world->debug_cmds); i++) ... world->debug_cmds[i]
+ *
+ * @brief the debug drawing of the world as a list of lines, circles and rects, recorded at
+ * 		the end of the step when "world->debug_draw" is set and drawn by the renderer
+ * 		afterwards. The physics does not know what it is drawn on, so it links without
+ * 		any graphics library.
+ *
+ * @development_log
+ *
+ */
+
+#include "physics/opus/physics.h"
+#include "physics/opus/physics_private.h"
+#include "data_structure/array.h"
+
+#define DEBUG_COLOR_CONTACT (0xff0000ff)
+#define DEBUG_COLOR_JOINT (0xc6e2ffff)
+#define DEBUG_COLOR_BVH (0x4d66804d)
+#define DEBUG_NORMAL_LENGTH (8)
+
+static void push_(opus_debug_cmd **cmds, int type, opus_vec2 a, opus_vec2 b, opus_real size, uint32_t color)
+{
+	opus_debug_cmd cmd;
+
+	cmd.type  = type;
+	cmd.color = color;
+	cmd.a     = a;
+	cmd.b     = b;
+	cmd.size  = size;
+	opus_arr_push(*cmds, &cmd);
+}
+
+void opus_debug_draw_line(opus_debug_cmd **cmds, opus_vec2 a, opus_vec2 b, opus_real width, uint32_t color)
+{
+	push_(cmds, OPUS_DEBUG_LINE, a, b, width, color);
+}
+
+void opus_debug_draw_circle(opus_debug_cmd **cmds, opus_vec2 center, opus_real radius, uint32_t color)
+{
+	push_(cmds, OPUS_DEBUG_CIRCLE, center, center, radius, color);
+}
+
+void opus_debug_draw_rect(opus_debug_cmd **cmds, opus_vec2 min, opus_vec2 max, opus_real width, uint32_t color)
+{
+	push_(cmds, OPUS_DEBUG_RECT, min, max, width, color);
+}
+
+/* the points of the pairs the solver went through, they are still there after the step */
+static void draw_contacts_(opus_physics_world *world)
+{
+	size_t i;
+	int    j;
+
+	opus_contacts *contacts;
+	opus_contact  *contact;
+
+	for (i = 0; i < opus_arr_len(world->awake_contacts_); i++) {
+		contacts = world->awake_contacts_[i];
+		for (j = 0; j < contacts->n_contacts; j++) {
+			contact = &contacts->contacts[j];
+			opus_debug_draw_circle(&world->debug_cmds, contact->pa, 1, DEBUG_COLOR_CONTACT);
+			opus_debug_draw_line(&world->debug_cmds, contact->pa,
+			                     opus_vec2_add(contact->pa, opus_vec2_scale(contact->normal, DEBUG_NORMAL_LENGTH)),
+			                     0.3, DEBUG_COLOR_CONTACT);
+		}
+	}
+}
+
+static void draw_joints_(opus_physics_world *world)
+{
+	size_t i;
+
+	opus_joint_distance *distance;
+	opus_joint_revolute *revolute;
+
+	for (i = 0; i < opus_arr_len(world->joints); i++) {
+		switch (world->joints[i]->type) {
+			case OPUS_JOINT_DISTANCE:
+				distance = (void *) world->joints[i];
+				opus_debug_draw_line(&world->debug_cmds, distance->anchor,
+				                     opus_body_l2w(distance->body, distance->offset), 1, DEBUG_COLOR_JOINT);
+				opus_debug_draw_circle(&world->debug_cmds, distance->anchor, 3, DEBUG_COLOR_JOINT);
+				break;
+			case OPUS_JOINT_REVOLUTE:
+				revolute = (void *) world->joints[i];
+				opus_debug_draw_line(&world->debug_cmds, revolute->A->position,
+				                     opus_body_l2w(revolute->A, revolute->local_a), 1.4, DEBUG_COLOR_JOINT);
+				opus_debug_draw_line(&world->debug_cmds, revolute->B->position,
+				                     opus_body_l2w(revolute->B, revolute->local_b), 1.4, DEBUG_COLOR_JOINT);
+				break;
+		}
+	}
+}
+
+/**
+ * @brief record the debug drawing of the world as it is now in "world->debug_cmds", the
+ * 		step calls it at its end, call it after moving bodies by hand to see them
+ * @param world
+ */
+void opus_physics_world_debug_draw(opus_physics_world *world)
+{
+	opus_arr_clear(world->debug_cmds);
+
+	if (world->debug_draw & OPUS_DEBUG_DRAW_BVH && world->bvh && world->broad_phase_ == OPUS_BROAD_PHASE_BVH)
+		opus_bvh_debug_draw(world->bvh, &world->debug_cmds, DEBUG_COLOR_BVH);
+	if (world->debug_draw & OPUS_DEBUG_DRAW_CONTACTS) draw_contacts_(world);
+	if (world->debug_draw & OPUS_DEBUG_DRAW_JOINTS) draw_joints_(world);
+}
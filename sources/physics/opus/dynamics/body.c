@@ -22,14 +22,16 @@
 opus_body *opus_body_init(opus_body *body)
 {
 	if (body) {
-		body->type        = OPUS_BODY_DYNAMIC;
-		body->id          = opus_get_physics_id();
-		body->bitmask     = 0x0001;
-		body->density     = 0.002;
-		body->inv_mass    = OPUS_REAL_MAX;
-		body->inertia     = OPUS_REAL_MAX;
-		body->friction    = 0.01;
-		body->restitution = 0.01;
+		body->type         = OPUS_BODY_DYNAMIC;
+		body->id           = opus_get_physics_id();
+		body->bitmask      = 0x0001;
+		body->density      = 0.002;
+		body->inv_mass     = OPUS_REAL_MAX;
+		body->inertia      = OPUS_REAL_MAX;
+		body->friction     = 0.01;
+		body->restitution  = 0.01;
+		body->proxy_id     = -1;
+		body->query_proxy_ = -1;
 		opus_arr_create(body->parts, sizeof(opus_body *));
 		opus_arr_push(body->parts, &body);
 	}
@@ -68,8 +70,42 @@ void opus_body_apply_force(opus_body *body, opus_vec2 force, opus_vec2 r)
 
 void opus_body_set_position(opus_body *body, opus_vec2 position)
 {
-	body->position    = position;
-	body->is_sleeping = 0;
+	body->position      = position;
+	body->prev_position = position; /* a teleport, nothing to interpolate */
+	opus_sleeping_wake_up(body);
+}
+
+/**
+ * @brief cache the cosine and sine of the rotation with the position, done once per step
+ * 		before the collision detection, which reads "body->transform" for every pair
+ * @param body
+ */
+void opus_body_update_transform(opus_body *body)
+{
+	opus_transform_set(&body->transform, body->rotation, body->position);
+}
+
+/**
+ * @brief pose between the last two fixed steps, so that the rendering is smooth when the
+ * 		frame rate is not a multiple of the step rate, see "opus_physics_world_advance"
+ * @param body
+ * @param alpha "world->alpha", 0 for the previous pose and 1 for the current one
+ * @param transform in opus_real, see "opus_transform_to_mat2d" for the renderer
+ */
+void opus_body_get_interpolated_transform(opus_body *body, opus_real alpha, opus_transform *transform)
+{
+	opus_vec2 p;
+	opus_real r;
+
+	/* turn the short way round */
+	r = body->rotation - body->prev_rotation;
+	if (r > OPUS_PI) r -= 2 * OPUS_PI;
+	else if (r < -OPUS_PI) r += 2 * OPUS_PI;
+
+	p.x = body->prev_position.x + (body->position.x - body->prev_position.x) * alpha;
+	p.y = body->prev_position.y + (body->position.y - body->prev_position.y) * alpha;
+	r   = body->prev_rotation + r * alpha;
+	opus_transform_set(transform, r, p);
 }
 
 void opus_body_clear_force(opus_body *body)
@@ -141,10 +177,9 @@ void opus_body_set_inertia(opus_body *body, opus_real inertia)
  */
 opus_vec2 opus_body_w2l(opus_body *body, opus_vec2 point)
 {
-	opus_mat2d t, inv;
-	opus_mat2d_rotate_about(t, (float) body->rotation, body->position);
-	opus_mat2d_inv(inv, t);
-	return opus_mat2d_pre_mul_vec(inv, point);
+	opus_transform t;
+	opus_transform_set(&t, body->rotation, body->position);
+	return opus_transform_apply_inv(&t, point);
 }
 
 /**
@@ -155,9 +190,9 @@ opus_vec2 opus_body_w2l(opus_body *body, opus_vec2 point)
  */
 opus_vec2 opus_body_l2w(opus_body *body, opus_vec2 point)
 {
-	opus_mat2d t;
-	opus_mat2d_rotate_about(t, (float) body->rotation, body->position);
-	return opus_mat2d_pre_mul_vec(t, point);
+	opus_transform t;
+	opus_transform_set(&t, body->rotation, body->position);
+	return opus_transform_apply(&t, point);
 }
 
 void opus_body_set_density(opus_body *body, opus_real density)
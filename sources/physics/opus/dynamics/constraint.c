@@ -28,6 +28,21 @@ void opus_constraint_destroy(opus_constraint *constraint)
 	}
 }
 
+/**
+ * @brief bodies connected by the constraint, NULL for the ones not set
+ * @param constraint
+ * @param A
+ * @param B
+ */
+void opus_constraint_get_bodies(opus_constraint *constraint, opus_body **A, opus_body **B)
+{
+	*A = *B = NULL;
+	if (constraint->type == OPUS_CONSTRAINT_DISTANCE) {
+		*A = ((opus_constraint_distance *) constraint)->A;
+		*B = ((opus_constraint_distance *) constraint)->B;
+	}
+}
+
 opus_constraint_distance *opus_constraint_distance_create(opus_body *A, opus_body *B, opus_vec2 offset_a, opus_vec2 offset_b)
 {
 	opus_constraint_distance *constraint;
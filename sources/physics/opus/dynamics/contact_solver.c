@@ -0,0 +1,925 @@
+/**
+ * @file contact_solver.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/4/4
+ *
+ * @brief the contact points of the step packed in one array, next to a copy of the state of
+ * 		the bodies they push, so that the solver passes go through two flat arrays instead
+ * 		of the manifolds, their points and the bodies behind them. Everything is gathered
+ * 		once per step, the impulses go back to the manifolds once at the end of it, and the
+ * 		bodies are copied back whenever the joints (which work on "opus_body") need them.
+ * 		The arithmetic is the same as the passes over the manifolds in world.c, so the
+ * 		results are identical. The colour batches of the parallel solver do not use it.
+ *
+ * 		With "world->use_simd_solver" the points are coloured so that no moving body is in
+ * 		two points of a colour, and each colour is cut in groups of OPUS_SOLVER_LANES. A
+ * 		group is solved as a whole with SSE2 or AVX: 4 floats, or 4 doubles with AVX and
+ * 		2 with SSE2, in a vector. Without either, every line of the solver is a loop over
+ * 		the lanes, which gives the same results. The order of the points changes, so the
+ * 		results are not those of the solver without lanes.
+ *
+ */
+
+#include <string.h>
+#include "data_structure/array.h"
+#include "physics/opus/physics.h"
+#include "physics/opus/physics_private.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOLVER_SSE2_
+#include <emmintrin.h>
+#endif
+
+/* the lanes of a group in vectors, LANE_WIDTH_ of them at a time, see "solve_lanes_" */
+#if defined(OPUS_CONFIG_USE_FLOAT) && (defined(__AVX__) || defined(SOLVER_SSE2_))
+typedef __m128 lane_v_;
+#define LANE_WIDTH_ (4)
+#define LANE_SET1_(x) _mm_set1_ps(x)
+#define LANE_GATHER_(bodies, field) _mm_setr_ps((bodies)[0]->field, (bodies)[1]->field, (bodies)[2]->field, (bodies)[3]->field)
+#define LANE_LOAD_(p) _mm_loadu_ps(p)
+#define LANE_STORE_(p, v) _mm_storeu_ps(p, v)
+#define LANE_ADD_(a, b) _mm_add_ps(a, b)
+#define LANE_SUB_(a, b) _mm_sub_ps(a, b)
+#define LANE_MUL_(a, b) _mm_mul_ps(a, b)
+#define LANE_DIV_(a, b) _mm_div_ps(a, b)
+#define LANE_MAX_(a, b) _mm_max_ps(a, b) /* "a > b ? a : b" */
+#define LANE_MIN_(a, b) _mm_min_ps(a, b) /* "a < b ? a : b" */
+#define LANE_GT_(a, b) _mm_cmpgt_ps(a, b)
+#define LANE_AND_(a, b) _mm_and_ps(a, b)
+#define LANE_XOR_(a, b) _mm_xor_ps(a, b)
+#define LANE_SELECT_(mask, a, b) _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b))
+#elif defined(__AVX__)
+typedef __m256d lane_v_;
+#define LANE_WIDTH_ (4)
+#define LANE_SET1_(x) _mm256_set1_pd(x)
+#define LANE_GATHER_(bodies, field) _mm256_setr_pd((bodies)[0]->field, (bodies)[1]->field, (bodies)[2]->field, (bodies)[3]->field)
+#define LANE_LOAD_(p) _mm256_loadu_pd(p)
+#define LANE_STORE_(p, v) _mm256_storeu_pd(p, v)
+#define LANE_ADD_(a, b) _mm256_add_pd(a, b)
+#define LANE_SUB_(a, b) _mm256_sub_pd(a, b)
+#define LANE_MUL_(a, b) _mm256_mul_pd(a, b)
+#define LANE_DIV_(a, b) _mm256_div_pd(a, b)
+#define LANE_MAX_(a, b) _mm256_max_pd(a, b)
+#define LANE_MIN_(a, b) _mm256_min_pd(a, b)
+#define LANE_GT_(a, b) _mm256_cmp_pd(a, b, _CMP_GT_OQ)
+#define LANE_AND_(a, b) _mm256_and_pd(a, b)
+#define LANE_XOR_(a, b) _mm256_xor_pd(a, b)
+#define LANE_SELECT_(mask, a, b) _mm256_blendv_pd(b, a, mask)
+#elif defined(SOLVER_SSE2_)
+/* 2 doubles a vector, a group is done in two halves */
+typedef __m128d lane_v_;
+#define LANE_WIDTH_ (2)
+#define LANE_SET1_(x) _mm_set1_pd(x)
+#define LANE_GATHER_(bodies, field) _mm_setr_pd((bodies)[0]->field, (bodies)[1]->field)
+#define LANE_LOAD_(p) _mm_loadu_pd(p)
+#define LANE_STORE_(p, v) _mm_storeu_pd(p, v)
+#define LANE_ADD_(a, b) _mm_add_pd(a, b)
+#define LANE_SUB_(a, b) _mm_sub_pd(a, b)
+#define LANE_MUL_(a, b) _mm_mul_pd(a, b)
+#define LANE_DIV_(a, b) _mm_div_pd(a, b)
+#define LANE_MAX_(a, b) _mm_max_pd(a, b)
+#define LANE_MIN_(a, b) _mm_min_pd(a, b)
+#define LANE_GT_(a, b) _mm_cmpgt_pd(a, b)
+#define LANE_AND_(a, b) _mm_and_pd(a, b)
+#define LANE_XOR_(a, b) _mm_xor_pd(a, b)
+#define LANE_SELECT_(mask, a, b) _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b))
+#endif
+
+static opus_vec2 cross_vr(opus_vec2 v, opus_real r)
+{
+	return opus_vec2_(r * v.y, -r * v.x);
+}
+
+static opus_vec2 cross_rv(opus_real r, opus_vec2 v)
+{
+	return opus_vec2_(-r * v.y, r * v.x);
+}
+
+/* "opus_body_apply_impulse", a static body has no inverse mass here */
+static void apply_impulse_(opus_solver_body *body, opus_vec2 impulse, opus_vec2 r)
+{
+	body->velocity.x += impulse.x * body->inv_mass;
+	body->velocity.y += impulse.y * body->inv_mass;
+	body->angular_velocity += body->inv_inertia * opus_vec2_cross(r, impulse);
+}
+
+opus_contact_solver *opus_contact_solver_create(void)
+{
+	opus_contact_solver *solver = OPUS_CALLOC(1, sizeof(opus_contact_solver));
+	if (solver) {
+		opus_arr_create(solver->bodies, sizeof(opus_solver_body));
+		opus_arr_create(solver->constraints, sizeof(opus_contact_constraint));
+		opus_arr_create(solver->lanes, sizeof(opus_contact_lanes));
+		opus_arr_create(solver->colors_, sizeof(uint64_t));
+		opus_arr_create(solver->color_of_, sizeof(int));
+		opus_arr_create(solver->scratch_, sizeof(opus_contact_constraint));
+	}
+	return solver;
+}
+
+void opus_contact_solver_destroy(opus_contact_solver *solver)
+{
+	opus_arr_destroy(solver->bodies);
+	opus_arr_destroy(solver->constraints);
+	opus_arr_destroy(solver->lanes);
+	opus_arr_destroy(solver->colors_);
+	opus_arr_destroy(solver->color_of_);
+	opus_arr_destroy(solver->scratch_);
+	OPUS_FREE(solver);
+}
+
+/* a body which is never changed by an impulse can be in any number of lanes */
+static int is_fixed_(opus_solver_body *body)
+{
+	return body->inv_mass == 0 && body->inv_inertia == 0;
+}
+
+/**
+ * @brief pick the first colour neither body has used, like "color_bodies_" of world.c
+ * @return OPUS_SOLVER_MAX_COLORS if all the colours are used
+ */
+static int color_constraint_(opus_contact_solver *solver, opus_contact_constraint *cc)
+{
+	uint64_t used = 0;
+	int      c, a, b;
+
+	a = !is_fixed_(&solver->bodies[cc->a]);
+	b = !is_fixed_(&solver->bodies[cc->b]);
+	if (a) used |= solver->colors_[cc->a];
+	if (b) used |= solver->colors_[cc->b];
+
+	for (c = 0; c < OPUS_SOLVER_MAX_COLORS; c++)
+		if (!(used & (uint64_t) 1 << c)) break;
+
+	if (c < OPUS_SOLVER_MAX_COLORS) {
+		if (a) solver->colors_[cc->a] |= (uint64_t) 1 << c;
+		if (b) solver->colors_[cc->b] |= (uint64_t) 1 << c;
+	}
+	return c;
+}
+
+/* the last lanes of a colour point at the empty body */
+static void fill_lane_(opus_contact_solver *solver, opus_contact_lanes *lanes, int l, int index)
+{
+	opus_contact_constraint *cc;
+
+	opus_contact_constraint empty;
+
+	if (index < 0) {
+		/* no mass and no impulse, the lane changes nothing */
+		memset(&empty, 0, sizeof(empty));
+		empty.a = empty.b = (int) solver->n_bodies;
+		cc                = &empty;
+	} else {
+		cc = &solver->constraints[index];
+	}
+
+	lanes->a[l]               = cc->a;
+	lanes->b[l]               = cc->b;
+	lanes->constraint[l]      = index;
+	lanes->ra_x[l]            = cc->ra.x;
+	lanes->ra_y[l]            = cc->ra.y;
+	lanes->rb_x[l]            = cc->rb.x;
+	lanes->rb_y[l]            = cc->rb.y;
+	lanes->normal_x[l]        = cc->normal.x;
+	lanes->normal_y[l]        = cc->normal.y;
+	lanes->tangent_x[l]       = cc->tangent.x;
+	lanes->tangent_y[l]       = cc->tangent.y;
+	lanes->mass_normal[l]     = cc->mass_normal;
+	lanes->mass_tangent[l]    = cc->mass_tangent;
+	lanes->normal_impulse[l]  = cc->normal_impulse;
+	lanes->tangent_impulse[l] = cc->tangent_impulse;
+	lanes->friction[l]        = cc->friction;
+	lanes->restitution_x[l]   = cc->restitution_bias.x;
+	lanes->restitution_y[l]   = cc->restitution_bias.y;
+	lanes->velocity_bias[l]   = cc->velocity_bias;
+	lanes->separation[l]      = cc->separation;
+}
+
+/**
+ * @brief greedy colouring of the constraints, a counting sort by colour and the groups of
+ * 		lanes of each colour. The ones which could not be coloured stay at the end.
+ */
+static void build_lanes_(opus_contact_solver *solver)
+{
+	size_t i, n, k, counts[OPUS_SOLVER_MAX_COLORS + 2];
+	int    c, l;
+
+	opus_contact_lanes *lanes;
+
+	n = opus_arr_len(solver->constraints);
+	opus_arr_resize(solver->colors_, solver->n_bodies + 1);
+	opus_arr_resize(solver->color_of_, n);
+	opus_arr_resize(solver->scratch_, n);
+	memset(solver->colors_, 0, sizeof(uint64_t) * (solver->n_bodies + 1));
+	memset(counts, 0, sizeof(counts));
+
+	for (i = 0; i < n; i++) {
+		c                    = color_constraint_(solver, &solver->constraints[i]);
+		solver->color_of_[i] = c;
+		solver->scratch_[i]  = solver->constraints[i];
+		counts[c + 1]++;
+	}
+
+	/* "counts[c]" is the start of colour c after the prefix sum, and its end after the sort */
+	for (c = 0; c <= OPUS_SOLVER_MAX_COLORS; c++) counts[c + 1] += counts[c];
+	for (i = 0; i < n; i++) solver->constraints[counts[solver->color_of_[i]]++] = solver->scratch_[i];
+	solver->n_laned = counts[OPUS_SOLVER_MAX_COLORS - 1];
+
+	for (c = 0, i = 0; c < OPUS_SOLVER_MAX_COLORS; c++) {
+		for (; i < counts[c]; i += OPUS_SOLVER_LANES) {
+			opus_arr_reserve(solver->lanes, 1);
+			lanes = &solver->lanes[opus_arr_len(solver->lanes)++];
+			for (l = 0, k = i; l < OPUS_SOLVER_LANES; l++, k++)
+				fill_lane_(solver, lanes, l, k < counts[c] ? (int) k : -1);
+		}
+		i = counts[c];
+	}
+}
+
+/**
+ * @brief copy every body of the world and every point of the awake contacts
+ * @param solver
+ * @param world
+ * @param dt of the step, for the velocity bias
+ */
+void opus_contact_solver_gather(opus_contact_solver *solver, opus_physics_world *world, opus_real dt)
+{
+	size_t i, n;
+	int    j;
+
+	opus_body               *body;
+	opus_contacts           *contacts;
+	opus_contact            *c;
+	opus_solver_body        *sb;
+	opus_contact_constraint *cc;
+
+	n = opus_arr_len(world->bodies);
+	opus_arr_resize(solver->bodies, n + 1);
+	memset(&solver->bodies[n], 0, sizeof(opus_solver_body));
+	solver->n_bodies = n;
+	for (i = 0; i < n; i++) {
+		body                = world->bodies[i];
+		body->solver_index_ = (int) i;
+
+		sb                   = &solver->bodies[i];
+		sb->velocity         = body->velocity;
+		sb->angular_velocity = body->angular_velocity;
+		sb->position         = body->position;
+		sb->rotation         = body->rotation;
+		sb->inv_mass         = body->type == OPUS_BODY_STATIC ? 0 : body->inv_mass;
+		sb->inv_inertia      = body->type == OPUS_BODY_STATIC ? 0 : body->inv_inertia;
+		sb->moves            = body->type != OPUS_BODY_STATIC && !body->is_sleeping;
+	}
+
+	opus_arr_clear(solver->constraints);
+	for (i = 0; i < opus_arr_len(world->awake_contacts_); i++) {
+		contacts = world->awake_contacts_[i];
+		for (j = 0; j < contacts->n_contacts; j++) {
+			c = &contacts->contacts[j];
+			if (!c->is_active) continue;
+
+			opus_arr_reserve(solver->constraints, 1);
+			cc = &solver->constraints[opus_arr_len(solver->constraints)++];
+
+			cc->a                = c->A->solver_index_;
+			cc->b                = c->B->solver_index_;
+			cc->ra               = c->ra;
+			cc->rb               = c->rb;
+			cc->normal           = c->normal;
+			cc->tangent          = c->tangent;
+			cc->mass_normal      = c->effective_mass_normal;
+			cc->mass_tangent     = c->effective_mass_tangent;
+			cc->normal_impulse   = c->normal_impulse;
+			cc->tangent_impulse  = c->tangent_impulse;
+			cc->friction         = contacts->friction;
+			cc->restitution_bias = c->restitution_bias;
+			cc->velocity_bias    = world->velocity_bias / dt * opus_max(0, opus_vec2_len(opus_vec2_sub(c->pa, c->pb)) - world->position_slop);
+			cc->separation       = c->separation_;
+			cc->pa               = c->pa;
+			cc->pb               = c->pb;
+			cc->contact          = c;
+		}
+	}
+
+	opus_arr_clear(solver->lanes);
+	solver->n_laned = 0;
+	if (world->use_simd_solver) build_lanes_(solver);
+}
+
+/**
+ * @brief copy the bodies back, OPUS_SOLVER_BODY_* of what changed
+ */
+void opus_contact_solver_scatter(opus_contact_solver *solver, opus_body **bodies, int parts)
+{
+	size_t            i;
+	opus_body        *body;
+	opus_solver_body *sb;
+
+	for (i = 0; i < solver->n_bodies; i++) {
+		body = bodies[i];
+		sb   = &solver->bodies[i];
+		if (parts & OPUS_SOLVER_BODY_VELOCITY) {
+			body->velocity         = sb->velocity;
+			body->angular_velocity = sb->angular_velocity;
+		}
+		if (parts & OPUS_SOLVER_BODY_POSE) {
+			body->position = sb->position;
+			body->rotation = sb->rotation;
+		}
+	}
+}
+
+/**
+ * @brief copy the bodies again after something else moved them, OPUS_SOLVER_BODY_* of what changed
+ */
+void opus_contact_solver_refresh(opus_contact_solver *solver, opus_body **bodies, int parts)
+{
+	size_t            i;
+	opus_body        *body;
+	opus_solver_body *sb;
+
+	for (i = 0; i < solver->n_bodies; i++) {
+		body = bodies[i];
+		sb   = &solver->bodies[i];
+		if (parts & OPUS_SOLVER_BODY_VELOCITY) {
+			sb->velocity         = body->velocity;
+			sb->angular_velocity = body->angular_velocity;
+		}
+		if (parts & OPUS_SOLVER_BODY_POSE) {
+			sb->position = body->position;
+			sb->rotation = body->rotation;
+		}
+	}
+}
+
+/**
+ * @brief the impulses (for the warm start of the next step) and the points back to the manifolds
+ */
+void opus_contact_solver_store_impulses(opus_contact_solver *solver)
+{
+	size_t                   i;
+	int                      l;
+	opus_contact_constraint *cc;
+	opus_contact_lanes      *lanes;
+
+	for (i = 0; i < opus_arr_len(solver->lanes); i++) {
+		lanes = &solver->lanes[i];
+		for (l = 0; l < OPUS_SOLVER_LANES; l++) {
+			if (lanes->constraint[l] < 0) continue;
+			cc                  = &solver->constraints[lanes->constraint[l]];
+			cc->normal_impulse  = lanes->normal_impulse[l];
+			cc->tangent_impulse = lanes->tangent_impulse[l];
+		}
+	}
+
+	for (i = 0; i < opus_arr_len(solver->constraints); i++) {
+		cc = &solver->constraints[i];
+
+		cc->contact->normal_impulse  = cc->normal_impulse;
+		cc->contact->tangent_impulse = cc->tangent_impulse;
+		cc->contact->pa              = cc->pa;
+		cc->contact->pb              = cc->pb;
+	}
+}
+
+static void apply_normal_impulse_(opus_solver_body *A, opus_solver_body *B, opus_contact_constraint *cc)
+{
+	opus_vec2 va, vb, dv, impulse;
+	opus_real dv_n, lambda_n, old_impulse_n;
+
+	va = opus_vec2_add(A->velocity, cross_rv(A->angular_velocity, cc->ra));
+	vb = opus_vec2_add(B->velocity, cross_rv(B->angular_velocity, cc->rb));
+	dv = opus_vec2_to(va, vb);
+
+	dv_n     = opus_vec2_dot(cc->normal, opus_vec2_sub(dv, cc->restitution_bias));
+	lambda_n = (-dv_n + cc->velocity_bias) * cc->mass_normal;
+
+	/* clamp normal impulse */
+	old_impulse_n      = cc->normal_impulse;
+	cc->normal_impulse = opus_max(old_impulse_n + lambda_n, 0);
+	lambda_n           = cc->normal_impulse - old_impulse_n;
+
+	if (opus_abs(lambda_n) > OPUS_REAL_EPSILON) {
+		impulse = opus_vec2_scale(cc->normal, lambda_n);
+		apply_impulse_(A, opus_vec2_neg(impulse), cc->ra);
+		apply_impulse_(B, impulse, cc->rb);
+	}
+}
+
+static void apply_tangent_impulse_(opus_solver_body *A, opus_solver_body *B, opus_contact_constraint *cc)
+{
+	opus_vec2 va, vb, dv, impulse;
+	opus_real dv_t, lambda_t, max_friction, old_tangent_impulse;
+
+	va = opus_vec2_add(A->velocity, cross_vr(cc->ra, A->angular_velocity));
+	vb = opus_vec2_add(B->velocity, cross_vr(cc->rb, B->angular_velocity));
+	dv = opus_vec2_to(va, vb);
+
+	dv_t     = opus_vec2_dot(cc->tangent, dv);
+	lambda_t = dv_t * cc->mass_tangent;
+
+	max_friction = cc->friction * cc->normal_impulse;
+
+	old_tangent_impulse = cc->tangent_impulse;
+	cc->tangent_impulse = opus_clamp(old_tangent_impulse + lambda_t, -max_friction, max_friction);
+	lambda_t            = cc->tangent_impulse - old_tangent_impulse;
+
+	impulse = opus_vec2_scale(cc->tangent, lambda_t);
+	apply_impulse_(A, impulse, cc->ra);
+	apply_impulse_(B, opus_vec2_neg(impulse), cc->rb);
+}
+
+#ifdef LANE_WIDTH_
+/* the bodies of LANE_WIDTH_ lanes of a group, with their velocities in vectors */
+typedef struct lane_bodies_ lane_bodies_;
+
+struct lane_bodies_ {
+	opus_solver_body *A[LANE_WIDTH_], *B[LANE_WIDTH_];
+
+	lane_v_ vax, vay, wa, vbx, vby, wb;
+	lane_v_ ima, iia, imb, iib;
+};
+
+/* the lanes [o, o + LANE_WIDTH_) */
+static void gather_lanes_(opus_contact_solver *solver, opus_contact_lanes *lanes, int o, lane_bodies_ *v)
+{
+	int l;
+
+	for (l = 0; l < LANE_WIDTH_; l++) {
+		v->A[l] = &solver->bodies[lanes->a[o + l]];
+		v->B[l] = &solver->bodies[lanes->b[o + l]];
+	}
+	v->vax = LANE_GATHER_(v->A, velocity.x);
+	v->vay = LANE_GATHER_(v->A, velocity.y);
+	v->wa  = LANE_GATHER_(v->A, angular_velocity);
+	v->ima = LANE_GATHER_(v->A, inv_mass);
+	v->iia = LANE_GATHER_(v->A, inv_inertia);
+	v->vbx = LANE_GATHER_(v->B, velocity.x);
+	v->vby = LANE_GATHER_(v->B, velocity.y);
+	v->wb  = LANE_GATHER_(v->B, angular_velocity);
+	v->imb = LANE_GATHER_(v->B, inv_mass);
+	v->iib = LANE_GATHER_(v->B, inv_inertia);
+}
+
+/* no moving body is in two lanes, the fixed ones get their velocity back unchanged */
+static void scatter_lanes_(lane_bodies_ *v)
+{
+	int       l;
+	opus_real vax[LANE_WIDTH_], vay[LANE_WIDTH_], wa[LANE_WIDTH_];
+	opus_real vbx[LANE_WIDTH_], vby[LANE_WIDTH_], wb[LANE_WIDTH_];
+
+	LANE_STORE_(vax, v->vax);
+	LANE_STORE_(vay, v->vay);
+	LANE_STORE_(wa, v->wa);
+	LANE_STORE_(vbx, v->vbx);
+	LANE_STORE_(vby, v->vby);
+	LANE_STORE_(wb, v->wb);
+	for (l = 0; l < LANE_WIDTH_; l++) {
+		v->A[l]->velocity.x       = vax[l];
+		v->A[l]->velocity.y       = vay[l];
+		v->A[l]->angular_velocity = wa[l];
+		v->B[l]->velocity.x       = vbx[l];
+		v->B[l]->velocity.y       = vby[l];
+		v->B[l]->angular_velocity = wb[l];
+	}
+}
+
+/* the impulse (px, py) on B and its opposite on A */
+static void push_lanes_(lane_bodies_ *v, lane_v_ rax, lane_v_ ray, lane_v_ rbx, lane_v_ rby, lane_v_ px, lane_v_ py)
+{
+	v->vax = LANE_SUB_(v->vax, LANE_MUL_(px, v->ima));
+	v->vay = LANE_SUB_(v->vay, LANE_MUL_(py, v->ima));
+	v->wa  = LANE_SUB_(v->wa, LANE_MUL_(v->iia, LANE_SUB_(LANE_MUL_(rax, py), LANE_MUL_(ray, px))));
+	v->vbx = LANE_ADD_(v->vbx, LANE_MUL_(px, v->imb));
+	v->vby = LANE_ADD_(v->vby, LANE_MUL_(py, v->imb));
+	v->wb  = LANE_ADD_(v->wb, LANE_MUL_(v->iib, LANE_SUB_(LANE_MUL_(rbx, py), LANE_MUL_(rby, px))));
+}
+
+/* the impulse (px, py) on A and its opposite on B, for the friction */
+static void pull_lanes_(lane_bodies_ *v, lane_v_ rax, lane_v_ ray, lane_v_ rbx, lane_v_ rby, lane_v_ px, lane_v_ py)
+{
+	v->vax = LANE_ADD_(v->vax, LANE_MUL_(px, v->ima));
+	v->vay = LANE_ADD_(v->vay, LANE_MUL_(py, v->ima));
+	v->wa  = LANE_ADD_(v->wa, LANE_MUL_(v->iia, LANE_SUB_(LANE_MUL_(rax, py), LANE_MUL_(ray, px))));
+	v->vbx = LANE_SUB_(v->vbx, LANE_MUL_(px, v->imb));
+	v->vby = LANE_SUB_(v->vby, LANE_MUL_(py, v->imb));
+	v->wb  = LANE_SUB_(v->wb, LANE_MUL_(v->iib, LANE_SUB_(LANE_MUL_(rbx, py), LANE_MUL_(rby, px))));
+}
+
+/**
+ * @brief "apply_normal_impulse_" and "apply_tangent_impulse_" of all the lanes, or the
+ * 		soft normal impulse of "opus_contact_solver_solve_soft" if "world" is not NULL.
+ * 		The operations are those of the scalar lanes in the same order, so the results
+ * 		are the same bit for bit.
+ */
+static void solve_lanes_(opus_contact_solver *solver, opus_contact_lanes *c, opus_physics_world *world, int use_bias, opus_real h)
+{
+	int          o;
+	lane_bodies_ v;
+	lane_v_      zero, one, sign, rax, ray, rbx, rby, nx, ny, tx, ty;
+	lane_v_      s, apart, bias, mass_scale, impulse_scale, dvx, dvy, dv, lambda, old_impulse, max_friction, impulse;
+
+	zero = LANE_SET1_(0);
+	one  = LANE_SET1_(1);
+	sign = LANE_SET1_(-0.0);
+
+	/* only set for the soft pass */
+	mass_scale = impulse_scale = zero;
+
+	for (o = 0; o < OPUS_SOLVER_LANES; o += LANE_WIDTH_) {
+		gather_lanes_(solver, c, o, &v);
+		rax = LANE_LOAD_(c->ra_x + o);
+		ray = LANE_LOAD_(c->ra_y + o);
+		rbx = LANE_LOAD_(c->rb_x + o);
+		rby = LANE_LOAD_(c->rb_y + o);
+		nx  = LANE_LOAD_(c->normal_x + o);
+		ny  = LANE_LOAD_(c->normal_y + o);
+		tx  = LANE_LOAD_(c->tangent_x + o);
+		ty  = LANE_LOAD_(c->tangent_y + o);
+
+		if (world) {
+			s = LANE_LOAD_(c->separation + o);
+			s = LANE_ADD_(s, LANE_MUL_(LANE_SUB_(LANE_GATHER_(v.B, position.x), LANE_GATHER_(v.A, position.x)), nx));
+			s = LANE_ADD_(s, LANE_MUL_(LANE_SUB_(LANE_GATHER_(v.B, position.y), LANE_GATHER_(v.A, position.y)), ny));
+			s = LANE_ADD_(s, LANE_MUL_(LANE_GATHER_(v.B, rotation), LANE_SUB_(LANE_MUL_(rbx, ny), LANE_MUL_(rby, nx))));
+			s = LANE_SUB_(s, LANE_MUL_(LANE_GATHER_(v.A, rotation), LANE_SUB_(LANE_MUL_(rax, ny), LANE_MUL_(ray, nx))));
+			s = LANE_ADD_(s, LANE_SET1_(world->position_slop));
+
+			/* with the sign of "velocity_bias", the lanes which are apart close the gap */
+			apart = LANE_GT_(s, zero);
+			bias  = LANE_DIV_(LANE_XOR_(s, sign), LANE_SET1_(h));
+			if (use_bias) {
+				dv            = LANE_MAX_(LANE_MUL_(LANE_SET1_(world->soft_bias_rate_), s), LANE_SET1_(-world->contact_push_max));
+				bias          = LANE_SELECT_(apart, bias, LANE_XOR_(dv, sign));
+				mass_scale    = LANE_SELECT_(apart, one, LANE_SET1_(world->soft_mass_scale_));
+				impulse_scale = LANE_SELECT_(apart, zero, LANE_SET1_(world->soft_impulse_scale_));
+			} else {
+				bias          = LANE_AND_(apart, bias);
+				mass_scale    = one;
+				impulse_scale = zero;
+			}
+		} else {
+			bias = LANE_LOAD_(c->velocity_bias + o);
+		}
+
+		/* normal */
+		dvx = LANE_SUB_(LANE_SUB_(v.vbx, LANE_MUL_(v.wb, rby)), LANE_SUB_(v.vax, LANE_MUL_(v.wa, ray)));
+		dvy = LANE_SUB_(LANE_ADD_(v.vby, LANE_MUL_(v.wb, rbx)), LANE_ADD_(v.vay, LANE_MUL_(v.wa, rax)));
+		dv  = LANE_ADD_(LANE_MUL_(nx, LANE_SUB_(dvx, LANE_LOAD_(c->restitution_x + o))),
+		                LANE_MUL_(ny, LANE_SUB_(dvy, LANE_LOAD_(c->restitution_y + o))));
+
+		old_impulse = LANE_LOAD_(c->normal_impulse + o);
+		lambda      = LANE_MUL_(LANE_ADD_(LANE_XOR_(dv, sign), bias), LANE_LOAD_(c->mass_normal + o));
+		/* times 1 minus 0 outside of the soft pass */
+		if (world) lambda = LANE_SUB_(LANE_MUL_(lambda, mass_scale), LANE_MUL_(impulse_scale, old_impulse));
+		impulse = LANE_MAX_(LANE_ADD_(old_impulse, lambda), zero);
+		lambda  = LANE_SUB_(impulse, old_impulse);
+		LANE_STORE_(c->normal_impulse + o, impulse);
+		push_lanes_(&v, rax, ray, rbx, rby, LANE_MUL_(nx, lambda), LANE_MUL_(ny, lambda));
+
+		/* friction, with the angular part of "apply_tangent_impulse_" */
+		dvx = LANE_SUB_(LANE_ADD_(v.vbx, LANE_MUL_(v.wb, rby)), LANE_ADD_(v.vax, LANE_MUL_(v.wa, ray)));
+		dvy = LANE_SUB_(LANE_SUB_(v.vby, LANE_MUL_(v.wb, rbx)), LANE_SUB_(v.vay, LANE_MUL_(v.wa, rax)));
+		dv  = LANE_ADD_(LANE_MUL_(tx, dvx), LANE_MUL_(ty, dvy));
+
+		max_friction = LANE_MUL_(LANE_LOAD_(c->friction + o), impulse);
+		old_impulse  = LANE_LOAD_(c->tangent_impulse + o);
+		lambda       = LANE_ADD_(old_impulse, LANE_MUL_(dv, LANE_LOAD_(c->mass_tangent + o)));
+		lambda       = LANE_MIN_(max_friction, LANE_MAX_(LANE_XOR_(max_friction, sign), lambda));
+		LANE_STORE_(c->tangent_impulse + o, lambda);
+		lambda = LANE_SUB_(lambda, old_impulse);
+		pull_lanes_(&v, rax, ray, rbx, rby, LANE_MUL_(tx, lambda), LANE_MUL_(ty, lambda));
+
+		scatter_lanes_(&v);
+	}
+}
+
+static void warm_start_lanes_(opus_contact_solver *solver, opus_contact_lanes *c)
+{
+	int          o;
+	lane_bodies_ v;
+	lane_v_      ni, ti, px, py;
+
+	for (o = 0; o < OPUS_SOLVER_LANES; o += LANE_WIDTH_) {
+		gather_lanes_(solver, c, o, &v);
+		ni = LANE_LOAD_(c->normal_impulse + o);
+		ti = LANE_LOAD_(c->tangent_impulse + o);
+		px = LANE_SUB_(LANE_MUL_(LANE_LOAD_(c->normal_x + o), ni), LANE_MUL_(LANE_LOAD_(c->tangent_x + o), ti));
+		py = LANE_SUB_(LANE_MUL_(LANE_LOAD_(c->normal_y + o), ni), LANE_MUL_(LANE_LOAD_(c->tangent_y + o), ti));
+		push_lanes_(&v, LANE_LOAD_(c->ra_x + o), LANE_LOAD_(c->ra_y + o), LANE_LOAD_(c->rb_x + o), LANE_LOAD_(c->rb_y + o), px, py);
+		scatter_lanes_(&v);
+	}
+}
+#else
+/* the velocities of the bodies of a group of lanes */
+typedef struct lane_bodies_ lane_bodies_;
+
+struct lane_bodies_ {
+	opus_real vax[OPUS_SOLVER_LANES], vay[OPUS_SOLVER_LANES], wa[OPUS_SOLVER_LANES];
+	opus_real vbx[OPUS_SOLVER_LANES], vby[OPUS_SOLVER_LANES], wb[OPUS_SOLVER_LANES];
+	opus_real ima[OPUS_SOLVER_LANES], iia[OPUS_SOLVER_LANES], imb[OPUS_SOLVER_LANES], iib[OPUS_SOLVER_LANES];
+};
+
+static void gather_lanes_(opus_contact_solver *solver, opus_contact_lanes *lanes, lane_bodies_ *v)
+{
+	int               l;
+	opus_solver_body *A, *B;
+
+	for (l = 0; l < OPUS_SOLVER_LANES; l++) {
+		A         = &solver->bodies[lanes->a[l]];
+		B         = &solver->bodies[lanes->b[l]];
+		v->vax[l] = A->velocity.x;
+		v->vay[l] = A->velocity.y;
+		v->wa[l]  = A->angular_velocity;
+		v->ima[l] = A->inv_mass;
+		v->iia[l] = A->inv_inertia;
+		v->vbx[l] = B->velocity.x;
+		v->vby[l] = B->velocity.y;
+		v->wb[l]  = B->angular_velocity;
+		v->imb[l] = B->inv_mass;
+		v->iib[l] = B->inv_inertia;
+	}
+}
+
+/* no moving body is in two lanes, the fixed ones get their velocity back unchanged */
+static void scatter_lanes_(opus_contact_solver *solver, opus_contact_lanes *lanes, lane_bodies_ *v)
+{
+	int               l;
+	opus_solver_body *A, *B;
+
+	for (l = 0; l < OPUS_SOLVER_LANES; l++) {
+		A                   = &solver->bodies[lanes->a[l]];
+		B                   = &solver->bodies[lanes->b[l]];
+		A->velocity.x       = v->vax[l];
+		A->velocity.y       = v->vay[l];
+		A->angular_velocity = v->wa[l];
+		B->velocity.x       = v->vbx[l];
+		B->velocity.y       = v->vby[l];
+		B->angular_velocity = v->wb[l];
+	}
+}
+
+/**
+ * @brief "apply_normal_impulse_" and "apply_tangent_impulse_" of all the lanes, or the
+ * 		soft normal impulse of "opus_contact_solver_solve_soft" if "world" is not NULL
+ */
+static void solve_lanes_(opus_contact_solver *solver, opus_contact_lanes *c, opus_physics_world *world, int use_bias, opus_real h)
+{
+	int               l;
+	lane_bodies_      v;
+	opus_solver_body *A, *B;
+
+	opus_real bias[OPUS_SOLVER_LANES], mass_scale[OPUS_SOLVER_LANES], impulse_scale[OPUS_SOLVER_LANES];
+	opus_real s, soft_bias, dvx, dvy, dv_n, dv_t, lambda, old_impulse, max_friction, px, py;
+
+	gather_lanes_(solver, c, &v);
+
+	if (world) {
+		for (l = 0; l < OPUS_SOLVER_LANES; l++) {
+			A = &solver->bodies[c->a[l]];
+			B = &solver->bodies[c->b[l]];
+			s = c->separation[l] + (B->position.x - A->position.x) * c->normal_x[l] +
+			    (B->position.y - A->position.y) * c->normal_y[l] +
+			    B->rotation * (c->rb_x[l] * c->normal_y[l] - c->rb_y[l] * c->normal_x[l]) -
+			    A->rotation * (c->ra_x[l] * c->normal_y[l] - c->ra_y[l] * c->normal_x[l]) + world->position_slop;
+			soft_bias = world->soft_bias_rate_ * s;
+			soft_bias = soft_bias > -world->contact_push_max ? soft_bias : -world->contact_push_max;
+
+			/* with the sign of "velocity_bias" */
+			bias[l]          = s > 0 ? -s / h : use_bias ? -soft_bias : 0;
+			mass_scale[l]    = s > 0 || !use_bias ? 1 : world->soft_mass_scale_;
+			impulse_scale[l] = s > 0 || !use_bias ? 0 : world->soft_impulse_scale_;
+		}
+	} else {
+		for (l = 0; l < OPUS_SOLVER_LANES; l++) {
+			bias[l]          = c->velocity_bias[l];
+			mass_scale[l]    = 1;
+			impulse_scale[l] = 0;
+		}
+	}
+
+	for (l = 0; l < OPUS_SOLVER_LANES; l++) {
+		/* normal */
+		dvx  = v.vbx[l] - v.wb[l] * c->rb_y[l] - (v.vax[l] - v.wa[l] * c->ra_y[l]);
+		dvy  = v.vby[l] + v.wb[l] * c->rb_x[l] - (v.vay[l] + v.wa[l] * c->ra_x[l]);
+		dv_n = c->normal_x[l] * (dvx - c->restitution_x[l]) + c->normal_y[l] * (dvy - c->restitution_y[l]);
+
+		lambda               = (-dv_n + bias[l]) * c->mass_normal[l] * mass_scale[l] - impulse_scale[l] * c->normal_impulse[l];
+		old_impulse          = c->normal_impulse[l];
+		c->normal_impulse[l] = old_impulse + lambda > 0 ? old_impulse + lambda : 0;
+		lambda               = c->normal_impulse[l] - old_impulse;
+
+		px = c->normal_x[l] * lambda;
+		py = c->normal_y[l] * lambda;
+		v.vax[l] -= px * v.ima[l];
+		v.vay[l] -= py * v.ima[l];
+		v.wa[l] -= v.iia[l] * (c->ra_x[l] * py - c->ra_y[l] * px);
+		v.vbx[l] += px * v.imb[l];
+		v.vby[l] += py * v.imb[l];
+		v.wb[l] += v.iib[l] * (c->rb_x[l] * py - c->rb_y[l] * px);
+
+		/* friction, with the angular part of "apply_tangent_impulse_" */
+		dvx  = v.vbx[l] + v.wb[l] * c->rb_y[l] - (v.vax[l] + v.wa[l] * c->ra_y[l]);
+		dvy  = v.vby[l] - v.wb[l] * c->rb_x[l] - (v.vay[l] - v.wa[l] * c->ra_x[l]);
+		dv_t = c->tangent_x[l] * dvx + c->tangent_y[l] * dvy;
+
+		lambda                = dv_t * c->mass_tangent[l];
+		max_friction          = c->friction[l] * c->normal_impulse[l];
+		old_impulse           = c->tangent_impulse[l];
+		lambda                = old_impulse + lambda;
+		lambda                = lambda < -max_friction ? -max_friction : lambda > max_friction ? max_friction : lambda;
+		c->tangent_impulse[l] = lambda;
+		lambda                = lambda - old_impulse;
+
+		px = c->tangent_x[l] * lambda;
+		py = c->tangent_y[l] * lambda;
+		v.vax[l] += px * v.ima[l];
+		v.vay[l] += py * v.ima[l];
+		v.wa[l] += v.iia[l] * (c->ra_x[l] * py - c->ra_y[l] * px);
+		v.vbx[l] -= px * v.imb[l];
+		v.vby[l] -= py * v.imb[l];
+		v.wb[l] -= v.iib[l] * (c->rb_x[l] * py - c->rb_y[l] * px);
+	}
+
+	scatter_lanes_(solver, c, &v);
+}
+
+static void warm_start_lanes_(opus_contact_solver *solver, opus_contact_lanes *c)
+{
+	int          l;
+	lane_bodies_ v;
+	opus_real    px, py;
+
+	gather_lanes_(solver, c, &v);
+	for (l = 0; l < OPUS_SOLVER_LANES; l++) {
+		px = c->normal_x[l] * c->normal_impulse[l] - c->tangent_x[l] * c->tangent_impulse[l];
+		py = c->normal_y[l] * c->normal_impulse[l] - c->tangent_y[l] * c->tangent_impulse[l];
+		v.vax[l] -= px * v.ima[l];
+		v.vay[l] -= py * v.ima[l];
+		v.wa[l] -= v.iia[l] * (c->ra_x[l] * py - c->ra_y[l] * px);
+		v.vbx[l] += px * v.imb[l];
+		v.vby[l] += py * v.imb[l];
+		v.wb[l] += v.iib[l] * (c->rb_x[l] * py - c->rb_y[l] * px);
+	}
+	scatter_lanes_(solver, c, &v);
+}
+#endif
+
+/**
+ * @brief one velocity pass of OPUS_SOLVER_ITERATIVE over all the points
+ */
+void opus_contact_solver_solve_velocity(opus_contact_solver *solver)
+{
+	size_t                   i;
+	opus_contact_constraint *cc;
+
+	for (i = 0; i < opus_arr_len(solver->lanes); i++) solve_lanes_(solver, &solver->lanes[i], NULL, 0, 0);
+	for (i = solver->n_laned; i < opus_arr_len(solver->constraints); i++) {
+		cc = &solver->constraints[i];
+		apply_normal_impulse_(&solver->bodies[cc->a], &solver->bodies[cc->b], cc);
+		apply_tangent_impulse_(&solver->bodies[cc->a], &solver->bodies[cc->b], cc);
+	}
+}
+
+/**
+ * @brief one position pass of OPUS_SOLVER_ITERATIVE, moves the bodies apart along the normals
+ */
+void opus_contact_solver_solve_position(opus_contact_solver *solver, opus_physics_world *world, opus_real dt)
+{
+	size_t i;
+
+	opus_contact_constraint *cc;
+	opus_solver_body        *A, *B;
+	opus_vec2                dp, p;
+	opus_real                bias, lambda;
+
+	for (i = 0; i < opus_arr_len(solver->constraints); i++) {
+		cc = &solver->constraints[i];
+		A  = &solver->bodies[cc->a];
+		B  = &solver->bodies[cc->b];
+
+		/* check if position constraint is solved already */
+		cc->pa = opus_vec2_add(A->position, cc->ra);
+		cc->pb = opus_vec2_add(B->position, cc->rb);
+		dp     = opus_vec2_to(cc->pa, cc->pb);
+		if (opus_vec2_dot(dp, cc->normal) > 0) continue;
+
+		bias   = world->position_bias / dt * opus_max(opus_vec2_len(dp) - world->position_slop, 0.f);
+		lambda = cc->mass_normal * bias;
+		p      = opus_vec2_scale(cc->normal, lambda);
+
+		if (A->moves) {
+			A->position = opus_vec2_sub(A->position, opus_vec2_scale(p, A->inv_mass));
+			A->rotation -= A->inv_inertia * opus_vec2_cross(cc->ra, p);
+		}
+		if (B->moves) {
+			B->position = opus_vec2_add(B->position, opus_vec2_scale(p, B->inv_mass));
+			B->rotation += B->inv_inertia * opus_vec2_cross(cc->rb, p);
+		}
+	}
+}
+
+/**
+ * @brief the impulses of the last sub-step of OPUS_SOLVER_SOFT_STEP, or of the last step
+ * 		for the first one
+ */
+void opus_contact_solver_warm_start(opus_contact_solver *solver)
+{
+	size_t i;
+
+	opus_contact_constraint *cc;
+	opus_vec2                impulse;
+
+	for (i = 0; i < opus_arr_len(solver->lanes); i++) warm_start_lanes_(solver, &solver->lanes[i]);
+	for (i = solver->n_laned; i < opus_arr_len(solver->constraints); i++) {
+		cc = &solver->constraints[i];
+
+		/* the friction is applied to A along the tangent */
+		impulse.x = cc->normal.x * cc->normal_impulse - cc->tangent.x * cc->tangent_impulse;
+		impulse.y = cc->normal.y * cc->normal_impulse - cc->tangent.y * cc->tangent_impulse;
+		apply_impulse_(&solver->bodies[cc->a], opus_vec2_neg(impulse), cc->ra);
+		apply_impulse_(&solver->bodies[cc->b], impulse, cc->rb);
+	}
+}
+
+/**
+ * @brief one soft pass of OPUS_SOLVER_SOFT_STEP, or the relaxing one if "use_bias" is 0,
+ * 		the same as "solve_contacts_soft_" of world.c
+ */
+void opus_contact_solver_solve_soft(opus_contact_solver *solver, opus_physics_world *world, int use_bias, opus_real h)
+{
+	size_t i;
+
+	opus_contact_constraint *cc;
+	opus_solver_body        *A, *B;
+	opus_vec2                va, vb, dv, impulse;
+	opus_real                s, bias, mass_scale, impulse_scale, dv_n, lambda, old_impulse;
+
+	for (i = 0; i < opus_arr_len(solver->lanes); i++) solve_lanes_(solver, &solver->lanes[i], world, use_bias, h);
+	for (i = solver->n_laned; i < opus_arr_len(solver->constraints); i++) {
+		cc = &solver->constraints[i];
+		A  = &solver->bodies[cc->a];
+		B  = &solver->bodies[cc->b];
+
+		/* negative when overlapping, up to the slop */
+		s = cc->separation + opus_vec2_dot(opus_vec2_to(A->position, B->position), cc->normal) +
+		    B->rotation * opus_vec2_cross(cc->rb, cc->normal) - A->rotation * opus_vec2_cross(cc->ra, cc->normal) +
+		    world->position_slop;
+
+		mass_scale    = 1;
+		impulse_scale = 0;
+		if (s > 0) {
+			/* apart, let them close the gap in this sub-step */
+			bias = s / h;
+		} else if (use_bias) {
+			bias          = opus_max(world->soft_bias_rate_ * s, -world->contact_push_max);
+			mass_scale    = world->soft_mass_scale_;
+			impulse_scale = world->soft_impulse_scale_;
+		} else {
+			bias = 0;
+		}
+
+		va = opus_vec2_add(A->velocity, cross_rv(A->angular_velocity, cc->ra));
+		vb = opus_vec2_add(B->velocity, cross_rv(B->angular_velocity, cc->rb));
+		dv = opus_vec2_to(va, vb);
+
+		dv_n   = opus_vec2_dot(cc->normal, opus_vec2_sub(dv, cc->restitution_bias));
+		lambda = -cc->mass_normal * mass_scale * (dv_n + bias) - impulse_scale * cc->normal_impulse;
+
+		old_impulse        = cc->normal_impulse;
+		cc->normal_impulse = opus_max(old_impulse + lambda, 0);
+		lambda             = cc->normal_impulse - old_impulse;
+
+		impulse = opus_vec2_scale(cc->normal, lambda);
+		apply_impulse_(A, opus_vec2_neg(impulse), cc->ra);
+		apply_impulse_(B, impulse, cc->rb);
+
+		apply_tangent_impulse_(A, B, cc);
+	}
+}
+
+/**
+ * @brief move the bodies for a sub-step of OPUS_SOLVER_SOFT_STEP, the rotation is not wrapped
+ */
+void opus_contact_solver_integrate(opus_contact_solver *solver, opus_real h, opus_real damping)
+{
+	size_t            i;
+	opus_solver_body *sb;
+
+	for (i = 0; i < solver->n_bodies; i++) {
+		sb = &solver->bodies[i];
+		if (!sb->moves) continue;
+
+		sb->velocity.x *= damping;
+		sb->velocity.y *= damping;
+		sb->position.x += sb->velocity.x * h;
+		sb->position.y += sb->velocity.y * h;
+		sb->rotation += sb->angular_velocity * h;
+	}
+}
@@ -30,6 +30,56 @@ void opus_joint_destroy(opus_joint *joint)
 	}
 }
 
+/**
+ * @brief bodies connected by the joint, NULL for the ones attached to the world
+ * @param joint
+ * @param A
+ * @param B
+ */
+void opus_joint_get_bodies(opus_joint *joint, opus_body **A, opus_body **B)
+{
+	*A = *B = NULL;
+	switch (joint->type) {
+		case OPUS_JOINT_DISTANCE:
+			*A = ((opus_joint_distance *) joint)->body;
+			break;
+		case OPUS_JOINT_REVOLUTE:
+			*A = ((opus_joint_revolute *) joint)->A;
+			*B = ((opus_joint_revolute *) joint)->B;
+			break;
+	}
+}
+
+/**
+ * @brief the impulse accumulated over the steps, which is carried to the warm start of the next step
+ * @param joint
+ * @param impulse only x is used by the distance joint
+ */
+void opus_joint_get_impulse(opus_joint *joint, opus_vec2 *impulse)
+{
+	opus_vec2_set(impulse, 0, 0);
+	switch (joint->type) {
+		case OPUS_JOINT_DISTANCE:
+			impulse->x = ((opus_joint_distance *) joint)->accumulated_impulse_;
+			break;
+		case OPUS_JOINT_REVOLUTE:
+			*impulse = ((opus_joint_revolute *) joint)->impulse;
+			break;
+	}
+}
+
+void opus_joint_set_impulse(opus_joint *joint, opus_vec2 impulse)
+{
+	switch (joint->type) {
+		case OPUS_JOINT_DISTANCE:
+			((opus_joint_distance *) joint)->accumulated_impulse_ = impulse.x;
+			break;
+		case OPUS_JOINT_REVOLUTE:
+			((opus_joint_revolute *) joint)->impulse = impulse;
+			break;
+	}
+}
+
 opus_joint_distance *opus_joint_distance_create(opus_body *body, opus_vec2 offset, opus_vec2 anchor, opus_real min_distance, opus_real max_distance)
 {
 	opus_joint_distance *joint;
@@ -17,6 +17,15 @@
 #include "physics/opus/physics_private.h"
 #include "data_structure/array.h"
 
+/* ids of the bodies count per world, so that the pair keys and with them the order of the
+ * 		contacts do not depend on the bodies created elsewhere before */
+static void add_body_(opus_physics_world *world, opus_body *body)
+{
+	opus_recycle_physics_id(body->id);
+	body->id = ++world->body_id_;
+	opus_arr_push(world->bodies, &body);
+	world->query_dirty_ = 1;
+}
 
 opus_body *opus_physics_world_add_polygon(opus_physics_world *world, opus_vec2 position, opus_vec2 *vertices, size_t n)
 {
@@ -28,7 +37,7 @@ opus_body *opus_physics_world_add_polygon(opus_physics_world *world, opus_vec2 p
 	opus_body_set_shape(body, (opus_shape *) shape);
 	opus_body_set_position(body, position);
 
-	opus_arr_push(world->bodies, &body);
+	add_body_(world, body);
 
 	return body;
 }
@@ -80,7 +89,7 @@ opus_body *opus_physics_world_add_circle(opus_physics_world *world, opus_vec2 po
 	opus_body_set_shape(body, (opus_shape *) circle);
 	opus_body_set_position(body, position);
 
-	opus_arr_push(world->bodies, &body);
+	add_body_(world, body);
 
 	return body;
 }
@@ -115,39 +124,38 @@ opus_joint *opus_physics_world_add_revolute_joint(opus_physics_world *world,
 
 void opus_physics_world_remove_body(opus_physics_world *world, opus_body *body)
 {
-	uint64_t i, j;
+	uint64_t i;
+
+	opus_pair_entry *entry;
+	opus_contacts   *contacts;
 
-	opus_contacts *contacts;
-	opus_contact *contact;
-	opus_contacts **to_removed;
+	/* the rest of its island is resting on it */
+	opus_sleeping_wake_up(body);
 
 	/* remove it from world */
+	if (world->sap) opus_sap_remove(world->sap, body);
+	if (world->bvh) opus_bvh_remove(world->bvh, body);
+	if (world->query_tree_) opus_bvh_remove(world->query_tree_, body);
 	for (i = 0; i < opus_arr_len(world->bodies); i++) {
 		if (world->bodies[i] == body) {
 			opus_arr_remove(world->bodies, i);
-			return;
+			break;
 		}
 	}
 
-	/* clear records in contacts map */
-	opus_arr_create(to_removed, sizeof(opus_contacts *));
-	opus_hashmap_foreach_start(&world->contacts, contacts, i)
-	{
-		contacts = *(opus_contacts **) contacts;
-		if (contacts->A == body || contacts->B == body) opus_arr_push(to_removed, &contacts);
-	}
-	opus_hashmap_foreach_end();
-	for (i = 0; i < opus_arr_len(to_removed); i++) {
-		opus_hashmap_delete(&world->contacts, to_removed[i]);
-		opus_contacts_destroy(to_removed[i]);
+	/* clear records in contacts map, entries are shifted backward on removal */
+	i = 0;
+	while (i < world->contacts.capacity) {
+		entry    = &world->contacts.entries[i];
+		contacts = entry->value;
+		if (entry->key != OPUS_PAIR_KEY_EMPTY && (contacts->A == body || contacts->B == body)) {
+			opus_pair_cache_remove_at(&world->contacts, i);
+			opus_contacts_destroy(&world->contacts_pool, contacts);
+			continue;
+		}
+		i++;
 	}
-	opus_arr_destroy(to_removed);
 
 	/* destroy this body */
 	opus_body_destroy(body);
 }
-
-
-
-
-
@@ -45,7 +45,7 @@ void opus_shape_circle_destroy(opus_circle *circle)
 	free(circle);
 }
 
-opus_vec2 opus_shape_circle_get_support(opus_shape *shape, opus_mat2d transform, opus_vec2 dir,
+opus_vec2 opus_shape_circle_get_support(opus_shape *shape, opus_transform *transform, opus_vec2 dir,
                                         size_t *index)
 {
 	opus_circle *circle = (void *) shape;
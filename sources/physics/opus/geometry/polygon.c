@@ -74,20 +74,21 @@ void opus_shape_polygon_destroy(opus_polygon *polygon)
  * @param dir
  * @return
  */
-opus_vec2 opus_shape_polygon_get_support(opus_shape *shape, opus_mat2d transform, opus_vec2 dir,
+opus_vec2 opus_shape_polygon_get_support(opus_shape *shape, opus_transform *transform, opus_vec2 dir,
                                          size_t *index)
 {
 	opus_polygon *polygon = (void *) shape;
 
 	size_t     n        = polygon->n;
-	opus_vec2 *vertices = polygon->vertices, p;
+	opus_vec2 *vertices = polygon->vertices;
 
 	size_t    i, max_i = 0;
 	opus_real max = -OPUS_REAL_MAX, dot;
 
+	/* the translation does not change the order, compare in the local space of the polygon */
+	dir = opus_transform_rotate_inv(transform, dir);
 	for (i = 0; i < n; i++) {
-		p   = opus_mat2d_pre_mul_vec(transform, vertices[i]);
-		dot = opus_vec2_dot(p, dir);
+		dot = opus_vec2_dot(vertices[i], dir);
 		if (dot > max) {
 			max   = dot;
 			max_i = i;
@@ -109,17 +110,17 @@ void opus_shape_polygon_update_bound(opus_shape *shape, opus_real rotation, opus
 {
 	opus_polygon *polygon = (void *) shape;
 
-	opus_mat2d transform;
-	size_t     i;
-	opus_real  x, y;
-	opus_real  min_x = OPUS_REAL_MAX, min_y = OPUS_REAL_MAX, max_x = -OPUS_REAL_MAX, max_y = -OPUS_REAL_MAX;
+	opus_transform transform;
+	opus_vec2      p;
+	size_t         i;
+	opus_real      x, y;
+	opus_real      min_x = OPUS_REAL_MAX, min_y = OPUS_REAL_MAX, max_x = -OPUS_REAL_MAX, max_y = -OPUS_REAL_MAX;
 
-	opus_mat2d_rotate_about(transform, (float) rotation, position);
+	opus_transform_set(&transform, rotation, position);
 	for (i = 0; i < polygon->n; i++) {
-		x = polygon->vertices[i].x;
-		y = polygon->vertices[i].y;
-
-		opus_mar2d_pre_mul_xy(&x, &y, transform, x, y);
+		p = opus_transform_apply(&transform, polygon->vertices[i]);
+		x = p.x;
+		y = p.y;
 
 		if (x < min_x) min_x = x;
 		if (x > max_x) max_x = x;
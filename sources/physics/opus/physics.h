@@ -14,13 +14,9 @@
 #ifndef PHYSICS_H
 #define PHYSICS_H
 
-#include "vg/pluto/plutovg-private.h"
-#include "vg/pluto/plutovg.h"
-#include "vg/vg_color.h"
-#include "vg/vg_utils.h"
-
 #include "math/math.h"
 #include "data_structure/hashmap.h"
+#include "data_structure/pool.h"
 #include "math/geometry.h"
 
 enum { OPUS_SHAPE_UNKNOWN,
@@ -36,6 +32,42 @@ enum {
 	OPUS_CONSTRAINT_UNKNOWN,
 	OPUS_CONSTRAINT_DISTANCE = 1
 };
+enum {
+	OPUS_BROAD_PHASE_SAP             = 1, /* sort and sweep all the bodies every step */
+	OPUS_BROAD_PHASE_SAP_INCREMENTAL = 2, /* keep sorted endpoints across steps */
+	OPUS_BROAD_PHASE_BVH             = 3, /* dynamic aabb tree with fat aabbs */
+	OPUS_BROAD_PHASE_GRID            = 4  /* uniform hash grid, for bodies of about the same size */
+};
+enum {
+	OPUS_NARROW_PHASE_SAT = 1, /* separating axes on the cached world vertices */
+	OPUS_NARROW_PHASE_GJK = 2  /* GJK + EPA warm started from the last step, analytic circles */
+};
+enum {
+	OPUS_SOLVER_ITERATIVE = 1, /* "velocity_iteration" passes, then "position_iteration" passes moving the bodies apart */
+	OPUS_SOLVER_SOFT_STEP = 2  /* "sub_steps" sub-steps of one soft pass and one relaxing pass, see "contact_hertz" */
+};
+enum {
+	OPUS_PHASE_BROAD,          /* broad phase and the body transforms */
+	OPUS_PHASE_NARROW,         /* narrow phase, contact generation and warm start of the candidate pairs */
+	OPUS_PHASE_CONTACTS,       /* dropping the contacts not touching any more, collecting the awake ones */
+	OPUS_PHASE_PREPARE,        /* joints, constraints and the colour batches of the parallel solver */
+	OPUS_PHASE_SOLVE_VELOCITY, /* joints, constraints and contacts */
+	OPUS_PHASE_INTEGRATE,      /* forces into velocity, velocity into position */
+	OPUS_PHASE_SOLVE_POSITION,
+	OPUS_PHASE_BULLETS,  /* continuous collision of OPUS_BODY_BULLET */
+	OPUS_PHASE_SLEEPING, /* waking and putting the islands to sleep */
+	OPUS_PHASE_COUNT
+};
+enum {
+	OPUS_DEBUG_DRAW_CONTACTS = 1, /* contact points and their normals */
+	OPUS_DEBUG_DRAW_JOINTS   = 2, /* anchors of the joints and the lines to their bodies */
+	OPUS_DEBUG_DRAW_BVH      = 4  /* boxes of OPUS_BROAD_PHASE_BVH */
+};
+enum {
+	OPUS_DEBUG_LINE   = 1,
+	OPUS_DEBUG_CIRCLE = 2, /* filled */
+	OPUS_DEBUG_RECT   = 3  /* outlined */
+};
 enum {
 	OPUS_JOINT_UNKNOWN,
 	OPUS_JOINT_DISTANCE = 1,
@@ -56,9 +88,26 @@ typedef struct opus_joint_revolute opus_joint_revolute;
 typedef struct opus_constraint          opus_constraint;
 typedef struct opus_constraint_distance opus_constraint_distance;
 
-typedef struct opus_physics_world opus_physics_world;
-
-typedef opus_vec2 (*opus_get_support_cb)(opus_shape *shape, opus_mat2d transform, opus_vec2 dir, size_t *index);
+typedef struct opus_physics_world   opus_physics_world;
+typedef struct opus_physics_profile opus_physics_profile;
+typedef struct opus_debug_cmd       opus_debug_cmd;
+
+typedef struct opus_pair_entry opus_pair_entry;
+typedef struct opus_pair_cache opus_pair_cache;
+typedef struct opus_sat_cache  opus_sat_cache;
+typedef struct opus_sleep_pair opus_sleep_pair;
+typedef struct opus_narrow_pair opus_narrow_pair;
+typedef struct opus_contacts   opus_contacts;
+typedef struct opus_sap        opus_sap;
+typedef struct opus_bvh        opus_bvh;
+typedef struct opus_grid       opus_grid;
+typedef struct opus_solver     opus_solver;
+typedef struct opus_ray        opus_ray;
+typedef struct opus_ray_hit    opus_ray_hit;
+
+typedef struct opus_contact_solver opus_contact_solver;
+
+typedef opus_vec2 (*opus_get_support_cb)(opus_shape *shape, opus_transform *transform, opus_vec2 dir, size_t *index);
 typedef opus_real (*opus_get_inertia_cb)(opus_shape *shape, opus_real mass);
 typedef void (*opus_update_bound_cb)(opus_shape *shape, opus_real rotation, opus_vec2 position);
 typedef opus_real (*opus_get_area_cb)(opus_shape *shape);
@@ -68,11 +117,91 @@ typedef void (*opus_joint_solve_position_cb)(opus_joint *joint, opus_real dt);
 typedef void (*opus_constraint_prepare_cb)(opus_constraint *constraint, opus_real dt);
 typedef void (*opus_constraint_solve_velocity_cb)(opus_constraint *constraint, opus_real dt);
 typedef void (*opus_constraint_solve_position_cb)(opus_constraint *constraint, opus_real dt);
+typedef int (*opus_query_cb)(opus_body *body, void *data); /* return 0 to stop the query */
+
+struct opus_ray {
+	opus_vec2 origin;
+	opus_vec2 translation; /* the ray ends at "origin + translation" */
+	uint32_t  bitmask;     /* only the bodies sharing a bit with it are hit */
+};
+
+struct opus_ray_hit {
+	opus_body *body; /* NULL if nothing is hit */
+	opus_vec2  point;
+	opus_vec2  normal;   /* of the surface hit, against the ray */
+	opus_real  fraction; /* of the translation */
+};
+
+struct opus_pair_entry {
+	uint64_t key; /* packed (min_id, max_id), see "opus_pair_key" */
+	void    *value;
+};
+
+/**
+ * @brief open-addressing (linear probing) table specialised for packed pair keys
+ */
+struct opus_pair_cache {
+	opus_pair_entry *entries;
+	uint64_t         capacity; /* always the power of 2 */
+	uint64_t         count;
+
+	uint64_t mask_;
+	uint64_t grow_at_;
+};
+
+/**
+ * @brief world space vertices and edge normals of the polygon bodies, rebuilt once per step
+ * 		so that the narrow phase does not transform them again for every pair, see SAT.c
+ */
+struct opus_sat_cache {
+	opus_real *x, *y;   /* vertices, each polygon is padded to a multiple of 4 with its last vertex */
+	opus_real *nx, *ny; /* unit normal of the edge (i, i + 1) */
+};
+
+/**
+ * @brief where the last step went, only filled in when the library is built with
+ * 		OPUS_PHYSICS_PROFILE, otherwise it stays zeroed and the step does not pay for it.
+ * 		The clock is sokol_time, set up by the first world created.
+ */
+struct opus_physics_profile {
+	double phase_ns[OPUS_PHASE_COUNT]; /* OPUS_PHASE_*, see "opus_physics_phase_name" */
+	double step_ns;                    /* the phases plus the bookkeeping between them */
+
+	uint64_t candidate_pairs; /* from the broad phase, the sleeping ones included */
+	uint64_t sleeping_pairs;  /* resting pairs in contact, skipped unless woken up */
+	uint64_t narrow_tests;    /* calls to SAT or GJK, see "narrow_phase" */
+	uint64_t touching_pairs;  /* pairs with contacts the solver goes through */
+	uint64_t active_contacts; /* contact points of the touching pairs */
+	uint64_t warm_starts;     /* contact points matched with the last step, started with its impulses */
+	uint64_t new_contacts;    /* contact points without a match, started from zero */
+	uint64_t allocations;     /* growth of the contact pool, the pair cache and the arrays of the step */
+
+	uint64_t begin_[OPUS_PHASE_COUNT];
+	uint64_t step_begin_;
+};
+
+/**
+ * @brief one shape of the debug drawing, the world records them after the step and a
+ * 		renderer draws them however it likes, so the physics draws nothing by itself
+ */
+struct opus_debug_cmd {
+	int       type;  /* OPUS_DEBUG_* */
+	uint32_t  color; /* 0xRRGGBBAA */
+	opus_vec2 a, b;  /* ends of a line, min and max of a rect, centre of a circle */
+	opus_real size;  /* width of a line or a rect, radius of a circle */
+};
 
 struct opus_physics_world {
 	int velocity_iteration; /* rest contact resolution iterations */
 	int position_iteration; /* position correction iterations */
-	int draw_contacts;
+	int solver_mode;        /* OPUS_SOLVER_* */
+	int sub_steps;          /* of OPUS_SOLVER_SOFT_STEP */
+	int debug_draw; /* OPUS_DEBUG_DRAW_*, what the step records in "debug_cmds" */
+	int broad_phase;  /* OPUS_BROAD_PHASE_* */
+	int narrow_phase; /* OPUS_NARROW_PHASE_* */
+	int solver_threads; /* more than 1 to solve contacts and joints in parallel colour batches, lowered if fewer threads start */
+	int narrow_phase_threads; /* more than 1 to run SAT/GJK and the clipping of the pairs in parallel, lowered if fewer threads start */
+	int use_simd_solver; /* solve the contacts OPUS_SOLVER_LANES at a time, see contact_solver.c */
 
 	opus_vec2 gravity;
 
@@ -83,6 +212,13 @@ struct opus_physics_world {
 	opus_real rest_factor; /* if relative velocity in normal is smaller than this, cancel resolution in normal direction */
 	opus_real accumulated_normal_impulse_damping;
 	opus_real accumulated_tangent_impulse_damping;
+	opus_real grid_cell_size; /* cell size of OPUS_BROAD_PHASE_GRID, 0 to use the average size of the non-static bodies */
+
+	/* soft contacts of OPUS_SOLVER_SOFT_STEP, springs pushing overlapping bodies apart */
+	opus_real contact_hertz; /* capped to a quarter of the sub-step rate */
+	opus_real contact_damping_ratio;
+	opus_real contact_push_max; /* fastest speed of the push */
+	opus_real soft_bias_rate_, soft_mass_scale_, soft_impulse_scale_;
 
 	int       enable_sleeping;
 	opus_real body_min_motion_bias;
@@ -95,7 +231,34 @@ struct opus_physics_world {
 	opus_joint      **joints;
 	opus_constraint **constraints;
 
-	opus_hashmap contacts;
+	opus_pair_cache contacts;      /* opus_contacts * keyed by packed body ids */
+	opus_pool       contacts_pool; /* of opus_contacts, its counters tell if a step allocates */
+	opus_sat_cache  sat_cache;     /* world vertices of the polygons for the narrow phase */
+
+	int        broad_phase_; /* broad phase the structures below are built for */
+	opus_sap  *sap;
+	opus_bvh  *bvh;
+	opus_grid *grid;
+
+	opus_solver             *solver;         /* created when "solver_threads" is more than 1 */
+	struct opus_thread_pool *narrow_pool_;   /* created when "narrow_phase_threads" is more than 1 */
+	opus_contact_solver     *contact_solver; /* flat copy of the contacts for the serial solver, see contact_solver.c */
+	opus_bvh                *query_tree_;    /* of all the bodies for the queries, see query.c */
+	int                      query_dirty_;   /* bodies moved or added since the tree was refreshed */
+
+	opus_contacts   **awake_contacts_; /* contacts the solvers go through, rebuilt every step */
+	opus_sleep_pair  *sleeping_pairs_; /* pairs the narrow phase skipped in the step, see sleeping.c */
+	opus_narrow_pair *narrow_pairs_;   /* candidate pairs from the broad phase, see "retrieve_collision_info_" */
+	int              *island_parent_;  /* union find over the bodies */
+	int              *island_sleepy_;  /* 1 if every body of the island (by root) can sleep */
+	int               woken_;          /* bodies woken up in the step */
+	size_t            body_id_;        /* last id given to a body of the world */
+
+	/* fixed step mode, see "opus_physics_world_advance" */
+	opus_real fixed_dt;
+	int       max_fixed_steps; /* real time beyond this many steps in one call is dropped */
+	opus_real alpha;           /* progress from the previous to the current pose, for rendering */
+	opus_real accumulator_;    /* real time not simulated yet */
 
 	opus_real  time_scale;
 	opus_real  start_time;
@@ -106,6 +269,9 @@ struct opus_physics_world {
 	opus_real *delta_history;
 	size_t     delta_history_max_size;
 	int        is_delta_fixed;
+
+	opus_physics_profile profile;    /* see OPUS_PHYSICS_PROFILE */
+	opus_debug_cmd      *debug_cmds; /* of the last step, see "debug_draw" */
 };
 
 struct opus_body {
@@ -128,6 +294,8 @@ struct opus_body {
 	opus_real rotation;
 	opus_real angular_velocity;
 
+	opus_transform transform; /* pose at the collision detection, see "opus_body_update_transform" */
+
 	opus_vec2 force;
 	opus_real torque;
 
@@ -142,6 +310,21 @@ struct opus_body {
 	int is_sleeping;
 	int sleep_counter;
 	int joint_count;
+	int proxy_id;     /* id in the broad phase structure of the world, -1 if not inserted */
+	int query_proxy_; /* leaf in "world->query_tree_", -1 if not inserted */
+	int sat_offset_;  /* start of the vertices in "world->sat_cache", -1 if not cached */
+
+	uint64_t solver_colors_; /* colours of the solver batches the body is in */
+
+	int        island_;       /* index of the body in the island building, see sleeping.c */
+	opus_body *island_next_;  /* ring of the bodies sleeping in the same island, NULL if awake */
+	int        solver_index_; /* index of the body in "world->contact_solver", set in the step */
+
+	opus_vec2 sweep_position_; /* pose of a bullet before the velocity integration */
+	opus_real sweep_rotation_;
+
+	opus_vec2 prev_position; /* pose before the last fixed step, see "opus_physics_world_advance" */
+	opus_real prev_rotation;
 };
 
 struct opus_shape {
@@ -262,11 +445,32 @@ void       opus_body_apply_force(opus_body *body, opus_vec2 force, opus_vec2 r);
 void       opus_body_clear_force(opus_body *body);
 void       opus_body_integrate_velocity(opus_body *body, opus_real dt);
 void       opus_body_integrate_forces(opus_body *body, opus_real dt);
+void       opus_body_update_transform(opus_body *body);
+void       opus_body_get_interpolated_transform(opus_body *body, opus_real alpha, opus_transform *transform);
 
 opus_physics_world *opus_physics_world_create(void);
 void                opus_physics_world_destroy(opus_physics_world *world);
 
 void opus_physics_world_step(opus_physics_world *world, opus_real dt);
+int  opus_physics_world_advance(opus_physics_world *world, opus_real real_dt);
+
+const char *opus_physics_phase_name(int phase);
+
+void opus_physics_world_debug_draw(opus_physics_world *world);
+void opus_debug_draw_line(opus_debug_cmd **cmds, opus_vec2 a, opus_vec2 b, opus_real width, uint32_t color);
+void opus_debug_draw_circle(opus_debug_cmd **cmds, opus_vec2 center, opus_real radius, uint32_t color);
+void opus_debug_draw_rect(opus_debug_cmd **cmds, opus_vec2 min, opus_vec2 max, opus_real width, uint32_t color);
+
+size_t opus_physics_world_snapshot_size(opus_physics_world *world);
+size_t opus_physics_world_snapshot(opus_physics_world *world, void *buffer, size_t size);
+int    opus_physics_world_restore(opus_physics_world *world, const void *buffer, size_t size);
+
+int    opus_physics_world_raycast(opus_physics_world *world, opus_ray *ray, opus_ray_hit *hit);
+size_t opus_physics_world_raycast_batch(opus_physics_world *world, opus_ray *rays, size_t n, opus_ray_hit *hits);
+void   opus_physics_world_query_aabb(opus_physics_world *world, opus_aabb *aabb, uint32_t bitmask, opus_query_cb callback, void *data);
+void   opus_physics_world_query_point(opus_physics_world *world, opus_vec2 point, uint32_t bitmask, opus_query_cb callback, void *data);
+void   opus_physics_world_query_shape(opus_physics_world *world, opus_shape *shape, opus_vec2 position, opus_real rotation,
+                                      uint32_t bitmask, opus_query_cb callback, void *data);
 
 opus_body       *opus_physics_world_add_polygon(opus_physics_world *world, opus_vec2 position, opus_vec2 *vertices, size_t n);
 opus_body       *opus_physics_world_add_n_polygon(opus_physics_world *world, opus_vec2 position, opus_real radius, int n);
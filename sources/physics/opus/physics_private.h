@@ -19,16 +19,60 @@ extern "C" {
 #endif /* __cplusplus */
 
 #include "physics/opus/physics.h"
+#include "math/math_inline.h"
+#include "utils/thread_pool.h"
 
 typedef struct opus_contact  opus_contact;
-typedef struct opus_contacts opus_contacts;
-typedef struct opus_bvh      opus_bvh;
-typedef struct opus_bvh_leaf opus_bvh_leaf;
+typedef struct opus_bvh_node opus_bvh_node;
+
+typedef struct opus_sap_proxy    opus_sap_proxy;
+typedef struct opus_sap_endpoint opus_sap_endpoint;
+
+typedef struct opus_grid_item  opus_grid_item;
+typedef struct opus_solver_item opus_solver_item;
+typedef struct opus_grid_range opus_grid_range;
+
+typedef struct opus_solver_body        opus_solver_body;
+typedef struct opus_contact_constraint opus_contact_constraint;
+typedef struct opus_contact_lanes      opus_contact_lanes;
 
 typedef struct opus_overlap_result opus_overlap_result;
 typedef struct opus_clip_result    opus_clip_result;
+typedef struct opus_gjk_simplex    opus_gjk_simplex;
+typedef struct opus_sweep          opus_sweep;
 
-typedef void (*opus_sap_cb)(opus_body *A, opus_body *B, opus_mat2d ta, opus_mat2d tb, void *data);
+#define OPUS_PAIR_KEY_EMPTY (~(uint64_t) 0)
+#define OPUS_SOLVER_MAX_COLORS (64) /* items which can not be coloured are solved serially after all the colours */
+#define OPUS_SOLVER_LANES (4)       /* contact points solved together by "world->use_simd_solver" */
+#define OPUS_MAX_CONTACTS (2)       /* points of a manifold, the same as "opus_clip_result.supports" */
+
+/**
+ * @brief feature id of a clipped point, the reference and the incident edge (index of their
+ * 		first vertex) and the vertex of the incident edge the point is clipped from (0 or 1).
+ * 		The point moves continuously while the features stay the same, clipped or not, so
+ * 		the same id in the next step is the same point even if it slid.
+ */
+#define opus_feature_id(_ref_idx, _inc_idx, _vertex) \
+	(((uint64_t) (_ref_idx) << 32) | ((uint64_t) (_inc_idx) << 1) | (uint64_t) (_vertex))
+#define OPUS_FEATURE_FLIPPED ((uint64_t) 1 << 63) /* the clipping had the bodies of the manifold the other way round */
+
+/**
+ * @brief iterate all the entries stored in the pair cache
+ */
+#define opus_pair_cache_foreach_start(_cache, _entry, _i)      \
+	do {                                                       \
+		for ((_i) = 0; (_i) < (_cache)->capacity; (_i)++) {    \
+			(_entry) = &(_cache)->entries[(_i)];               \
+			if ((_entry)->key == OPUS_PAIR_KEY_EMPTY) continue;
+#define opus_pair_cache_foreach_end() \
+	}                                 \
+	}                                 \
+	while (0)
+
+typedef void (*opus_sap_cb)(opus_body *A, opus_body *B, void *data);
+typedef void (*opus_sap_event_cb)(opus_body *A, opus_body *B, int is_begin, void *data);
+typedef int (*opus_bvh_query_cb)(opus_bvh *bvh, int leaf, void *data);
+typedef opus_real (*opus_bvh_ray_cb)(opus_bvh *bvh, int leaf, void *data);
 
 /**
  * @brief result pass to collision detection algorithm, like SAT or GJK
@@ -39,9 +83,9 @@ struct opus_overlap_result {
 	/* incident edge master */
 	opus_shape *B;
 
-	opus_mat2d transform_a, transform_b;
-	int        is_overlap;
-	opus_real  separation; /* penetration depth, positive value */
+	opus_transform transform_a, transform_b;
+	int            is_overlap;
+	opus_real      separation; /* penetration depth, positive value */
 
 	/**
 	 * @brief a vector points to B from A, you can push B in this direction
@@ -56,39 +100,233 @@ struct opus_overlap_result {
 struct opus_clip_result {
 	opus_shape *A, *B;
 
-	uint64_t  ref_idx, inc_idx;
+	uint64_t  ref_idx, inc_idx; /* first vertex of the reference and the incident edge */
 	uint64_t  n_support;
 	opus_vec2 supports[2][2];
+	uint64_t  ids[2]; /* feature id of each support, see "opus_feature_id", 0 for the one point of a circle */
 };
 
+/**
+ * @brief dynamic aabb tree, nodes live in a pool and are referenced by index
+ */
 struct opus_bvh {
-	int leaf_count;
+	opus_bvh_node *nodes;
+	int            capacity;
+	int            n_nodes;
+	int            free_list; /* free nodes are linked through "parent" */
+	int            root;
+	int            leaf_count;
 
-	opus_bvh_leaf *hierarchy;
-	opus_body     *bodies; /* TODO all the bodies stored in the tree are represented as an index */
+	opus_real margin;          /* fat aabbs of the leaves are enlarged by this on each side */
+	opus_real velocity_factor; /* and extended by "velocity * dt * velocity_factor" */
+	size_t    proxy_offset;    /* of the int in opus_body keeping the leaf index, "proxy_id" by default */
+
+	opus_pair_cache pairs; /* pairs of overlapping fat aabbs keyed by leaf index */
+
+	int *moved_; /* leaves inserted or reinserted since the last update */
+	int *stack_;
 };
 
-struct opus_bvh_leaf {
-	opus_aabb      aabb;    /* TODO: aabbs in tree node are fat aabb */
-	int            is_leaf; /* indicate whether this node is interior */
-	opus_bvh_leaf *parent;
-	int            height;
-	opus_bvh_leaf *left, *right;
+struct opus_bvh_node {
+	opus_aabb  aabb; /* fat aabb for leaves */
+	opus_body *body; /* body of the leaf */
+	int        parent;
+	int        left, right;
+	int        height; /* 0 for leaves, -1 for free nodes */
+	int        moved;
 };
 
-struct opus_contacts {
-	char id[32];
+struct opus_sap_endpoint {
+	opus_real value;
+	uint32_t  proxy;
+	uint32_t  is_max;
+};
 
-	opus_body     *A, *B;
-	opus_contact **contacts;
+struct opus_sap_proxy {
+	opus_body *body;
+	opus_aabb  aabb;
+	int        flags;
+};
+
+/**
+ * @brief incremental sweep and prune, endpoints are kept sorted across steps
+ */
+struct opus_sap {
+	opus_sap_proxy    *proxies;
+	uint32_t          *free_proxies;
+	opus_sap_endpoint *endpoints[2]; /* sorted endpoints on x and y axis */
+	opus_pair_cache    pairs;        /* overlapping pairs keyed by proxy ids */
+
+	opus_sap_event_cb on_event; /* called when two proxies begin or end overlapping */
+	void             *data;
+
+	size_t    n_new_;
+	uint32_t *active_;
+};
+
+struct opus_grid_item {
+	uint32_t body; /* index of the body */
+	int32_t  x, y; /* the cell */
+};
+
+struct opus_grid_range {
+	int32_t x0, y0, x1, y1; /* cells covered by the bound of a body */
+};
+
+/**
+ * @brief uniform hash grid, all the arrays are reused across steps
+ */
+struct opus_grid {
+	opus_real        cell_size; /* cell size used in the last step */
+	opus_grid_item  *items;     /* (body, cell) entries grouped by bucket */
+	uint32_t        *buckets;   /* start of each bucket in "items", one more for the end */
+	opus_grid_range *ranges;
+};
+
+enum {
+	OPUS_SOLVER_ITEM_CONTACTS   = 1,
+	OPUS_SOLVER_ITEM_JOINT      = 2,
+	OPUS_SOLVER_ITEM_CONSTRAINT = 3
+};
+
+struct opus_solver_item {
+	int   type;  /* OPUS_SOLVER_ITEM_* */
+	int   color;
+	void *item; /* opus_contacts, opus_joint or opus_constraint */
+};
+
+/**
+ * @brief contacts, joints and constraints grouped by colour, no body appears twice in
+ * 		a colour so each colour can be solved in parallel
+ */
+struct opus_solver {
+	opus_thread_pool *pool;
+	opus_solver_item *items;    /* sorted by colour */
+	opus_solver_item *scratch_; /* items before sorting */
+	size_t            colors[OPUS_SOLVER_MAX_COLORS + 2]; /* start of each colour in "items", the last one is the end */
+
+	/* arguments of the current batch */
+	opus_physics_world *world_;
+	opus_real           dt_;
+	size_t              offset_;
+	int                 pass_; /* of the soft step */
+};
+
+/**
+ * @brief what the contact solver needs of a body, static ones have no inverse mass here
+ */
+struct opus_solver_body {
+	opus_vec2 velocity;
+	opus_real angular_velocity;
+	opus_vec2 position;
+	opus_real rotation;
+	opus_real inv_mass, inv_inertia;
+	int       moves; /* 0 for static or sleeping bodies, they are not pushed by the position passes */
+};
 
+/**
+ * @brief a contact point of the step, with its bodies as indices of "opus_contact_solver.bodies"
+ */
+struct opus_contact_constraint {
+	int       a, b;
+	opus_vec2 ra, rb;
+	opus_vec2 normal, tangent;
+	opus_real mass_normal, mass_tangent;
+	opus_real normal_impulse, tangent_impulse;
 	opus_real friction;
-	opus_real restitution;
+	opus_vec2 restitution_bias;
+	opus_real velocity_bias; /* pushing the overlap apart, the same for all the velocity passes */
+	opus_real separation;    /* of OPUS_SOLVER_SOFT_STEP, see "opus_contact.separation_" */
+	opus_vec2 pa, pb;        /* moved by the position passes */
+
+	opus_contact *contact; /* where the results go at the end of the step */
+};
+
+enum {
+	OPUS_SOLVER_BODY_VELOCITY = 1,
+	OPUS_SOLVER_BODY_POSE     = 2
+};
+
+/**
+ * @brief OPUS_SOLVER_LANES contact points without a moving body in common, one in each
+ * 		lane, so that every line of the solver is done for all of them at once
+ */
+struct opus_contact_lanes {
+	int       a[OPUS_SOLVER_LANES], b[OPUS_SOLVER_LANES];
+	int       constraint[OPUS_SOLVER_LANES]; /* index in "opus_contact_solver.constraints", -1 if the lane is unused */
+	opus_real ra_x[OPUS_SOLVER_LANES], ra_y[OPUS_SOLVER_LANES], rb_x[OPUS_SOLVER_LANES], rb_y[OPUS_SOLVER_LANES];
+	opus_real normal_x[OPUS_SOLVER_LANES], normal_y[OPUS_SOLVER_LANES];
+	opus_real tangent_x[OPUS_SOLVER_LANES], tangent_y[OPUS_SOLVER_LANES];
+	opus_real mass_normal[OPUS_SOLVER_LANES], mass_tangent[OPUS_SOLVER_LANES];
+	opus_real normal_impulse[OPUS_SOLVER_LANES], tangent_impulse[OPUS_SOLVER_LANES];
+	opus_real friction[OPUS_SOLVER_LANES];
+	opus_real restitution_x[OPUS_SOLVER_LANES], restitution_y[OPUS_SOLVER_LANES];
+	opus_real velocity_bias[OPUS_SOLVER_LANES];
+	opus_real separation[OPUS_SOLVER_LANES];
+};
+
+/**
+ * @brief the awake contact points and all the bodies of the world (indexed like
+ * 		"world->bodies") packed for the serial solver, see contact_solver.c
+ */
+struct opus_contact_solver {
+	opus_solver_body        *bodies; /* one more than the world, an empty static body for the unused lanes */
+	opus_contact_constraint *constraints;
+	size_t                   n_bodies;
+
+	/* with "world->use_simd_solver", the constraints are sorted by colour and the first
+	 * "n_laned" of them are solved in "lanes", the rest one by one */
+	opus_contact_lanes *lanes;
+	size_t              n_laned;
+
+	uint64_t                *colors_; /* colours used by each body */
+	int                     *color_of_;
+	opus_contact_constraint *scratch_;
+};
+
+/**
+ * @brief search directions of the vertices of the last GJK simplex of a pair, the support
+ * 		points are found again with the new transforms to warm start the next step
+ */
+struct opus_gjk_simplex {
+	opus_vec2 dirs[3];
+	int       n;
+};
+
+/**
+ * @brief motion of a body over (a part of) the step, for the time of impact
+ */
+struct opus_sweep {
+	opus_vec2 p0, p1; /* position at the start and at the end */
+	opus_real r0, r1; /* rotation at the start and at the end, not wrapped */
+	opus_real radius; /* farthest point of the shape from the position */
+};
+
+/**
+ * @brief a pair of resting bodies in contact at the start of the step, tested if one of
+ * 		them is woken up later in the same step
+ */
+struct opus_sleep_pair {
+	opus_body *A, *B;
+};
+
+/**
+ * @brief a candidate pair of the broad phase and what the narrow phase found for it. The
+ * 		tests only read the bodies and write here, so the list can be tested in parallel,
+ * 		then it is merged into the contacts of the world in its order, see world.c
+ */
+struct opus_narrow_pair {
+	opus_body     *A, *B;
+	opus_contacts *contacts; /* of the pair in "world->contacts", NULL if the pair is new */
+
+	opus_gjk_simplex    simplex; /* warm start of GJK for a new pair, copied into its contacts */
+	opus_overlap_result overlap;
+	opus_clip_result    clip; /* only if "overlap.is_overlap" */
 };
 
 struct opus_contact {
 	int        is_active;
-	uint64_t   ref_idx, inc_idx;
+	uint64_t   id; /* feature id, matched against the clipping of the next step */
 	opus_body *A, *B;
 	opus_vec2  pa, pb;
 	opus_real  effective_mass_normal;
@@ -101,6 +339,23 @@ struct opus_contact {
 	opus_vec2  tangent;
 	opus_real  depth;
 	opus_vec2  restitution_bias;
+	opus_real  separation_; /* of the poses at the start of the step minus their part, for the soft step */
+};
+
+/**
+ * @brief the manifold of a pair of bodies, allocated from "world->contacts_pool", the points
+ * 		are stored inline
+ */
+struct opus_contacts {
+	uint64_t key;
+
+	opus_body       *A, *B;
+	opus_contact     contacts[OPUS_MAX_CONTACTS];
+	int              n_contacts;
+	opus_gjk_simplex simplex; /* of (A, B), for OPUS_NARROW_PHASE_GJK */
+
+	opus_real friction;
+	opus_real restitution;
 };
 
 
@@ -114,11 +369,11 @@ void   opus_recycle_physics_id(size_t id);
 
 void opus_shape_get_max_struct_size_(void);
 
-opus_vec2 opus_shape_polygon_get_support(opus_shape *shape, opus_mat2d transform, opus_vec2 dir, size_t *index);
+opus_vec2 opus_shape_polygon_get_support(opus_shape *shape, opus_transform *transform, opus_vec2 dir, size_t *index);
 opus_real opus_shape_polygon_get_inertia(opus_shape *shape, opus_real mass);
 void      opus_shape_polygon_update_bound(opus_shape *shape, opus_real rotation, opus_vec2 position);
 opus_real opus_shape_polygon_get_area(opus_shape *shape);
-opus_vec2 opus_shape_circle_get_support(opus_shape *shape, opus_mat2d transform, opus_vec2 dir, size_t *index);
+opus_vec2 opus_shape_circle_get_support(opus_shape *shape, opus_transform *transform, opus_vec2 dir, size_t *index);
 opus_real opus_shape_circle_get_inertia(opus_shape *shape, opus_real mass);
 void      opus_shape_circle_update_bound(opus_shape *shape, opus_real rotation, opus_vec2 position);
 opus_real opus_shape_circle_get_area(opus_shape *shape);
@@ -126,28 +381,79 @@ opus_real opus_shape_circle_get_area(opus_shape *shape);
 void opus_body_step_position(opus_body *body, opus_real dt);
 void opus_body_step_velocity(opus_body *body, opus_vec2 gravity, opus_real dt);
 
-opus_contacts *opus_contacts_create(opus_body *A, opus_body *B);
-void           opus_contacts_destroy(opus_contacts *contacts);
-opus_contact  *opus_contact_create(opus_body *A, opus_body *B, opus_vec2 pa, opus_vec2 pb, opus_vec2 normal, opus_real depth);
-void           opus_contact_destroy(opus_contact *contact);
-char          *opus_contacts_id(opus_body *A, opus_body *B);
-
-opus_bvh      *opus_bvh_create(void);
-void           opus_bvh_destroy(opus_bvh *bvh);
-void           opus_bvh_build_SAH(opus_bvh *bvh);
-void           opus_bvh_render(plutovg_t *pluto, opus_bvh *bvh);
-opus_bvh_leaf *opus_bvh_insert(opus_bvh *bvh, opus_body *body);
-void           opus_bvh_remove(opus_bvh *bvh, opus_bvh_leaf *leaf);
-opus_bvh_leaf *opus_bvh_find(opus_bvh *bvh, opus_body *body);
-opus_body    **opus_bvh_potentials(opus_bvh *bvh, opus_bvh_leaf *leaf, opus_body **result);
-void           opus_bvh_for_each_potential(opus_bvh_leaf *bvh_node, void (*callback)(opus_body *, opus_body *, void *), void *data);
-
-opus_overlap_result opus_SAT(opus_shape *A, opus_shape *B, opus_mat2d transform_a, opus_mat2d transform_b);
+opus_contacts *opus_contacts_create(opus_pool *pool, opus_body *A, opus_body *B);
+void           opus_contacts_destroy(opus_pool *pool, opus_contacts *contacts);
+opus_contact  *opus_contacts_add(opus_contacts *contacts, opus_body *A, opus_body *B, opus_vec2 pa, opus_vec2 pb, opus_vec2 normal, opus_real depth);
+void           opus_contacts_match(opus_contacts *contacts, opus_clip_result *cr, int match[OPUS_MAX_CONTACTS]);
+void           opus_contacts_remove_inactive(opus_contacts *contacts);
+uint64_t       opus_contacts_key(opus_body *A, opus_body *B);
+
+uint64_t         opus_pair_key(uint64_t a, uint64_t b);
+opus_pair_cache *opus_pair_cache_init(opus_pair_cache *cache, uint64_t capacity);
+void             opus_pair_cache_done(opus_pair_cache *cache);
+void             opus_pair_cache_clear(opus_pair_cache *cache);
+opus_pair_entry *opus_pair_cache_find(opus_pair_cache *cache, uint64_t key);
+opus_pair_entry *opus_pair_cache_insert(opus_pair_cache *cache, uint64_t key, void *value);
+void            *opus_pair_cache_remove(opus_pair_cache *cache, uint64_t key);
+void             opus_pair_cache_remove_at(opus_pair_cache *cache, uint64_t index);
+
+opus_bvh *opus_bvh_create(void);
+void      opus_bvh_destroy(opus_bvh *bvh);
+void      opus_bvh_build_SAH(opus_bvh *bvh);
+void      opus_bvh_debug_draw(opus_bvh *bvh, opus_debug_cmd **cmds, uint32_t color);
+int       opus_bvh_insert(opus_bvh *bvh, opus_body *body);
+void      opus_bvh_remove(opus_bvh *bvh, opus_body *body);
+void      opus_bvh_query(opus_bvh *bvh, opus_aabb *aabb, opus_bvh_query_cb callback, void *data);
+void      opus_bvh_update(opus_bvh *bvh, opus_real dt);
+void      opus_bvh_refresh(opus_bvh *bvh, opus_real dt);
+void      opus_bvh_ray_query(opus_bvh *bvh, opus_vec2 origin, opus_vec2 translation, opus_bvh_ray_cb callback, void *data);
+void      opus_bvh_for_each_pair(opus_bvh *bvh, opus_sap_cb callback, void *data);
+
+opus_grid *opus_grid_create(void);
+void       opus_grid_destroy(opus_grid *grid);
+void       opus_grid_for_each_pair(opus_grid *grid, opus_body **bodies, size_t n, opus_real cell_size, opus_sap_cb callback, void *data);
+
+opus_overlap_result opus_SAT(opus_shape *A, opus_shape *B, opus_transform *transform_a, opus_transform *transform_b);
+opus_overlap_result opus_SAT_cached(opus_sat_cache *cache, opus_body *A, opus_body *B, opus_transform *transform_a, opus_transform *transform_b);
+void                opus_sat_cache_init(opus_sat_cache *cache);
+void                opus_sat_cache_done(opus_sat_cache *cache);
+void                opus_sat_cache_update(opus_sat_cache *cache, opus_body **bodies, size_t n);
+opus_overlap_result opus_GJK(opus_shape *A, opus_shape *B, opus_transform *transform_a, opus_transform *transform_b, opus_gjk_simplex *simplex);
+opus_real           opus_GJK_distance(opus_shape *A, opus_shape *B, opus_transform *transform_a, opus_transform *transform_b, opus_gjk_simplex *simplex, opus_vec2 *pa, opus_vec2 *pb);
+void                opus_sweep_transform(opus_sweep *sweep, opus_real t, opus_transform *transform);
+opus_real           opus_sweep_radius(opus_shape *shape);
+opus_real           opus_sweep_core(opus_shape *shape);
+int                 opus_TOI(opus_shape *A, opus_sweep *sa, opus_shape *B, opus_sweep *sb, opus_real target, opus_real *t, opus_vec2 *normal, opus_vec2 *point);
+opus_overlap_result opus_collide_circle_circle(opus_circle *A, opus_circle *B, opus_transform *transform_a, opus_transform *transform_b);
+opus_overlap_result opus_collide_polygon_circle(opus_polygon *A, opus_circle *B, opus_transform *transform_a, opus_transform *transform_b);
 opus_clip_result    opus_VCLIP(opus_overlap_result overlap);
 void                opus_SAP(opus_body **bodies, size_t n, opus_sap_cb callback, void *data);
 
+opus_sap *opus_sap_create(opus_sap_event_cb on_event, void *data);
+void      opus_sap_destroy(opus_sap *sap);
+int       opus_sap_add(opus_sap *sap, opus_body *body);
+void      opus_sap_remove(opus_sap *sap, opus_body *body);
+void      opus_sap_update(opus_sap *sap);
+void      opus_sap_for_each_pair(opus_sap *sap, opus_sap_cb callback, void *data);
+
+opus_contact_solver *opus_contact_solver_create(void);
+void                 opus_contact_solver_destroy(opus_contact_solver *solver);
+void                 opus_contact_solver_gather(opus_contact_solver *solver, opus_physics_world *world, opus_real dt);
+void                 opus_contact_solver_scatter(opus_contact_solver *solver, opus_body **bodies, int parts);
+void                 opus_contact_solver_refresh(opus_contact_solver *solver, opus_body **bodies, int parts);
+void                 opus_contact_solver_store_impulses(opus_contact_solver *solver);
+void                 opus_contact_solver_solve_velocity(opus_contact_solver *solver);
+void                 opus_contact_solver_solve_position(opus_contact_solver *solver, opus_physics_world *world, opus_real dt);
+void                 opus_contact_solver_warm_start(opus_contact_solver *solver);
+void                 opus_contact_solver_solve_soft(opus_contact_solver *solver, opus_physics_world *world, int use_bias, opus_real h);
+void                 opus_contact_solver_integrate(opus_contact_solver *solver, opus_real h, opus_real damping);
+
 void opus_joint_destroy(opus_joint *joint);
+void opus_joint_get_bodies(opus_joint *joint, opus_body **A, opus_body **B);
+void opus_joint_get_impulse(opus_joint *joint, opus_vec2 *impulse);
+void opus_joint_set_impulse(opus_joint *joint, opus_vec2 impulse);
 void opus_constraint_destroy(opus_constraint *constraint);
+void opus_constraint_get_bodies(opus_constraint *constraint, opus_body **A, opus_body **B);
 
 opus_joint_distance *opus_joint_distance_create(opus_body *body, opus_vec2 offset, opus_vec2 anchor, opus_real min_distance, opus_real max_distance);
 void                 opus_joint_distance_destroy(opus_joint_distance *joint);
@@ -164,11 +470,11 @@ void                 opus_joint_revolute_destroy(opus_joint_revolute *joint);
 void                 opus_joint_revolute_prepare(opus_joint *joint, opus_real dt);
 void                 opus_joint_revolute_solve_velocity(opus_joint *joint, opus_real dt);
 
-void opus_sleeping_wake_up(opus_body *body);
-void opus_sleeping_fall_asleep(opus_physics_world *world, opus_body *body);
+int  opus_sleeping_wake_up(opus_body *body);
+int  opus_sleeping_is_awake(opus_body *body);
+int  opus_sleeping_is_pair_asleep(opus_body *A, opus_body *B);
+void opus_sleeping_wake_forced(opus_physics_world *world);
 void opus_sleeping_update(opus_physics_world *world, opus_real dt);
-void opus_sleeping_before_resolution(opus_physics_world *world);
-void opus_sleeping_after_collision(opus_physics_world *world, opus_real dt);
 
 #ifdef __cplusplus
 };
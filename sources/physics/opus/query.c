@@ -0,0 +1,346 @@
+/**
+ * @file query.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/3/30
+ *
+ * @example
+ *
+ * opus_ray     ray = {{0, 0}, {100, 0}, 0xffffffff};
+ * opus_ray_hit hit;
+ * if (opus_physics_world_raycast(world, &ray, &hit)) ... hit.body, hit.point
+ *
+ * @brief raycasts, aabb, point and shape queries against the bodies of the world. They go
+ * 		through a dynamic aabb tree of their own ("world->query_tree_"), which is refreshed
+ * 		at most once per step on the first query, so the broad phase in use and the
+ * 		results of the simulation are not affected by the queries. The tree is refreshed
+ * 		after a step and after "opus_physics_world_restore", bodies moved by hand
+ * 		between the steps are found at their new place after the next step.
+ * 		The tree keeps a traversal stack, so do not query the world from the callbacks.
+ *
+ * @development_log
+ *
+ */
+
+#include <stddef.h>
+#include "physics/opus/physics.h"
+#include "physics/opus/physics_private.h"
+#include "data_structure/array.h"
+
+struct query_ {
+	uint32_t      bitmask;
+	opus_query_cb callback;
+	void         *data;
+
+	opus_aabb      aabb;
+	opus_vec2      point;
+	opus_shape    *shape;
+	opus_transform transform;
+	opus_ray      *ray;
+	opus_ray_hit   hit;
+};
+
+/* insert the new bodies and refresh the leaves of the moved ones */
+static opus_bvh *sync_query_tree_(opus_physics_world *world)
+{
+	size_t     i, n_new;
+	opus_body *body;
+
+	if (!world->query_tree_) {
+		world->query_tree_               = opus_bvh_create();
+		world->query_tree_->proxy_offset = offsetof(opus_body, query_proxy_);
+	}
+	if (!world->query_dirty_) return world->query_tree_;
+
+	for (i = 0, n_new = 0; i < opus_arr_len(world->bodies); i++) {
+		body = world->bodies[i];
+		if (body->query_proxy_ < 0) {
+			opus_bvh_insert(world->query_tree_, body);
+			n_new++;
+		}
+	}
+	opus_bvh_refresh(world->query_tree_, 0);
+	if (n_new * 4 > (size_t) world->query_tree_->leaf_count) opus_bvh_build_SAH(world->query_tree_);
+
+	world->query_dirty_ = 0;
+	return world->query_tree_;
+}
+
+/* the tight bound is refreshed with the tree, the fat one of the leaf only narrows the search */
+static int query_aabb_cb_(opus_bvh *bvh, int leaf, void *data)
+{
+	struct query_ *query = data;
+	opus_body     *body  = bvh->nodes[leaf].body;
+
+	if (!(body->bitmask & query->bitmask)) return 1;
+	if (!opus_aabb_is_overlap(&body->shape->bound, &query->aabb)) return 1;
+	return query->callback(body, query->data);
+}
+
+/**
+ * @brief call "callback" for every body whose bound overlaps the aabb
+ * @param world
+ * @param aabb
+ * @param bitmask only the bodies sharing a bit with it are reported
+ * @param callback
+ * @param data
+ */
+void opus_physics_world_query_aabb(opus_physics_world *world, opus_aabb *aabb, uint32_t bitmask, opus_query_cb callback, void *data)
+{
+	struct query_ query;
+
+	query.bitmask  = bitmask;
+	query.callback = callback;
+	query.data     = data;
+	query.aabb     = *aabb;
+	opus_bvh_query(sync_query_tree_(world), &query.aabb, query_aabb_cb_, &query);
+}
+
+/* the point in the local space of the body */
+static opus_vec2 to_local_(opus_body *body, opus_vec2 point)
+{
+	opus_real c, s;
+	opus_vec2 d;
+
+	c = opus_cos(body->rotation);
+	s = opus_sin(body->rotation);
+	d = opus_vec2_sub(point, body->position);
+	return opus_vec2_(c * d.x + s * d.y, -s * d.x + c * d.y);
+}
+
+/* the direction in the world space of the body */
+static opus_vec2 to_world_dir_(opus_body *body, opus_vec2 dir)
+{
+	opus_real c, s;
+
+	c = opus_cos(body->rotation);
+	s = opus_sin(body->rotation);
+	return opus_vec2_(c * dir.x - s * dir.y, s * dir.x + c * dir.y);
+}
+
+static int contains_point_(opus_body *body, opus_vec2 point)
+{
+	opus_polygon *polygon;
+	opus_vec2     p, a, b;
+	opus_real     r;
+	size_t        i;
+
+	if (body->shape->type_ == OPUS_SHAPE_CIRCLE) {
+		r = ((opus_circle *) body->shape)->radius;
+		return opus_vec2_len2(opus_vec2_sub(point, body->position)) <= r * r;
+	}
+
+	/* the polygons are CCW with the y axis down (see "opus_make_ccw"), inside is on the right of every edge with y up */
+	polygon = (void *) body->shape;
+	p       = to_local_(body, point);
+	for (i = 0; i < polygon->n; i++) {
+		a = polygon->vertices[i];
+		b = polygon->vertices[(i + 1) % polygon->n];
+		if (opus_vec2_cross(opus_vec2_sub(b, a), opus_vec2_sub(p, a)) > 0) return 0;
+	}
+	return 1;
+}
+
+static int query_point_cb_(opus_bvh *bvh, int leaf, void *data)
+{
+	struct query_ *query = data;
+	opus_body     *body  = bvh->nodes[leaf].body;
+
+	if (!(body->bitmask & query->bitmask)) return 1;
+	if (!opus_aabb_contain(&body->shape->bound, query->point.x, query->point.y)) return 1;
+	if (!contains_point_(body, query->point)) return 1;
+	return query->callback(body, query->data);
+}
+
+/**
+ * @brief call "callback" for every body containing the point
+ * @param world
+ * @param point
+ * @param bitmask
+ * @param callback
+ * @param data
+ */
+void opus_physics_world_query_point(opus_physics_world *world, opus_vec2 point, uint32_t bitmask, opus_query_cb callback, void *data)
+{
+	struct query_ query;
+
+	query.bitmask  = bitmask;
+	query.callback = callback;
+	query.data     = data;
+	query.point    = point;
+	opus_aabb_init(&query.aabb, point.x, point.y, point.x, point.y);
+	opus_bvh_query(sync_query_tree_(world), &query.aabb, query_point_cb_, &query);
+}
+
+static int query_shape_cb_(opus_bvh *bvh, int leaf, void *data)
+{
+	struct query_      *query = data;
+	opus_body          *body  = bvh->nodes[leaf].body;
+	opus_transform      transform;
+	opus_gjk_simplex    simplex;
+	opus_overlap_result result;
+
+	if (!(body->bitmask & query->bitmask)) return 1;
+	if (!opus_aabb_is_overlap(&body->shape->bound, &query->aabb)) return 1;
+
+	simplex.n = 0;
+	/* the body may have moved since the last step, "body->transform" is not up to date */
+	opus_transform_set(&transform, body->rotation, body->position);
+	result = opus_GJK(query->shape, body->shape, &query->transform, &transform, &simplex);
+	if (!result.is_overlap) return 1;
+	return query->callback(body, query->data);
+}
+
+/**
+ * @brief call "callback" for every body overlapping the shape placed at the pose, tested
+ * 		with the GJK narrow phase
+ * @param world
+ * @param shape not in any body, its bound is overwritten
+ * @param position
+ * @param rotation
+ * @param bitmask
+ * @param callback
+ * @param data
+ */
+void opus_physics_world_query_shape(opus_physics_world *world, opus_shape *shape, opus_vec2 position, opus_real rotation,
+                                    uint32_t bitmask, opus_query_cb callback, void *data)
+{
+	struct query_ query;
+
+	shape->update_bound(shape, rotation, position);
+	query.bitmask  = bitmask;
+	query.callback = callback;
+	query.data     = data;
+	query.shape    = shape;
+	query.aabb     = shape->bound;
+	opus_transform_set(&query.transform, rotation, position);
+	opus_bvh_query(sync_query_tree_(world), &query.aabb, query_shape_cb_, &query);
+}
+
+/**
+ * @brief first crossing of the ray into the body, rays starting inside a body do not hit it
+ * @param body
+ * @param ray
+ * @param max_fraction
+ * @param hit filled if hit
+ * @return 1 if the body is hit before "max_fraction"
+ */
+static int ray_body_(opus_body *body, opus_ray *ray, opus_real max_fraction, opus_ray_hit *hit)
+{
+	opus_polygon *polygon;
+	opus_vec2     p, d, s, a, b, n, normal;
+	opus_real     r, qa, qb, qc, disc, t, lower, upper, num, den;
+	size_t        i;
+	int           index;
+
+	if (body->shape->type_ == OPUS_SHAPE_CIRCLE) {
+		r  = ((opus_circle *) body->shape)->radius;
+		s  = opus_vec2_sub(ray->origin, body->position);
+		qa = opus_vec2_dot(ray->translation, ray->translation);
+		qb = opus_vec2_dot(s, ray->translation);
+		qc = opus_vec2_dot(s, s) - r * r;
+		if (qc <= 0 || qa == 0 || qb >= 0) return 0;
+		disc = qb * qb - qa * qc;
+		if (disc < 0) return 0;
+		t = (-qb - opus_sqrt(disc)) / qa;
+		if (t > max_fraction) return 0;
+		hit->fraction = t;
+		hit->point    = opus_vec2_add(ray->origin, opus_vec2_scale(ray->translation, t));
+		hit->normal   = opus_vec2_norm(opus_vec2_sub(hit->point, body->position));
+		hit->body     = body;
+		return 1;
+	}
+
+	/* clip the ray against the half planes of the edges in the local space (Cyrus-Beck) */
+	polygon = (void *) body->shape;
+	p       = to_local_(body, ray->origin);
+	d       = opus_vec2_sub(to_local_(body, opus_vec2_add(ray->origin, ray->translation)), p);
+	lower   = 0;
+	upper   = max_fraction;
+	index   = -1;
+	for (i = 0; i < polygon->n; i++) {
+		a   = polygon->vertices[i];
+		b   = polygon->vertices[(i + 1) % polygon->n];
+		n   = opus_vec2_(a.y - b.y, b.x - a.x); /* outward, see "contains_point_" for the winding */
+		num = opus_vec2_dot(n, opus_vec2_sub(a, p));
+		den = opus_vec2_dot(n, d);
+		if (den == 0) {
+			if (num < 0) return 0; /* parallel and outside */
+		} else if (den < 0 && num < lower * den) {
+			lower = num / den; /* entering */
+			index = (int) i;
+		} else if (den > 0 && num < upper * den) {
+			upper = num / den; /* leaving */
+		}
+		if (upper < lower) return 0;
+	}
+	if (index < 0) return 0;
+
+	a             = polygon->vertices[index];
+	b             = polygon->vertices[(index + 1) % polygon->n];
+	normal        = opus_vec2_norm(opus_vec2_(a.y - b.y, b.x - a.x));
+	hit->fraction = lower;
+	hit->point    = opus_vec2_add(ray->origin, opus_vec2_scale(ray->translation, lower));
+	hit->normal   = to_world_dir_(body, normal);
+	hit->body     = body;
+	return 1;
+}
+
+/* keep the closest hit, the traversal skips everything behind it */
+static opus_real raycast_cb_(opus_bvh *bvh, int leaf, void *data)
+{
+	struct query_ *query = data;
+	opus_body     *body  = bvh->nodes[leaf].body;
+	opus_ray_hit   hit;
+
+	if (!(body->bitmask & query->ray->bitmask)) return query->hit.fraction;
+	if (!ray_body_(body, query->ray, query->hit.fraction, &hit)) return query->hit.fraction;
+	query->hit = hit;
+	return hit.fraction;
+}
+
+static int raycast_(opus_bvh *tree, opus_ray *ray, opus_ray_hit *hit)
+{
+	struct query_ query;
+
+	query.ray          = ray;
+	query.hit.body     = NULL;
+	query.hit.fraction = 1;
+	opus_bvh_ray_query(tree, ray->origin, ray->translation, raycast_cb_, &query);
+
+	*hit = query.hit;
+	return hit->body != NULL;
+}
+
+/**
+ * @brief the closest body crossed by the ray
+ * @param world
+ * @param ray
+ * @param hit "hit->body" is NULL if nothing is hit
+ * @return 1 if something is hit
+ */
+int opus_physics_world_raycast(opus_physics_world *world, opus_ray *ray, opus_ray_hit *hit)
+{
+	return raycast_(sync_query_tree_(world), ray, hit);
+}
+
+/**
+ * @brief cast many rays at once, the tree is refreshed once for all of them and the hits
+ * 		are packed in the order of the rays
+ * @param world
+ * @param rays
+ * @param n
+ * @param hits n records, "body" is NULL for the rays hitting nothing
+ * @return number of rays hitting something
+ */
+size_t opus_physics_world_raycast_batch(opus_physics_world *world, opus_ray *rays, size_t n, opus_ray_hit *hits)
+{
+	size_t    i, n_hits;
+	opus_bvh *tree;
+
+	tree = sync_query_tree_(world);
+	for (i = 0, n_hits = 0; i < n; i++) n_hits += raycast_(tree, &rays[i], &hits[i]);
+	return n_hits;
+}
@@ -0,0 +1,456 @@
+/**
+ * @file snapshot.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/3/29
+ *
+ * @example
+ *
+ * size_t size   = opus_physics_world_snapshot_size(world);
+ * void  *buffer = OPUS_MALLOC(size);
+ * opus_physics_world_snapshot(world, buffer, size);
+ * ... step ...
+ * opus_physics_world_restore(world, buffer, size); // back to the saved step
+ *
+ * @brief the state that changes from step to step saved into one contiguous buffer, for
+ * 		rollback and replays. That is the motion and sleeping state of the bodies, the
+ * 		contact manifolds with their accumulated impulses, the impulses of the joints and
+ * 		the clock of the world. Pointers are saved as indices of "world->bodies", so the
+ * 		world restored into must have the same bodies and joints in the same order, the
+ * 		shapes and settings are not saved.
+ * 		The contacts are put back into the same slots of the table, so stepping after a
+ * 		restore gives the same results bit for bit as the original run. The incremental
+ * 		broad phases (SAP_INCREMENTAL and BVH) keep history of their own which is not
+ * 		saved, they give correct but not bitwise identical results after a restore.
+ *
+ * @development_log
+ *
+ */
+
+#include "physics/opus/physics.h"
+#include "physics/opus/physics_private.h"
+#include "data_structure/array.h"
+
+#define SNAPSHOT_MAGIC (0x4f505553u) /* "OPUS" */
+#define SNAPSHOT_VERSION (2)
+
+typedef struct snapshot_header_   snapshot_header_;
+typedef struct snapshot_body_     snapshot_body_;
+typedef struct snapshot_contact_  snapshot_contact_;
+typedef struct snapshot_contacts_ snapshot_contacts_;
+
+struct snapshot_header_ {
+	uint32_t magic, version;
+	uint32_t real_size; /* sizeof(opus_real) */
+	uint32_t n_bodies, n_joints, n_contacts, n_deltas;
+	uint64_t capacity; /* of the contact table */
+
+	opus_real current_time, last_time, elapsed_time;
+	opus_real accumulator, alpha;
+};
+
+struct snapshot_body_ {
+	uint64_t  id; /* to check that the bodies are the same */
+	opus_vec2 position, velocity, force, prev_position;
+	opus_real rotation, angular_velocity, torque, prev_rotation;
+	opus_real motion, prev_motion;
+	opus_aabb bound;
+	int32_t   is_sleeping, sleep_counter;
+	int32_t   island_next; /* index of the next body in the sleeping ring, -1 if awake */
+};
+
+struct snapshot_contact_ {
+	int32_t   is_active;
+	int32_t   is_swapped; /* A of the point is B of the manifold */
+	uint64_t  id;
+	opus_vec2 pa, pb;
+	opus_real effective_mass_normal, effective_mass_tangent;
+	opus_real normal_impulse, tangent_impulse;
+	opus_vec2 ra, rb, normal, tangent;
+	opus_real depth;
+	opus_vec2 restitution_bias;
+};
+
+struct snapshot_contacts_ {
+	uint64_t          key;
+	uint64_t          slot; /* in the contact table */
+	uint32_t          a, b; /* indices of the bodies */
+	int32_t           n_contacts;
+	opus_gjk_simplex  simplex;
+	opus_real         friction, restitution;
+	snapshot_contact_ contacts[OPUS_MAX_CONTACTS];
+};
+
+/**
+ * @brief bytes needed to save the current state of the world, changes with the number of contacts
+ * @param world
+ * @return
+ */
+size_t opus_physics_world_snapshot_size(opus_physics_world *world)
+{
+	return sizeof(snapshot_header_) +
+	       sizeof(snapshot_body_) * opus_arr_len(world->bodies) +
+	       sizeof(opus_vec2) * opus_arr_len(world->joints) +
+	       sizeof(snapshot_contacts_) * world->contacts.count +
+	       sizeof(opus_real) * opus_arr_len(world->delta_history);
+}
+
+/**
+ * @brief save the state of the world
+ * @param world
+ * @param buffer
+ * @param size size of the buffer, see "opus_physics_world_snapshot_size"
+ * @return bytes written, 0 if the buffer is too small
+ */
+size_t opus_physics_world_snapshot(opus_physics_world *world, void *buffer, size_t size)
+{
+	size_t             i, j, n;
+	char              *p;
+	opus_body         *body;
+	opus_vec2          impulse;
+	opus_contact      *contact;
+	opus_contacts     *contacts;
+	snapshot_header_   header;
+	snapshot_body_     sb;
+	snapshot_contacts_ sc;
+	snapshot_contact_ *c;
+
+	n = opus_physics_world_snapshot_size(world);
+	OPUS_RETURN_IF(0, size < n);
+
+	/* the records are zeroed before filling, so that the padding bytes are the same in every
+	 * 		snapshot of the same state and buffers can be compared or hashed */
+	memset(&header, 0, sizeof(header));
+	header.magic        = SNAPSHOT_MAGIC;
+	header.version      = SNAPSHOT_VERSION;
+	header.real_size    = sizeof(opus_real);
+	header.n_bodies     = (uint32_t) opus_arr_len(world->bodies);
+	header.n_joints     = (uint32_t) opus_arr_len(world->joints);
+	header.n_contacts   = (uint32_t) world->contacts.count;
+	header.n_deltas     = (uint32_t) opus_arr_len(world->delta_history);
+	header.capacity     = world->contacts.capacity;
+	header.current_time = world->current_time;
+	header.last_time    = world->last_time;
+	header.elapsed_time = world->elapsed_time;
+	header.accumulator  = world->accumulator_;
+	header.alpha        = world->alpha;
+	p                   = buffer;
+	memcpy(p, &header, sizeof(header));
+	p += sizeof(header);
+
+	/* "island_" is only scratch between the steps, reuse it to map the bodies to indices */
+	for (i = 0; i < header.n_bodies; i++) world->bodies[i]->island_ = (int) i;
+
+	for (i = 0; i < header.n_bodies; i++) {
+		body = world->bodies[i];
+		memset(&sb, 0, sizeof(sb));
+		sb.id               = body->id;
+		sb.position         = body->position;
+		sb.velocity         = body->velocity;
+		sb.force            = body->force;
+		sb.prev_position    = body->prev_position;
+		sb.rotation         = body->rotation;
+		sb.angular_velocity = body->angular_velocity;
+		sb.torque           = body->torque;
+		sb.prev_rotation    = body->prev_rotation;
+		sb.motion           = body->motion;
+		sb.prev_motion      = body->prev_motion;
+		sb.bound            = body->shape->bound;
+		sb.is_sleeping      = body->is_sleeping;
+		sb.sleep_counter    = body->sleep_counter;
+		sb.island_next      = body->island_next_ ? body->island_next_->island_ : -1;
+		memcpy(p, &sb, sizeof(sb));
+		p += sizeof(sb);
+	}
+
+	for (i = 0; i < header.n_joints; i++) {
+		opus_joint_get_impulse(world->joints[i], &impulse);
+		memcpy(p, &impulse, sizeof(impulse));
+		p += sizeof(impulse);
+	}
+
+	for (i = 0; i < world->contacts.capacity; i++) {
+		if (world->contacts.entries[i].key == OPUS_PAIR_KEY_EMPTY) continue;
+		contacts = world->contacts.entries[i].value;
+
+		memset(&sc, 0, sizeof(sc));
+		sc.key         = contacts->key;
+		sc.slot        = i;
+		sc.a           = (uint32_t) contacts->A->island_;
+		sc.b           = (uint32_t) contacts->B->island_;
+		sc.n_contacts  = contacts->n_contacts;
+		sc.simplex     = contacts->simplex;
+		sc.friction    = contacts->friction;
+		sc.restitution = contacts->restitution;
+		for (j = 0; j < (size_t) contacts->n_contacts; j++) {
+			contact                   = &contacts->contacts[j];
+			c                         = &sc.contacts[j];
+			c->is_active              = contact->is_active;
+			c->is_swapped             = contact->A != contacts->A;
+			c->id                     = contact->id;
+			c->pa                     = contact->pa;
+			c->pb                     = contact->pb;
+			c->effective_mass_normal  = contact->effective_mass_normal;
+			c->effective_mass_tangent = contact->effective_mass_tangent;
+			c->normal_impulse         = contact->normal_impulse;
+			c->tangent_impulse        = contact->tangent_impulse;
+			c->ra                     = contact->ra;
+			c->rb                     = contact->rb;
+			c->normal                 = contact->normal;
+			c->tangent                = contact->tangent;
+			c->depth                  = contact->depth;
+			c->restitution_bias       = contact->restitution_bias;
+		}
+		memcpy(p, &sc, sizeof(sc));
+		p += sizeof(sc);
+	}
+
+	memcpy(p, world->delta_history, sizeof(opus_real) * header.n_deltas);
+
+	return n;
+}
+
+static int compare_body_id_(const void *a, const void *b)
+{
+	size_t ia = (*(opus_body **) a)->id;
+	size_t ib = (*(opus_body **) b)->id;
+	return ia < ib ? -1 : ia > ib;
+}
+
+static opus_body *find_body_(opus_body **bodies, size_t n, uint64_t id)
+{
+	size_t lo, hi, mid;
+
+	lo = 0, hi = n;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (bodies[mid]->id < id) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo < n && bodies[lo]->id == id ? bodies[lo] : NULL;
+}
+
+/**
+ * @brief put "world->bodies" in the saved order, which is part of the state since the broad
+ * 		phase sorts the array in place every step and visits the pairs in that order
+ * @param world
+ * @param records the saved bodies
+ * @param n
+ * @return 0 if a saved body is not in the world
+ */
+static int restore_body_order_(opus_physics_world *world, const char *records, size_t n)
+{
+	size_t         i;
+	opus_body     *body, *t;
+	snapshot_body_ sb;
+
+	/* nothing to do if nothing was sorted since the snapshot */
+	for (i = 0; i < n; i++) {
+		memcpy(&sb, records + sizeof(sb) * i, sizeof(sb));
+		if (sb.id != world->bodies[i]->id) break;
+	}
+	if (i == n) return 1;
+
+	/* find the bodies by id, "island_" is only scratch between the steps and holds the target index */
+	qsort(world->bodies, n, sizeof(opus_body *), compare_body_id_);
+	for (i = 0; i < n; i++) world->bodies[i]->island_ = -1;
+	for (i = 0; i < n; i++) {
+		memcpy(&sb, records + sizeof(sb) * i, sizeof(sb));
+		body = find_body_(world->bodies, n, sb.id);
+		if (!body || body->island_ >= 0) return 0;
+		body->island_ = (int) i;
+	}
+
+	/* ids are unique so that is a permutation, apply it cycle by cycle */
+	for (i = 0; i < n; i++) {
+		while (world->bodies[i]->island_ != (int) i) {
+			body                         = world->bodies[i];
+			t                            = world->bodies[body->island_];
+			world->bodies[body->island_] = body;
+			world->bodies[i]             = t;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief check that every record of the buffer can be restored without going out of range:
+ * 		indices of bodies, slots of the contact table and sizes of the manifolds
+ * @param header already checked against the world and the size of the buffer
+ * @param records the saved bodies, followed by the joints and the contacts
+ * @return 0 on the first record which does not fit
+ */
+static int validate_records_(snapshot_header_ *header, const char *records)
+{
+	size_t             i;
+	uint64_t           next_slot;
+	const char        *p;
+	snapshot_body_     sb, sa;
+	snapshot_contacts_ sc;
+
+	/* a table of the pair cache, a power of 2 with an empty slot left for the probing */
+	OPUS_RETURN_IF(0, header->capacity < 16 || (header->capacity & (header->capacity - 1)) != 0);
+	OPUS_RETURN_IF(0, header->capacity > (size_t) -1 / sizeof(opus_pair_entry));
+	OPUS_RETURN_IF(0, header->n_contacts >= header->capacity);
+
+	p = records;
+	for (i = 0; i < header->n_bodies; i++) {
+		memcpy(&sb, p, sizeof(sb));
+		p += sizeof(sb);
+		OPUS_RETURN_IF(0, sb.island_next < -1 || sb.island_next >= (int32_t) header->n_bodies);
+	}
+
+	p += sizeof(opus_vec2) * header->n_joints;
+	for (i = 0, next_slot = 0; i < header->n_contacts; i++) {
+		memcpy(&sc, p, sizeof(sc));
+		p += sizeof(sc);
+		OPUS_RETURN_IF(0, sc.a >= header->n_bodies || sc.b >= header->n_bodies || sc.a == sc.b);
+		OPUS_RETURN_IF(0, sc.n_contacts < 0 || sc.n_contacts > OPUS_MAX_CONTACTS);
+		/* saved in the order of the table, so each slot is used once */
+		OPUS_RETURN_IF(0, sc.slot < next_slot || sc.slot >= header->capacity);
+		next_slot = sc.slot + 1;
+
+		memcpy(&sa, records + sizeof(sa) * sc.a, sizeof(sa));
+		memcpy(&sb, records + sizeof(sb) * sc.b, sizeof(sb));
+		OPUS_RETURN_IF(0, sa.id > 0xffffffffu || sb.id > 0xffffffffu || sc.key != opus_pair_key(sa.id, sb.id));
+	}
+	return 1;
+}
+
+/**
+ * @brief put the world back to the state saved in the buffer, the memory of the contacts is
+ * 		reused so nothing is allocated unless the contact table was resized in between
+ * @param world must have the same bodies and joints as the one saved
+ * @param buffer
+ * @param size
+ * @return 1 if restored, 0 if the buffer does not match the world or a record is out of range,
+ * 		every record is checked first so the world is then left untouched but for the order
+ * 		of "world->bodies"
+ */
+int opus_physics_world_restore(opus_physics_world *world, const void *buffer, size_t size)
+{
+	size_t             i, j;
+	const char        *p;
+	opus_body         *body;
+	opus_vec2          impulse;
+	opus_contact      *contact;
+	opus_contacts     *contacts;
+	opus_pair_entry   *entry;
+	opus_pair_cache    table;
+	snapshot_header_   header;
+	snapshot_body_     sb;
+	snapshot_contacts_ sc;
+	snapshot_contact_ *c;
+
+	OPUS_RETURN_IF(0, size < sizeof(header));
+	memcpy(&header, buffer, sizeof(header));
+	OPUS_RETURN_IF(0, header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION);
+	OPUS_RETURN_IF(0, header.real_size != sizeof(opus_real));
+	OPUS_RETURN_IF(0, header.n_bodies != opus_arr_len(world->bodies) || header.n_joints != opus_arr_len(world->joints));
+	OPUS_RETURN_IF(0, size < sizeof(header) +
+	                                 sizeof(snapshot_body_) * header.n_bodies +
+	                                 sizeof(opus_vec2) * header.n_joints +
+	                                 sizeof(snapshot_contacts_) * header.n_contacts +
+	                                 sizeof(opus_real) * header.n_deltas);
+
+	OPUS_RETURN_IF(0, !validate_records_(&header, (const char *) buffer + sizeof(header)));
+	/* a table of another size is allocated before anything is changed */
+	if (world->contacts.capacity != header.capacity)
+		OPUS_RETURN_IF(0, !opus_pair_cache_init(&table, header.capacity));
+	if (!restore_body_order_(world, (const char *) buffer + sizeof(header), header.n_bodies)) {
+		if (world->contacts.capacity != header.capacity) opus_pair_cache_done(&table);
+		return 0;
+	}
+
+	p = (const char *) buffer + sizeof(header);
+	for (i = 0; i < header.n_bodies; i++) {
+		memcpy(&sb, p, sizeof(sb));
+		p += sizeof(sb);
+		body                   = world->bodies[i];
+		body->position         = sb.position;
+		body->velocity         = sb.velocity;
+		body->force            = sb.force;
+		body->prev_position    = sb.prev_position;
+		body->rotation         = sb.rotation;
+		body->angular_velocity = sb.angular_velocity;
+		body->torque           = sb.torque;
+		body->prev_rotation    = sb.prev_rotation;
+		body->motion           = sb.motion;
+		body->prev_motion      = sb.prev_motion;
+		body->shape->bound     = sb.bound;
+		body->is_sleeping      = sb.is_sleeping;
+		body->sleep_counter    = sb.sleep_counter;
+		body->island_next_     = sb.island_next < 0 ? NULL : world->bodies[sb.island_next];
+	}
+
+	for (i = 0; i < header.n_joints; i++) {
+		memcpy(&impulse, p, sizeof(impulse));
+		p += sizeof(impulse);
+		opus_joint_set_impulse(world->joints[i], impulse);
+	}
+
+	/* hand the manifolds back to the pool, they are acquired again right below */
+	opus_pair_cache_foreach_start(&world->contacts, entry, i)
+	{
+		opus_contacts_destroy(&world->contacts_pool, entry->value);
+	}
+	opus_pair_cache_foreach_end();
+	if (world->contacts.capacity == header.capacity) {
+		opus_pair_cache_clear(&world->contacts);
+	} else {
+		opus_pair_cache_done(&world->contacts);
+		world->contacts = table;
+	}
+
+	for (i = 0; i < header.n_contacts; i++) {
+		memcpy(&sc, p, sizeof(sc));
+		p += sizeof(sc);
+
+		contacts              = opus_contacts_create(&world->contacts_pool, world->bodies[sc.a], world->bodies[sc.b]);
+		contacts->n_contacts  = sc.n_contacts;
+		contacts->simplex     = sc.simplex;
+		contacts->friction    = sc.friction;
+		contacts->restitution = sc.restitution;
+		for (j = 0; j < (size_t) sc.n_contacts; j++) {
+			contact                         = &contacts->contacts[j];
+			c                               = &sc.contacts[j];
+			contact->is_active              = c->is_active;
+			contact->A                      = c->is_swapped ? contacts->B : contacts->A;
+			contact->B                      = c->is_swapped ? contacts->A : contacts->B;
+			contact->id                     = c->id;
+			contact->pa                     = c->pa;
+			contact->pb                     = c->pb;
+			contact->effective_mass_normal  = c->effective_mass_normal;
+			contact->effective_mass_tangent = c->effective_mass_tangent;
+			contact->normal_impulse         = c->normal_impulse;
+			contact->tangent_impulse        = c->tangent_impulse;
+			contact->ra                     = c->ra;
+			contact->rb                     = c->rb;
+			contact->normal                 = c->normal;
+			contact->tangent                = c->tangent;
+			contact->depth                  = c->depth;
+			contact->restitution_bias       = c->restitution_bias;
+		}
+
+		/* the same slot as before, so the table is iterated in the same order */
+		world->contacts.entries[sc.slot].key   = sc.key;
+		world->contacts.entries[sc.slot].value = contacts;
+		world->contacts.count++;
+	}
+
+	opus_arr_resize(world->delta_history, header.n_deltas);
+	memcpy(world->delta_history, p, sizeof(opus_real) * header.n_deltas);
+
+	world->current_time = header.current_time;
+	world->last_time    = header.last_time;
+	world->elapsed_time = header.elapsed_time;
+	world->accumulator_ = header.accumulator;
+	world->alpha        = header.alpha;
+
+	/* every body may have jumped, the queries refresh their tree before the next use */
+	world->query_dirty_ = 1;
+
+	return 1;
+}
@@ -17,6 +17,21 @@
 #include "data_structure/array.h"
 
 #define MAX_RECYCLED_ID_SIZE (128)
+#define SOLVER_MIN_PARALLEL_ITEMS (64) /* smaller colours are solved on the caller */
+#define NARROW_MIN_PARALLEL_PAIRS (64) /* fewer candidate pairs are tested on the caller */
+#define CCD_MAX_SUBSTEPS (8)           /* impacts of a bullet in one step */
+
+#ifdef OPUS_PHYSICS_PROFILE
+#include "external/sokol_time.h"
+#define PROFILE_BEGIN_(world, phase) ((world)->profile.begin_[phase] = stm_now())
+#define PROFILE_END_(world, phase) \
+	((world)->profile.phase_ns[phase] += stm_ns(stm_since((world)->profile.begin_[phase])))
+#define PROFILE_COUNT_(world, counter, n) ((world)->profile.counter += (n))
+#else
+#define PROFILE_BEGIN_(world, phase) ((void) 0)
+#define PROFILE_END_(world, phase) ((void) 0)
+#define PROFILE_COUNT_(world, counter, n) ((void) 0)
+#endif
 
 size_t id_start         = 1;
 size_t recycled_ids_len = 0;
@@ -44,36 +59,44 @@ void opus_recycle_physics_id(size_t id)
 	if (recycled_ids_len < MAX_RECYCLED_ID_SIZE) { recycled_ids[recycled_ids_len++] = id; }
 }
 
-uint64_t hash_(opus_hashmap *map, const void *x, uint64_t seed0, uint64_t seed1, void *data)
-{
-	char                *key;
-	const opus_contacts *contacts;
-	contacts = *(opus_contacts **) x;
-	key      = opus_contacts_id(contacts->A, contacts->B);
-	return opus_hashmap_murmur(key, strlen(key), 0, 0);
-}
-
-int compare_(opus_hashmap *map, const void *a, const void *b, void *data)
-{
-	const opus_contacts *ca = *(opus_contacts **) a;
-	const opus_contacts *cb = *(opus_contacts **) b;
-	return !(ca->A->id == cb->A->id && ca->B->id == cb->B->id);
-}
-
 opus_physics_world *opus_physics_world_create(void)
 {
 	opus_physics_world *world = OPUS_CALLOC(1, sizeof(opus_physics_world));
+
+#ifdef OPUS_PHYSICS_PROFILE
+	static int clock_ready = 0;
+	if (!clock_ready) {
+		stm_setup();
+		clock_ready = 1;
+	}
+#endif
+
 	if (world) {
-		opus_hashmap_init(&world->contacts, sizeof(opus_contacts *), 2, 0, 0, compare_, hash_, NULL);
+		opus_pair_cache_init(&world->contacts, 0);
+		opus_pool_init(&world->contacts_pool, sizeof(opus_contacts), 0);
+		opus_sat_cache_init(&world->sat_cache);
 		opus_arr_create(world->bodies, sizeof(opus_body *));
 		opus_arr_create(world->joints, sizeof(opus_joint *));
 		opus_arr_create(world->constraints, sizeof(opus_constraint *));
 		opus_arr_create(world->delta_history, sizeof(opus_real));
+		opus_arr_create(world->awake_contacts_, sizeof(opus_contacts *));
+		opus_arr_create(world->sleeping_pairs_, sizeof(opus_sleep_pair));
+		opus_arr_create(world->narrow_pairs_, sizeof(opus_narrow_pair));
+		opus_arr_create(world->island_parent_, sizeof(int));
+		opus_arr_create(world->island_sleepy_, sizeof(int));
+		opus_arr_create(world->debug_cmds, sizeof(opus_debug_cmd));
+
+		world->broad_phase          = OPUS_BROAD_PHASE_SAP;
+		world->narrow_phase         = OPUS_NARROW_PHASE_SAT;
+		world->solver_threads       = 1;
+		world->narrow_phase_threads = 1;
 
 		/* all magic XD */
 		world->velocity_iteration = 6;
 		world->velocity_bias      = 0.4;
 		world->position_iteration = 20;
+		world->solver_mode        = OPUS_SOLVER_ITERATIVE;
+		world->sub_steps          = 4;
 		world->position_bias      = 0.012;
 		world->constraint_bias    = 0.5;
 		world->position_slop      = 0.02;
@@ -81,9 +104,12 @@ opus_physics_world *opus_physics_world_create(void)
 		opus_vec2_set(&world->gravity, 0, 0);
 		world->accumulated_normal_impulse_damping  = 0.3;
 		world->accumulated_tangent_impulse_damping = 0.3;
+		world->contact_hertz                       = 30;
+		world->contact_damping_ratio               = 10;
+		world->contact_push_max                    = 3;
 		world->body_min_motion_bias                = 0.9;
 		world->body_wake_motion_threshold          = 0.03;
-		world->body_sleep_motion_threshold         = 0.7;
+		world->body_sleep_motion_threshold         = 0.1;
 		world->body_sleep_counter_threshold        = 80;
 		world->body_sleep_delay_counter            = 10;
 
@@ -93,23 +119,11 @@ opus_physics_world *opus_physics_world_create(void)
 		world->delta_max    = 2 * world->elapsed_time;
 
 		world->delta_history_max_size = 100;
-	}
-	return world;
-}
-
-static void destroy_contacts_(opus_physics_world *world)
-{
-	uint64_t i, j;
 
-	opus_contacts *contacts;
-	opus_hashmap_foreach_start(&world->contacts, contacts, i)
-	{
-		contacts = *(opus_contacts **) contacts;
-		for (j = 0; j < opus_arr_len(contacts->contacts); j++)
-			opus_contact_destroy(contacts->contacts[j]);
-		opus_arr_destroy(contacts->contacts);
+		world->fixed_dt        = 1.0 / 60;
+		world->max_fixed_steps = 8;
 	}
-	opus_hashmap_foreach_end();
+	return world;
 }
 
 static void destroy_bodies_(opus_physics_world *world)
@@ -133,10 +147,26 @@ static void destroy_constraints_(opus_physics_world *world)
 		opus_constraint_destroy(world->constraints[i]);
 }
 
+static void solver_destroy_(opus_solver *solver)
+{
+	opus_thread_pool_destroy(solver->pool);
+	opus_arr_destroy(solver->scratch_);
+	opus_arr_destroy(solver->items);
+	OPUS_FREE(solver);
+}
+
 void opus_physics_world_destroy(opus_physics_world *world)
 {
-	destroy_contacts_(world);
-	opus_hashmap_done(&world->contacts);
+	if (world->sap) opus_sap_destroy(world->sap);
+	if (world->bvh) opus_bvh_destroy(world->bvh);
+	if (world->grid) opus_grid_destroy(world->grid);
+	if (world->query_tree_) opus_bvh_destroy(world->query_tree_);
+	if (world->solver) solver_destroy_(world->solver);
+	if (world->narrow_pool_) opus_thread_pool_destroy(world->narrow_pool_);
+	if (world->contact_solver) opus_contact_solver_destroy(world->contact_solver);
+	opus_pair_cache_done(&world->contacts);
+	opus_pool_done(&world->contacts_pool); /* all the contacts at once */
+	opus_sat_cache_done(&world->sat_cache);
 	destroy_joints_(world);
 	opus_arr_destroy(world->joints);
 	destroy_constraints_(world);
@@ -144,6 +174,12 @@ void opus_physics_world_destroy(opus_physics_world *world)
 	destroy_bodies_(world);
 	opus_arr_destroy(world->bodies);
 	opus_arr_destroy(world->delta_history);
+	opus_arr_destroy(world->awake_contacts_);
+	opus_arr_destroy(world->sleeping_pairs_);
+	opus_arr_destroy(world->narrow_pairs_);
+	opus_arr_destroy(world->island_parent_);
+	opus_arr_destroy(world->island_sleepy_);
+	opus_arr_destroy(world->debug_cmds);
 	OPUS_FREE(world);
 }
 
@@ -214,90 +250,168 @@ static void prepare_resolution_(opus_physics_world *world, opus_contacts *contac
 	contact->restitution_bias = bias;
 }
 
-static void check_potential_collision_pair_(opus_body *A, opus_body *B, opus_mat2d ta, opus_mat2d tb, void *data)
+/* what the broad phase knows of a pair, the contacts are looked up while nothing inserts */
+static void init_narrow_pair_(opus_physics_world *world, opus_narrow_pair *pair, opus_body *A, opus_body *B)
 {
-	size_t i, j;
+	opus_pair_entry *entry;
 
-	opus_body *T;
-	opus_overlap_result or ;
-	opus_clip_result    cr;
-	opus_contact       *contact;
-	opus_contacts      *contacts, key, *key_ptr;
-	opus_physics_world *world;
+	pair->A        = A;
+	pair->B        = B;
+	pair->contacts = NULL;
 
-	opus_vec2 pa, pb, impulse;
+	entry = opus_pair_cache_find(&world->contacts, opus_contacts_key(A, B));
+	if (entry) pair->contacts = entry->value;
+	else memset(&pair->simplex, 0, sizeof(pair->simplex));
+}
+
+/**
+ * @brief SAT or GJK and the clipping of a pair. It only reads the bodies, the SAT cache
+ * 		and writes the pair (and the simplex of its contacts), so the pairs can be tested
+ * 		on any thread in any order.
+ */
+static void test_narrow_pair_(opus_physics_world *world, opus_narrow_pair *pair)
+{
+	opus_body        *A, *B;
+	opus_gjk_simplex *simplex;
+
+	A       = pair->A;
+	B       = pair->B;
+	simplex = pair->contacts ? &pair->contacts->simplex : &pair->simplex;
+
+	/* the contacts keep the body of the smaller id as A, test in that order every step */
+	if (world->narrow_phase == OPUS_NARROW_PHASE_GJK) {
+		/* the warm start simplex is kept in the order of the contacts */
+		if (A->id < B->id) pair->overlap = opus_GJK(A->shape, B->shape, &A->transform, &B->transform, simplex);
+		else pair->overlap = opus_GJK(B->shape, A->shape, &B->transform, &A->transform, simplex);
+	} else {
+		/* the same order every step, the reference edge prefers A of the call */
+		if (A->id < B->id) pair->overlap = opus_SAT_cached(&world->sat_cache, A, B, &A->transform, &B->transform);
+		else pair->overlap = opus_SAT_cached(&world->sat_cache, B, A, &B->transform, &A->transform);
+	}
+
+	if (pair->overlap.is_overlap) pair->clip = opus_VCLIP(pair->overlap);
+}
+
+static void test_narrow_pairs_task_(void *data, size_t begin, size_t end, int worker)
+{
+	size_t              i;
+	opus_physics_world *world = data;
 
-	world = data;
+	(void) worker;
+	for (i = begin; i < end; i++) test_narrow_pair_(world, &world->narrow_pairs_[i]);
+}
+
+/**
+ * @brief put the result of a pair into the contacts of the world: create them for a new
+ * 		pair, wake up the island it touches, match the points with the last step and warm
+ * 		start them. Serial, the pairs are merged in the order of the broad phase.
+ */
+static void merge_narrow_pair_(opus_physics_world *world, opus_narrow_pair *pair)
+{
+	size_t i;
+	int    match[OPUS_MAX_CONTACTS];
 
-	key_ptr = &key;
+	opus_body *A, *B, *T;
+	opus_overlap_result *or ;
+	opus_clip_result    *cr;
+	opus_contact        *contact;
+	opus_contacts       *contacts;
 
-	/* check overlapping */
-	or = opus_SAT(A->shape, B->shape, ta, tb);
+	opus_vec2 pa, pb, impulse;
 
-	/* check if the contacts exists */
-	key.A    = A->id < B->id ? A : B;
-	key.B    = A->id > B->id ? A : B;
-	contacts = opus_hashmap_retrieve(&world->contacts, &key_ptr);
+	A = pair->A;
+	B = pair->B;
 
+	PROFILE_COUNT_(world, narrow_tests, 1);
+	contacts = pair->contacts;
 	if (!contacts) {
-		contacts = opus_contacts_create(A, B);
-		opus_hashmap_insert(&world->contacts, &contacts);
-	} else {
-		contacts = *(opus_contacts **) contacts; /* resolve the pointer to get element */
+		contacts = opus_contacts_create(&world->contacts_pool, A, B);
+		opus_pair_cache_insert(&world->contacts, contacts->key, contacts);
+		contacts->simplex = pair->simplex;
 	}
 
-	if (or.is_overlap) {
-		cr = opus_VCLIP(or);
+	or = &pair->overlap;
+	cr = &pair->clip;
+	if (!or->is_overlap) return;
 
-		if (or.A == B->shape) {
-			T = A;
-			A = B;
-			B = T;
-		}
+	/* touched by an awake body, wake up the whole island before the warm start */
+	if (world->enable_sleeping && (A->is_sleeping || B->is_sleeping))
+		world->woken_ += opus_sleeping_wake_up(A->is_sleeping ? A : B);
 
-		/* FIXME */
-		if (world->draw_contacts) {
-			extern plutovg_t *pl;
-			for (i = 0; i < cr.n_support; i++) {
-				plutovg_set_source_rgba(pl, COLOR_RED, 1);
-				plutovg_circle(pl, cr.supports[i][0].x, cr.supports[i][0].y, 1);
-				plutovg_fill(pl);
-			}
+	if (or->A == B->shape) {
+		T = A;
+		A = B;
+		B = T;
+	}
+	/* the ids are of (or.A, or.B), the same edges the other way round are other features */
+	if (A != contacts->A)
+		for (i = 0; i < cr->n_support; i++) cr->ids[i] |= OPUS_FEATURE_FLIPPED;
+
+	/* time coherence, the points made by the same features as in the last step keep their impulses */
+	opus_contacts_match(contacts, cr, match);
+
+	for (i = 0; i < cr->n_support; i++) {
+		pa = cr->supports[i][0];
+		pb = cr->supports[i][1];
+
+		if (match[i] >= 0) {
+			/* the point may have slid along its features, only the impulses are kept */
+			contact          = &contacts->contacts[match[i]];
+			contact->pa      = pa;
+			contact->pb      = pb;
+			contact->normal  = or->normal;
+			contact->tangent = opus_vec2_perp(or->normal);
+			contact->depth   = or->separation;
+			prepare_resolution_(world, contacts, contact);
+			PROFILE_COUNT_(world, warm_starts, 1);
+			/* the soft step warm starts every sub-step with the whole impulses */
+			if (world->solver_mode == OPUS_SOLVER_SOFT_STEP) continue;
+
+			/* warm start */
+			contact->normal_impulse *= world->accumulated_normal_impulse_damping;
+			contact->tangent_impulse *= world->accumulated_tangent_impulse_damping;
+			impulse.x = contact->normal.x * contact->normal_impulse + contact->tangent.x * contact->tangent_impulse;
+			impulse.y = contact->normal.y * contact->normal_impulse + contact->tangent.y * contact->tangent_impulse;
+			opus_body_apply_impulse(A, opus_vec2_neg(impulse), contact->ra);
+			opus_body_apply_impulse(B, (impulse), contact->rb);
+			continue;
 		}
 
-		for (i = 0; i < cr.n_support; i++) {
-			pa = cr.supports[i][0];
-			pb = cr.supports[i][1];
-
-			/* ? don't know how to achieve time coherence, this is a naive solution */
-			for (j = 0; j < opus_arr_len(contacts->contacts); j++) {
-				contact = contacts->contacts[j];
-				if (opus_vec2_equal_(contact->pa, pa, 0.01) && opus_vec2_equal_(contact->pb, pb, 0.01)) {
-					contact->normal_impulse *= world->accumulated_normal_impulse_damping;
-					contact->tangent_impulse *= world->accumulated_tangent_impulse_damping;
-					prepare_resolution_(world, contacts, contact);
-
-					/* warm start */
-					impulse.x = contact->normal.x * contact->normal_impulse + contact->tangent.x * contact->tangent_impulse;
-					impulse.y = contact->normal.y * contact->normal_impulse + contact->tangent.y * contact->tangent_impulse;
-					opus_body_apply_impulse(A, opus_vec2_neg(impulse), contact->ra);
-					opus_body_apply_impulse(B, (impulse), contact->rb);
-					break;
-				}
-			}
-
-			/* create a new contact if no older contact */
-			if (j == opus_arr_len(contacts->contacts)) {
-				contact = opus_contact_create(A, B, pa, pb, or.normal, or.separation);
-				opus_arr_push(contacts->contacts, &contact);
-				contact->ref_idx = cr.ref_idx;
-				contact->inc_idx = cr.inc_idx;
-				prepare_resolution_(world, contacts, contact);
-			}
-		}
+		/* create a new contact if no older contact */
+		if (match[i] == -2) continue;
+		contact = opus_contacts_add(contacts, A, B, pa, pb, or->normal, or->separation);
+		if (!contact) continue;
+		contact->id = cr->ids[i];
+		prepare_resolution_(world, contacts, contact);
+		PROFILE_COUNT_(world, new_contacts, 1);
 	}
 }
 
+/* the broad phase callback, only lists the pair, see "retrieve_collision_info_" */
+static void collect_narrow_pair_(opus_body *A, opus_body *B, void *data)
+{
+	opus_physics_world *world = data;
+	opus_narrow_pair    pair;
+
+	PROFILE_COUNT_(world, candidate_pairs, 1);
+	init_narrow_pair_(world, &pair, A, B);
+	opus_arr_push(world->narrow_pairs_, &pair);
+}
+
+/* the whole narrow phase of one pair at once, for the pairs found after the merge */
+static void check_potential_collision_pair_(opus_body *A, opus_body *B, void *data)
+{
+	opus_physics_world *world = data;
+	opus_narrow_pair    pair;
+
+	PROFILE_BEGIN_(world, OPUS_PHASE_NARROW);
+	PROFILE_COUNT_(world, candidate_pairs, 1);
+	init_narrow_pair_(world, &pair, A, B);
+	test_narrow_pair_(world, &pair);
+	merge_narrow_pair_(world, &pair);
+	PROFILE_END_(world, OPUS_PHASE_NARROW);
+}
+
 static void apply_normal_impulse_(opus_physics_world *world, opus_contacts *contacts, opus_contact *contact, opus_real dt)
 {
 	opus_body *A, *B;
@@ -354,8 +468,8 @@ static void apply_tangent_impulse_(opus_physics_world *world, opus_contacts *con
 	max_friction = contacts->friction * contact->normal_impulse;
 
 	old_tangent_impulse = contact->tangent_impulse;
-	//	if (dv_t > 0 && dv_t * dv_t < world->rest_factor)
-	//		contact->tangent_impulse = 0;
+	/*	if (dv_t > 0 && dv_t * dv_t < world->rest_factor)
+			contact->tangent_impulse = 0; */
 	contact->tangent_impulse = opus_clamp(old_tangent_impulse + lambda_t, -max_friction, max_friction);
 	lambda_t                 = contact->tangent_impulse - old_tangent_impulse;
 
@@ -364,108 +478,248 @@ static void apply_tangent_impulse_(opus_physics_world *world, opus_contacts *con
 	opus_body_apply_impulse(B, opus_vec2_neg(impulse), contact->rb);
 }
 
-static void solve_velocity_(opus_physics_world *world, opus_real dt)
+static void solve_contacts_velocity_(opus_physics_world *world, opus_contacts *contacts, opus_real dt)
 {
-	uint64_t i, j, k;
+	int           j;
+	opus_contact *contact;
 
-	opus_contacts   *contacts;
-	opus_contact    *contact;
+	/* for each contact point */
+	for (j = 0; j < contacts->n_contacts; j++) {
+		contact = &contacts->contacts[j];
+
+		if (!contact->is_active) continue;
+
+		/* solve */
+		apply_normal_impulse_(world, contacts, contact, dt);
+		apply_tangent_impulse_(world, contacts, contact, dt);
+	}
+}
+
+static void solve_contacts_position_(opus_physics_world *world, opus_contacts *contacts, opus_real dt)
+{
+	int j;
+
+	opus_contact *c;
+	opus_body    *A, *B;
+	opus_vec2     dp, p;
+	opus_real     bias, lambda;
+
+	for (j = 0; j < contacts->n_contacts; j++) {
+		c = &contacts->contacts[j];
+		A = c->A;
+		B = c->B;
+
+		if (!c->is_active) continue;
+
+		/* check if position constraint is solved already */
+		c->pa = opus_vec2_add(c->A->position, c->ra);
+		c->pb = opus_vec2_add(c->B->position, c->rb);
+		dp    = opus_vec2_to(c->pa, c->pb);
+		if (opus_vec2_dot(dp, c->normal) > 0) continue;
+
+		bias   = world->position_bias / dt * opus_max(opus_vec2_len(dp) - world->position_slop, 0.f);
+		lambda = c->effective_mass_normal * bias;
+		p      = opus_vec2_scale(c->normal, lambda);
+
+		if (A->type != OPUS_BODY_STATIC && !A->is_sleeping) {
+			A->position = opus_vec2_sub(A->position, opus_vec2_scale(p, A->inv_mass));
+			A->rotation -= A->inv_inertia * opus_vec2_cross(c->ra, p);
+		}
+		if (B->type != OPUS_BODY_STATIC && !B->is_sleeping) {
+			B->position = opus_vec2_add(B->position, opus_vec2_scale(p, B->inv_mass));
+			B->rotation += B->inv_inertia * opus_vec2_cross(c->rb, p);
+		}
+	}
+}
+
+static void solve_item_velocity_(opus_physics_world *world, opus_solver_item *item, opus_real dt)
+{
 	opus_joint      *joint;
 	opus_constraint *constraint;
 
-	for (k = 0; k < world->velocity_iteration; k++) {
-		/* solve velocity constraints for rigid bodies */
-		opus_hashmap_foreach_start(&world->contacts, contacts, i)
-		{
-			contacts = *(opus_contacts **) contacts;
+	switch (item->type) {
+		case OPUS_SOLVER_ITEM_CONTACTS:
+			solve_contacts_velocity_(world, item->item, dt);
+			break;
+		case OPUS_SOLVER_ITEM_JOINT:
+			joint = item->item;
+			if (joint->solve_velocity) joint->solve_velocity(joint, dt);
+			break;
+		case OPUS_SOLVER_ITEM_CONSTRAINT:
+			constraint = item->item;
+			if (constraint->solve_velocity) constraint->solve_velocity(constraint, dt);
+			break;
+	}
+}
+
+static void solve_item_position_(opus_physics_world *world, opus_solver_item *item, opus_real dt)
+{
+	opus_joint      *joint;
+	opus_constraint *constraint;
+
+	switch (item->type) {
+		case OPUS_SOLVER_ITEM_CONTACTS:
+			solve_contacts_position_(world, item->item, dt);
+			break;
+		case OPUS_SOLVER_ITEM_JOINT:
+			joint = item->item;
+			if (joint->solve_position) joint->solve_position(joint, dt);
+			break;
+		case OPUS_SOLVER_ITEM_CONSTRAINT:
+			constraint = item->item;
+			if (constraint->solve_position) constraint->solve_position(constraint, dt);
+			break;
+	}
+}
 
-			/* for each contact point */
-			for (j = 0; j < opus_arr_len(contacts->contacts); j++) {
-				contact = contacts->contacts[j];
+static void solve_velocity_task_(void *data, size_t begin, size_t end, int worker)
+{
+	opus_solver *solver = data;
+	size_t       i;
+	(void) worker;
+	for (i = solver->offset_ + begin; i < solver->offset_ + end; i++)
+		solve_item_velocity_(solver->world_, &solver->items[i], solver->dt_);
+}
 
-				if (!contact->is_active) continue;
+static void solve_position_task_(void *data, size_t begin, size_t end, int worker)
+{
+	opus_solver *solver = data;
+	size_t       i;
+	(void) worker;
+	for (i = solver->offset_ + begin; i < solver->offset_ + end; i++)
+		solve_item_position_(solver->world_, &solver->items[i], solver->dt_);
+}
 
-				/* solve */
-				apply_normal_impulse_(world, contacts, contact, dt);
-				apply_tangent_impulse_(world, contacts, contact, dt);
-			}
-		}
-		opus_hashmap_foreach_end();
+/**
+ * @brief solve all the colours one after another, the items of a colour are spread over
+ * 		the worker threads. The overflowed colour shares bodies, so it is solved on the caller.
+ */
+static void solve_colors_(opus_physics_world *world, opus_thread_pool_task_cb task, opus_real dt)
+{
+	opus_solver *solver = world->solver;
+	size_t       n;
+	int          c;
+
+	solver->world_ = world;
+	solver->dt_    = dt;
+	for (c = 0; c <= OPUS_SOLVER_MAX_COLORS; c++) {
+		n               = solver->colors[c + 1] - solver->colors[c];
+		solver->offset_ = solver->colors[c];
+		if (n == 0) continue;
+
+		if (c == OPUS_SOLVER_MAX_COLORS || n < SOLVER_MIN_PARALLEL_ITEMS) task(solver, 0, n, 0);
+		else opus_thread_pool_for(solver->pool, n, task, solver);
+	}
+}
+
+static int is_joint_asleep_(opus_physics_world *world, opus_joint *joint)
+{
+	opus_body *A, *B;
+	if (!world->enable_sleeping) return 0;
+	opus_joint_get_bodies(joint, &A, &B);
+	return opus_sleeping_is_pair_asleep(A, B);
+}
+
+static int is_constraint_asleep_(opus_physics_world *world, opus_constraint *constraint)
+{
+	opus_body *A, *B;
+	if (!world->enable_sleeping) return 0;
+	opus_constraint_get_bodies(constraint, &A, &B);
+	return opus_sleeping_is_pair_asleep(A, B);
+}
+
+/* joints and constraints work on "opus_body", the contact solver is copied back for them */
+static int has_joints_(opus_physics_world *world)
+{
+	return opus_arr_len(world->joints) || opus_arr_len(world->constraints);
+}
+
+static void solve_velocity_(opus_physics_world *world, opus_real dt)
+{
+	uint64_t i;
+	int      k;
+
+	opus_joint          *joint;
+	opus_constraint     *constraint;
+	opus_contact_solver *cs;
+
+	if (world->solver) {
+		for (k = 0; k < world->velocity_iteration; k++) solve_colors_(world, solve_velocity_task_, dt);
+		return;
+	}
+
+	/* the contacts of the step are packed once, the results go back at the end of "solve_position_" */
+	if (!world->contact_solver) world->contact_solver = opus_contact_solver_create();
+	cs = world->contact_solver;
+	opus_contact_solver_gather(cs, world, dt);
+
+	for (k = 0; k < world->velocity_iteration; k++) {
+		/* solve velocity constraints for rigid bodies */
+		opus_contact_solver_solve_velocity(cs);
+		if (!has_joints_(world)) continue;
+
+		opus_contact_solver_scatter(cs, world->bodies, OPUS_SOLVER_BODY_VELOCITY);
 
 		/* solve velocity constraints for joints */
 		for (i = 0; i < opus_arr_len(world->joints); i++) {
 			joint = world->joints[i];
-			if (joint->solve_velocity) joint->solve_velocity(joint, dt);
+			if (joint->solve_velocity && !is_joint_asleep_(world, joint)) joint->solve_velocity(joint, dt);
 		}
 
 		/* solve velocity for constraints */
 		for (i = 0; i < opus_arr_len(world->constraints); i++) {
 			constraint = world->constraints[i];
-			if (constraint->solve_velocity) constraint->solve_velocity(constraint, dt);
+			if (constraint->solve_velocity && !is_constraint_asleep_(world, constraint)) constraint->solve_velocity(constraint, dt);
 		}
+
+		opus_contact_solver_refresh(cs, world->bodies, OPUS_SOLVER_BODY_VELOCITY);
 	}
+
+	opus_contact_solver_scatter(cs, world->bodies, OPUS_SOLVER_BODY_VELOCITY);
 }
 
 static void solve_position_(opus_physics_world *world, opus_real dt)
 {
-	uint64_t i, j, k;
+	uint64_t i;
+	int      k;
 
-	opus_contact *c;
-	opus_body    *A, *B;
-	opus_vec2     dp, p;
-	opus_real     bias, lambda;
+	opus_joint          *joint;
+	opus_constraint     *constraint;
+	opus_contact_solver *cs;
 
-	opus_contacts   *contacts;
-	opus_joint      *joint;
-	opus_constraint *constraint;
+	if (world->solver) {
+		for (k = 0; k < world->position_iteration; k++) solve_colors_(world, solve_position_task_, dt);
+		return;
+	}
+
+	/* the bodies were integrated on "opus_body" */
+	cs = world->contact_solver;
+	opus_contact_solver_refresh(cs, world->bodies, OPUS_SOLVER_BODY_POSE);
 
 	for (k = 0; k < world->position_iteration; k++) {
 		/* solve position constraints for rigid bodies */
-		opus_hashmap_foreach_start(&world->contacts, contacts, i)
-		{
-			contacts = *(opus_contacts **) contacts;
-
-			for (j = 0; j < opus_arr_len(contacts->contacts); j++) {
-				c = contacts->contacts[j];
-				A = c->A;
-				B = c->B;
-
-				if (!c->is_active) continue;
-
-				/* check if position constraint is solved already */
-				c->pa = opus_vec2_add(c->A->position, c->ra);
-				c->pb = opus_vec2_add(c->B->position, c->rb);
-				dp    = opus_vec2_to(c->pa, c->pb);
-				if (opus_vec2_dot(dp, c->normal) > 0) continue;
-
-				bias   = world->position_bias / dt * opus_max(opus_vec2_len(dp) - world->position_slop, 0.f);
-				lambda = c->effective_mass_normal * bias;
-				p      = opus_vec2_scale(c->normal, lambda);
-
-				if (A->type != OPUS_BODY_STATIC && !A->is_sleeping) {
-					A->position = opus_vec2_sub(A->position, opus_vec2_scale(p, A->inv_mass));
-					A->rotation -= A->inv_inertia * opus_vec2_cross(c->ra, p);
-				}
-				if (B->type != OPUS_BODY_STATIC && !B->is_sleeping) {
-					B->position = opus_vec2_add(B->position, opus_vec2_scale(p, B->inv_mass));
-					B->rotation += B->inv_inertia * opus_vec2_cross(c->rb, p);
-				}
-			}
-		}
-		opus_hashmap_foreach_end();
+		opus_contact_solver_solve_position(cs, world, dt);
+		if (!has_joints_(world)) continue;
+
+		opus_contact_solver_scatter(cs, world->bodies, OPUS_SOLVER_BODY_POSE);
 
 		/* solve position constraints for joints */
 		for (i = 0; i < opus_arr_len(world->joints); i++) {
 			joint = world->joints[i];
-			if (joint->solve_position) joint->solve_position(joint, dt);
+			if (joint->solve_position && !is_joint_asleep_(world, joint)) joint->solve_position(joint, dt);
 		}
 
 		/* solve position for constraints */
 		for (i = 0; i < opus_arr_len(world->constraints); i++) {
 			constraint = world->constraints[i];
-			if (constraint->solve_position) constraint->solve_position(constraint, dt);
+			if (constraint->solve_position && !is_constraint_asleep_(world, constraint)) constraint->solve_position(constraint, dt);
 		}
+
+		opus_contact_solver_refresh(cs, world->bodies, OPUS_SOLVER_BODY_POSE);
 	}
+
+	opus_contact_solver_scatter(cs, world->bodies, OPUS_SOLVER_BODY_POSE);
+	opus_contact_solver_store_impulses(cs);
 }
 
 static void integrate_velocity_(opus_physics_world *world, opus_real dt)
@@ -482,49 +736,666 @@ static void clear_forces_(opus_physics_world *world)
 		opus_body_clear_force(world->bodies[i]);
 }
 
-static void inactivate_all_contacts_(opus_physics_world *world)
+/* passes over the contacts and joints of a sub-step of OPUS_SOLVER_SOFT_STEP */
+enum { SOFT_WARM_START_, SOFT_SOLVE_, SOFT_RELAX_ };
+
+/**
+ * @brief soft constants for sub-steps of "h", and the part of the separation of each point
+ * 		which does not change in the step. The separation is linear in the positions and
+ * 		(for small turns) in the rotations of the two bodies, so the sub-steps get it from
+ * 		a few products instead of transforming the points again.
+ */
+static void prepare_soft_contacts_(opus_physics_world *world, opus_real h)
 {
-	uint64_t i, j;
+	size_t i;
+	int    j;
 
 	opus_contacts *contacts;
-	opus_hashmap_foreach_start(&world->contacts, contacts, i)
+	opus_contact  *c;
+	opus_real      hertz, omega, a1, a2, a3;
+
+	/* stiffer than this is not stable */
+	hertz = opus_min(world->contact_hertz, 0.25 / h);
+	omega = 2 * OPUS_PI * hertz;
+	a1    = 2 * world->contact_damping_ratio + h * omega;
+	a2    = h * omega * a1;
+	a3    = 1 / (1 + a2);
+
+	world->soft_bias_rate_     = omega / a1;
+	world->soft_mass_scale_    = a2 * a3;
+	world->soft_impulse_scale_ = a3;
+
+	for (i = 0; i < opus_arr_len(world->awake_contacts_); i++) {
+		contacts = world->awake_contacts_[i];
+		for (j = 0; j < contacts->n_contacts; j++) {
+			c = &contacts->contacts[j];
+			if (!c->is_active) continue;
+			c->separation_ = opus_vec2_dot(opus_vec2_to(c->pa, c->pb), c->normal) -
+			                 opus_vec2_dot(opus_vec2_to(c->A->position, c->B->position), c->normal) -
+			                 c->B->rotation * opus_vec2_cross(c->rb, c->normal) +
+			                 c->A->rotation * opus_vec2_cross(c->ra, c->normal);
+		}
+	}
+}
+
+/* the impulses of the last sub-step, or of the last step for the first one */
+static void warm_start_contacts_(opus_contacts *contacts)
+{
+	int j;
+
+	opus_contact *c;
+	opus_vec2     impulse;
+
+	for (j = 0; j < contacts->n_contacts; j++) {
+		c = &contacts->contacts[j];
+		if (!c->is_active) continue;
+
+		/* the friction is applied to A along the tangent, see "apply_tangent_impulse_" */
+		impulse.x = c->normal.x * c->normal_impulse - c->tangent.x * c->tangent_impulse;
+		impulse.y = c->normal.y * c->normal_impulse - c->tangent.y * c->tangent_impulse;
+		opus_body_apply_impulse(c->A, opus_vec2_neg(impulse), c->ra);
+		opus_body_apply_impulse(c->B, impulse, c->rb);
+	}
+}
+
+/**
+ * @brief one pass of soft contacts: an overlap is a stiff damped spring instead of a
+ * 		velocity bias, so it is pushed out over a few sub-steps without gaining speed. The
+ * 		relaxing pass ("use_bias" 0) takes the velocity of the push away again.
+ */
+static void solve_contacts_soft_(opus_physics_world *world, opus_contacts *contacts, int use_bias, opus_real h)
+{
+	int j;
+
+	opus_contact *c;
+	opus_body    *A, *B;
+	opus_vec2     va, vb, dv, impulse;
+	opus_real     s, bias, mass_scale, impulse_scale, dv_n, lambda, old_impulse;
+
+	for (j = 0; j < contacts->n_contacts; j++) {
+		c = &contacts->contacts[j];
+		A = c->A;
+		B = c->B;
+
+		if (!c->is_active) continue;
+
+		/* negative when overlapping, up to the slop */
+		s = c->separation_ + opus_vec2_dot(opus_vec2_to(A->position, B->position), c->normal) +
+		    B->rotation * opus_vec2_cross(c->rb, c->normal) - A->rotation * opus_vec2_cross(c->ra, c->normal) +
+		    world->position_slop;
+
+		mass_scale    = 1;
+		impulse_scale = 0;
+		if (s > 0) {
+			/* apart, let them close the gap in this sub-step */
+			bias = s / h;
+		} else if (use_bias) {
+			bias          = opus_max(world->soft_bias_rate_ * s, -world->contact_push_max);
+			mass_scale    = world->soft_mass_scale_;
+			impulse_scale = world->soft_impulse_scale_;
+		} else {
+			bias = 0;
+		}
+
+		va = opus_vec2_add(A->velocity, cross_rv(A->angular_velocity, c->ra));
+		vb = opus_vec2_add(B->velocity, cross_rv(B->angular_velocity, c->rb));
+		dv = opus_vec2_to(va, vb);
+
+		dv_n   = opus_vec2_dot(c->normal, opus_vec2_sub(dv, c->restitution_bias));
+		lambda = -c->effective_mass_normal * mass_scale * (dv_n + bias) - impulse_scale * c->normal_impulse;
+
+		old_impulse       = c->normal_impulse;
+		c->normal_impulse = opus_max(old_impulse + lambda, 0);
+		lambda            = c->normal_impulse - old_impulse;
+
+		impulse = opus_vec2_scale(c->normal, lambda);
+		opus_body_apply_impulse(A, opus_vec2_neg(impulse), c->ra);
+		opus_body_apply_impulse(B, impulse, c->rb);
+
+		apply_tangent_impulse_(world, contacts, c, h);
+	}
+}
+
+static void soft_contacts_(opus_physics_world *world, opus_contacts *contacts, int pass, opus_real h)
+{
+	if (pass == SOFT_WARM_START_) warm_start_contacts_(contacts);
+	else solve_contacts_soft_(world, contacts, pass == SOFT_SOLVE_, h);
+}
+
+/* the joints are prepared again for every sub-step, their warm start is in "prepare" */
+static void soft_joint_(opus_joint *joint, int pass, opus_real h)
+{
+	if (pass == SOFT_WARM_START_ && joint->prepare) joint->prepare(joint, h);
+	else if (pass == SOFT_SOLVE_ && joint->solve_velocity) joint->solve_velocity(joint, h);
+}
+
+static void soft_constraint_(opus_constraint *constraint, int pass, opus_real h)
+{
+	if (pass == SOFT_WARM_START_ && constraint->prepare) constraint->prepare(constraint, h);
+	else if (pass == SOFT_SOLVE_ && constraint->solve_velocity) constraint->solve_velocity(constraint, h);
+}
+
+static void soft_task_(void *data, size_t begin, size_t end, int worker)
+{
+	opus_solver      *solver = data;
+	opus_solver_item *item;
+	size_t            i;
+
+	(void) worker;
+	for (i = solver->offset_ + begin; i < solver->offset_ + end; i++) {
+		item = &solver->items[i];
+		switch (item->type) {
+			case OPUS_SOLVER_ITEM_CONTACTS:
+				soft_contacts_(solver->world_, item->item, solver->pass_, solver->dt_);
+				break;
+			case OPUS_SOLVER_ITEM_JOINT:
+				soft_joint_(item->item, solver->pass_, solver->dt_);
+				break;
+			case OPUS_SOLVER_ITEM_CONSTRAINT:
+				soft_constraint_(item->item, solver->pass_, solver->dt_);
+				break;
+		}
+	}
+}
+
+static void soft_pass_(opus_physics_world *world, int pass, opus_real h)
+{
+	size_t i;
+
+	opus_joint          *joint;
+	opus_constraint     *constraint;
+	opus_contact_solver *cs = world->contact_solver;
+
+	if (world->solver) {
+		world->solver->pass_ = pass;
+		solve_colors_(world, soft_task_, h);
+		return;
+	}
+
+	if (pass == SOFT_WARM_START_) opus_contact_solver_warm_start(cs);
+	else opus_contact_solver_solve_soft(cs, world, pass == SOFT_SOLVE_, h);
+	if (pass == SOFT_RELAX_ || !has_joints_(world)) return;
+
+	/* the bodies moved since the last warm start */
+	opus_contact_solver_scatter(cs, world->bodies, OPUS_SOLVER_BODY_VELOCITY | (pass == SOFT_WARM_START_ ? OPUS_SOLVER_BODY_POSE : 0));
+	for (i = 0; i < opus_arr_len(world->joints); i++) {
+		joint = world->joints[i];
+		if (!is_joint_asleep_(world, joint)) soft_joint_(joint, pass, h);
+	}
+	for (i = 0; i < opus_arr_len(world->constraints); i++) {
+		constraint = world->constraints[i];
+		if (!is_constraint_asleep_(world, constraint)) soft_constraint_(constraint, pass, h);
+	}
+	opus_contact_solver_refresh(cs, world->bodies, OPUS_SOLVER_BODY_VELOCITY);
+}
+
+/* like "opus_body_integrate_velocity", the rotation is wrapped at the end of the step only */
+static void integrate_velocity_soft_(opus_physics_world *world, opus_real h, opus_real damping)
+{
+	size_t     i;
+	opus_body *body;
+
+	for (i = 0; i < opus_arr_len(world->bodies); i++) {
+		body = world->bodies[i];
+		if (body->type == OPUS_BODY_STATIC || body->is_sleeping) continue;
+
+		body->velocity.x *= damping;
+		body->velocity.y *= damping;
+		body->position.x += body->velocity.x * h;
+		body->position.y += body->velocity.y * h;
+		body->rotation += body->angular_velocity * h;
+	}
+}
+
+/**
+ * @brief OPUS_SOLVER_SOFT_STEP, the forces are integrated for the whole step already. Each
+ * 		sub-step warm starts the contacts and the joints, solves them once with soft
+ * 		contacts, moves the bodies and relaxes the contacts once, instead of the many
+ * 		passes of "solve_velocity_" and "solve_position_".
+ */
+static void solve_soft_(opus_physics_world *world, opus_real dt)
+{
+	int        i, n;
+	size_t     j;
+	opus_real  h, damping, dx, dy, dr;
+	opus_body *body;
+
+	n = opus_max(world->sub_steps, 1);
+	h = dt / n;
+	/* the damping of "opus_body_integrate_velocity" spread over the sub-steps */
+	damping = opus_pow(0.9, 1.0 / n);
+
+	/* the serial solver moves the bodies of its flat copy, the colour batches solve on "opus_body" */
+	if (!world->solver) {
+		if (!world->contact_solver) world->contact_solver = opus_contact_solver_create();
+		opus_contact_solver_gather(world->contact_solver, world, dt);
+	}
+
+	for (i = 0; i < n; i++) {
+		PROFILE_BEGIN_(world, OPUS_PHASE_SOLVE_VELOCITY);
+		soft_pass_(world, SOFT_WARM_START_, h);
+		soft_pass_(world, SOFT_SOLVE_, h);
+		PROFILE_END_(world, OPUS_PHASE_SOLVE_VELOCITY);
+
+		PROFILE_BEGIN_(world, OPUS_PHASE_INTEGRATE);
+		if (world->solver) integrate_velocity_soft_(world, h, damping);
+		else opus_contact_solver_integrate(world->contact_solver, h, damping);
+		PROFILE_END_(world, OPUS_PHASE_INTEGRATE);
+
+		PROFILE_BEGIN_(world, OPUS_PHASE_SOLVE_POSITION);
+		soft_pass_(world, SOFT_RELAX_, h);
+		PROFILE_END_(world, OPUS_PHASE_SOLVE_POSITION);
+	}
+
+	if (!world->solver) {
+		opus_contact_solver_scatter(world->contact_solver, world->bodies, OPUS_SOLVER_BODY_VELOCITY | OPUS_SOLVER_BODY_POSE);
+		opus_contact_solver_store_impulses(world->contact_solver);
+	}
+
+	for (j = 0; j < opus_arr_len(world->bodies); j++) {
+		body = world->bodies[j];
+		if (body->type == OPUS_BODY_STATIC || body->is_sleeping) continue;
+
+		body->rotation = opus_mod(body->rotation, 2 * OPUS_PI);
+
+		dx           = body->velocity.x * dt;
+		dy           = body->velocity.y * dt;
+		dr           = body->angular_velocity * dt;
+		body->motion = dx * dx + dy * dy + dr * dr;
+	}
+}
+
+/* remember where the bullets start, return the number of bullets */
+static int begin_bullets_(opus_physics_world *world)
+{
+	size_t     i;
+	int        n;
+	opus_body *body;
+
+	for (i = 0, n = 0; i < opus_arr_len(world->bodies); i++) {
+		body = world->bodies[i];
+		if (body->type != OPUS_BODY_BULLET || body->is_sleeping) continue;
+		body->sweep_position_ = body->position;
+		body->sweep_rotation_ = body->rotation;
+		n++;
+	}
+	return n;
+}
+
+/* bounce the bullet off the body it hits, static and kinematic bodies do not move */
+static void apply_bullet_impulse_(opus_physics_world *world, opus_body *A, opus_body *B, opus_vec2 n, opus_vec2 p)
+{
+	opus_vec2 ra, rb, va, vb, impulse;
+	opus_real vn, ra_n, rb_n, inv_mass_b, inv_inertia_b, k, e;
+
+	ra = opus_vec2_to(A->position, p);
+	rb = opus_vec2_to(B->position, p);
+	va = opus_vec2_add(A->velocity, cross_rv(A->angular_velocity, ra));
+	vb = opus_vec2_add(B->velocity, cross_rv(B->angular_velocity, rb));
+	vn = opus_vec2_dot(opus_vec2_sub(va, vb), n);
+	OPUS_RETURN_IF(, vn <= 0);
+
+	if (B->type == OPUS_BODY_STATIC || B->type == OPUS_BODY_KINEMATIC) {
+		inv_mass_b = inv_inertia_b = 0;
+	} else {
+		if (world->enable_sleeping) world->woken_ += opus_sleeping_wake_up(B);
+		inv_mass_b    = B->inv_mass;
+		inv_inertia_b = B->inv_inertia;
+	}
+
+	ra_n = opus_vec2_cross(ra, n);
+	rb_n = opus_vec2_cross(rb, n);
+	k    = A->inv_mass + inv_mass_b + A->inv_inertia * ra_n * ra_n + inv_inertia_b * rb_n * rb_n;
+	e    = opus_sqrt(A->restitution * B->restitution);
+
+	impulse = opus_vec2_scale(n, (1 + e) * vn / k);
+	opus_body_apply_impulse(A, opus_vec2_neg(impulse), ra);
+	if (inv_mass_b != 0) opus_body_apply_impulse(B, impulse, rb);
+}
+
+struct bullet_sweep_ {
+	opus_physics_world *world;
+	opus_body          *body;
+	opus_sweep          sweep;
+
+	opus_body *hit; /* first body hit, NULL if none */
+	opus_real  t;
+	opus_vec2  normal, point;
+};
+
+/* the earliest impact among the bodies found by the query, the smaller id first at the same time */
+static int bullet_sweep_cb_(opus_body *other, void *data)
+{
+	struct bullet_sweep_ *sweep = data;
+	opus_sweep            sb;
+	opus_vec2             normal, point;
+	opus_real             t;
+
+	if (other == sweep->body) return 1;
+
+	sb.p0 = sb.p1 = other->position;
+	sb.r0 = sb.r1 = other->rotation;
+	sb.radius     = 0;
+	if (!opus_TOI(sweep->body->shape, &sweep->sweep, other->shape, &sb, sweep->world->position_slop, &t, &normal, &point)) return 1;
+	if (t > sweep->t || (t == sweep->t && !(sweep->hit && other->id < sweep->hit->id))) return 1;
+
+	sweep->hit    = other;
+	sweep->t      = t;
+	sweep->normal = normal;
+	sweep->point  = point;
+	return 1;
+}
+
+/**
+ * @brief continuous collision of the bullets: sweep each bullet from where it started the
+ * 		step to where it is now against the other bodies (at their current pose), stop at
+ * 		the first impact, bounce, and sweep the rest of the step with the new velocity.
+ * 		Only the bullets are sub-stepped, everything else keeps the step of the world.
+ * 		The bodies the bound swept by a bullet overlaps are found with the query tree, which
+ * 		is refreshed here at the end pose of the other bodies.
+ * @param world
+ * @param dt
+ */
+static void solve_bullets_(opus_physics_world *world, opus_real dt)
+{
+	size_t     i;
+	int        k;
+	opus_body *body;
+	opus_aabb  swept;
+	opus_real  time_left, dr;
+
+	struct bullet_sweep_ query;
+	opus_sweep          *sa = &query.sweep;
+
+	/* the bodies have moved since the last query */
+	world->query_dirty_ = 1;
+	query.world         = world;
+
+	for (i = 0; i < opus_arr_len(world->bodies); i++) {
+		body = world->bodies[i];
+		if (body->type != OPUS_BODY_BULLET || body->is_sleeping) continue;
+
+		sa->p0     = body->sweep_position_;
+		sa->r0     = body->sweep_rotation_;
+		sa->p1     = body->position;
+		sa->radius = opus_sweep_radius(body->shape);
+		time_left  = 1;
+
+		/* the rotation is wrapped by the integration, go the short way */
+		dr = opus_mod(body->rotation - sa->r0, 2 * OPUS_PI);
+		if (dr > OPUS_PI) dr -= 2 * OPUS_PI;
+		if (dr < -OPUS_PI) dr += 2 * OPUS_PI;
+		sa->r1 = sa->r0 + dr;
+
+		/* the discrete narrow phase catches everything in reach */
+		if (opus_vec2_len(opus_vec2_sub(sa->p1, sa->p0)) + opus_abs(dr) * sa->radius < opus_sweep_core(body->shape)) continue;
+
+		for (k = 0; k < CCD_MAX_SUBSTEPS; k++) {
+			swept.min.x = opus_min(sa->p0.x, sa->p1.x) - sa->radius;
+			swept.min.y = opus_min(sa->p0.y, sa->p1.y) - sa->radius;
+			swept.max.x = opus_max(sa->p0.x, sa->p1.x) + sa->radius;
+			swept.max.y = opus_max(sa->p0.y, sa->p1.y) + sa->radius;
+
+			query.body = body;
+			query.hit  = NULL;
+			query.t    = 1;
+			opus_physics_world_query_aabb(world, &swept, body->bitmask, bullet_sweep_cb_, &query);
+			if (!query.hit) break;
+
+			/* move to the impact, and sweep the rest of the step with the new velocity */
+			sa->p0 = opus_vec2_add(sa->p0, opus_vec2_scale(opus_vec2_sub(sa->p1, sa->p0), query.t));
+			sa->r0 = sa->r0 + (sa->r1 - sa->r0) * query.t;
+			apply_bullet_impulse_(world, body, query.hit, query.normal, query.point);
+			time_left *= 1 - query.t;
+			sa->p1 = opus_vec2_add(sa->p0, opus_vec2_scale(body->velocity, dt * time_left));
+			sa->r1 = sa->r0 + body->angular_velocity * dt * time_left;
+		}
+
+		/* stay at the last impact if the bullet is still hitting things */
+		body->position = k == CCD_MAX_SUBSTEPS ? sa->p0 : sa->p1;
+		body->rotation = opus_mod(k == CCD_MAX_SUBSTEPS ? sa->r0 : sa->r1, 2 * OPUS_PI);
+		body->shape->update_bound(body->shape, body->rotation, body->position);
+
+		/* the following bullets find this one where it is now */
+		if (world->query_tree_ && body->query_proxy_ >= 0) {
+			opus_bvh_remove(world->query_tree_, body);
+			opus_bvh_insert(world->query_tree_, body);
+		}
+	}
+}
+
+static void inactivate_all_contacts_(opus_physics_world *world)
+{
+	uint64_t i;
+	int      j;
+
+	opus_pair_entry *entry;
+	opus_contacts   *contacts;
+	opus_pair_cache_foreach_start(&world->contacts, entry, i)
 	{
-		contacts = *(opus_contacts **) contacts;
+		contacts = entry->value;
 
-		for (j = 0; j < opus_arr_len(contacts->contacts); j++)
-			contacts->contacts[j]->is_active = 0;
+		for (j = 0; j < contacts->n_contacts; j++)
+			contacts->contacts[j].is_active = 0;
 	}
-	opus_hashmap_foreach_end();
+	opus_pair_cache_foreach_end();
 }
 
 static void clear_inactive_contacts_(opus_physics_world *world)
 {
-	uint64_t i, j;
+	uint64_t i;
 
-	opus_contacts *contacts;
-	opus_hashmap_foreach_start(&world->contacts, contacts, i)
+	opus_pair_entry *entry;
+	opus_contacts   *contacts;
+
+	/* entries are shifted backward on removal, so only advance when nothing is removed */
+	i = 0;
+	while (i < world->contacts.capacity) {
+		entry = &world->contacts.entries[i];
+		if (entry->key == OPUS_PAIR_KEY_EMPTY) {
+			i++;
+			continue;
+		}
+		contacts = entry->value;
+
+		/* the contacts of resting pairs are kept for the warm start when they wake up */
+		if (world->enable_sleeping && opus_sleeping_is_pair_asleep(contacts->A, contacts->B)) {
+			i++;
+			continue;
+		}
+
+		opus_contacts_remove_inactive(contacts);
+		if (contacts->n_contacts == 0) {
+			opus_pair_cache_remove_at(&world->contacts, i);
+			opus_contacts_destroy(&world->contacts_pool, contacts);
+			continue;
+		}
+		i++;
+	}
+}
+
+/* the contacts the solvers go through, in the order of the table */
+static void collect_awake_contacts_(opus_physics_world *world)
+{
+	uint64_t i;
+
+	opus_pair_entry *entry;
+	opus_contacts   *contacts;
+
+	opus_arr_clear(world->awake_contacts_);
+	opus_pair_cache_foreach_start(&world->contacts, entry, i)
 	{
-		contacts = *(opus_contacts **) contacts;
+		contacts = entry->value;
+		if (world->enable_sleeping && opus_sleeping_is_pair_asleep(contacts->A, contacts->B)) continue;
+		opus_arr_push(world->awake_contacts_, &contacts);
+		PROFILE_COUNT_(world, active_contacts, contacts->n_contacts);
+	}
+	opus_pair_cache_foreach_end();
+}
 
-		for (j = 0; j < opus_arr_len(contacts->contacts); j++) {
-			if (!contacts->contacts[j]->is_active) {
-				opus_contact_destroy(contacts->contacts[j]);
-				opus_arr_remove(contacts->contacts, j);
-				j--;
-			}
+/* the resting pairs kept in the contacts, the broad phase does not report them */
+static void collect_sleeping_pairs_(opus_physics_world *world)
+{
+	uint64_t i;
+
+	opus_pair_entry *entry;
+	opus_contacts   *contacts;
+	opus_sleep_pair  pair;
+
+	opus_pair_cache_foreach_start(&world->contacts, entry, i)
+	{
+		contacts = entry->value;
+		if (!opus_sleeping_is_pair_asleep(contacts->A, contacts->B)) continue;
+		pair.A = contacts->A;
+		pair.B = contacts->B;
+		opus_arr_push(world->sleeping_pairs_, &pair);
+		PROFILE_COUNT_(world, sleeping_pairs, 1);
+	}
+	opus_pair_cache_foreach_end();
+}
+
+/**
+ * @brief run the narrow phase on the resting pairs skipped by the broad phase, whose island
+ * 		has been woken up afterwards. Waking up may reach more islands, so repeat until
+ * 		nothing more wakes up.
+ * @param world
+ */
+static void check_woken_pairs_(opus_physics_world *world)
+{
+	size_t          i;
+	int             woken;
+	opus_sleep_pair pair;
+
+	do {
+		woken = world->woken_;
+		for (i = 0; i < opus_arr_len(world->sleeping_pairs_); i++) {
+			pair = world->sleeping_pairs_[i];
+			if (!pair.A || opus_sleeping_is_pair_asleep(pair.A, pair.B)) continue;
+
+			world->sleeping_pairs_[i].A = NULL; /* done */
+			check_potential_collision_pair_(pair.A, pair.B, world);
 		}
+	} while (world->woken_ != woken);
+}
 
-		if (opus_arr_len(contacts->contacts) == 0) {
-			opus_hashmap_remove(&world->contacts, &contacts);
-			opus_contacts_destroy(contacts);
+/**
+ * @brief (re)build the broad phase structures if the type is changed, and insert new bodies
+ * @param world
+ */
+static void sync_broad_phase_(opus_physics_world *world)
+{
+	size_t     i, n_new;
+	opus_body *body;
+
+	if (world->broad_phase_ != world->broad_phase) {
+		if (world->sap) opus_sap_destroy(world->sap);
+		if (world->bvh) opus_bvh_destroy(world->bvh);
+		if (world->grid) opus_grid_destroy(world->grid);
+		world->sap  = NULL;
+		world->bvh  = NULL;
+		world->grid = NULL;
+
+		if (world->broad_phase == OPUS_BROAD_PHASE_SAP_INCREMENTAL) world->sap = opus_sap_create(NULL, NULL);
+		if (world->broad_phase == OPUS_BROAD_PHASE_BVH) world->bvh = opus_bvh_create();
+		if (world->broad_phase == OPUS_BROAD_PHASE_GRID) world->grid = opus_grid_create();
+		world->broad_phase_ = world->broad_phase;
+	}
+
+	if (world->sap) {
+		for (i = 0; i < opus_arr_len(world->bodies); i++) {
+			body = world->bodies[i];
+			if (body->proxy_id < 0) opus_sap_add(world->sap, body);
 		}
 	}
-	opus_hashmap_foreach_end();
+
+	if (world->bvh) {
+		for (i = 0, n_new = 0; i < opus_arr_len(world->bodies); i++) {
+			body = world->bodies[i];
+			if (body->proxy_id < 0) {
+				opus_bvh_insert(world->bvh, body);
+				n_new++;
+			}
+		}
+
+		/* lots of new bodies (level loading), incremental insertion builds a poor tree */
+		if (n_new * 4 > (size_t) world->bvh->leaf_count) opus_bvh_build_SAH(world->bvh);
+	}
+}
+
+/* the narrow phase and the contact generation read the poses from here */
+static void update_transforms_(opus_physics_world *world)
+{
+	size_t i;
+	for (i = 0; i < opus_arr_len(world->bodies); i++)
+		opus_body_update_transform(world->bodies[i]);
+}
+
+/* create or drop the workers of the narrow phase when "narrow_phase_threads" is changed */
+static void sync_narrow_pool_(opus_physics_world *world)
+{
+	if (world->narrow_pool_ && opus_thread_pool_size(world->narrow_pool_) != world->narrow_phase_threads) {
+		opus_thread_pool_destroy(world->narrow_pool_);
+		world->narrow_pool_ = NULL;
+	}
+	if (!world->narrow_pool_ && world->narrow_phase_threads > 1) {
+		world->narrow_pool_ = opus_thread_pool_create(world->narrow_phase_threads);
+		/* fewer threads may have been created, keep the count of the pool so it is not recreated every step */
+		if (world->narrow_pool_) world->narrow_phase_threads = opus_thread_pool_size(world->narrow_pool_);
+	}
+}
+
+/**
+ * @brief SAT/GJK and the clipping of the listed pairs, on the workers if there are enough
+ * 		of them, then merge the results into the contacts one by one in the order of the list.
+ * 		The merge does what the broad phase callback used to do, in the same order, so the
+ * 		step is the same for any number of threads.
+ * @param world
+ */
+static void narrow_phase_(opus_physics_world *world)
+{
+	size_t i, n;
+
+	n = opus_arr_len(world->narrow_pairs_);
+	sync_narrow_pool_(world);
+	if (world->narrow_pool_ && n >= NARROW_MIN_PARALLEL_PAIRS)
+		opus_thread_pool_for(world->narrow_pool_, n, test_narrow_pairs_task_, world);
+	else
+		test_narrow_pairs_task_(world, 0, n, 0);
+
+	for (i = 0; i < n; i++) merge_narrow_pair_(world, &world->narrow_pairs_[i]);
 }
 
 static void retrieve_collision_info_(opus_physics_world *world, opus_real dt)
 {
-	opus_SAP(world->bodies, opus_arr_len(world->bodies), check_potential_collision_pair_, world);
+	opus_arr_clear(world->sleeping_pairs_);
+	opus_arr_clear(world->narrow_pairs_);
+	sync_broad_phase_(world);
+	update_transforms_(world);
+	opus_sat_cache_update(&world->sat_cache, world->bodies, opus_arr_len(world->bodies));
+	if (world->enable_sleeping) collect_sleeping_pairs_(world);
+	/* only the pairs with an awake body are reported */
+	switch (world->broad_phase) {
+		case OPUS_BROAD_PHASE_SAP_INCREMENTAL:
+			opus_sap_update(world->sap);
+			opus_sap_for_each_pair(world->sap, collect_narrow_pair_, world);
+			break;
+		case OPUS_BROAD_PHASE_BVH:
+			opus_bvh_update(world->bvh, dt);
+			opus_bvh_for_each_pair(world->bvh, collect_narrow_pair_, world);
+			break;
+		case OPUS_BROAD_PHASE_GRID:
+			opus_grid_for_each_pair(world->grid, world->bodies, opus_arr_len(world->bodies), world->grid_cell_size,
+			                        collect_narrow_pair_, world);
+			break;
+		case OPUS_BROAD_PHASE_SAP:
+		default:
+			opus_SAP(world->bodies, opus_arr_len(world->bodies), collect_narrow_pair_, world);
+			break;
+	}
+	PROFILE_BEGIN_(world, OPUS_PHASE_NARROW);
+	narrow_phase_(world);
+	PROFILE_END_(world, OPUS_PHASE_NARROW);
+	if (world->enable_sleeping) check_woken_pairs_(world);
 }
 
 /**
@@ -563,6 +1434,106 @@ static void step_time_(opus_physics_world *world, opus_real dt)
 	world->current_time += dt;
 }
 
+/* create or drop the parallel solver when "solver_threads" is changed */
+static void sync_solver_(opus_physics_world *world)
+{
+	if (world->solver && opus_thread_pool_size(world->solver->pool) != world->solver_threads) {
+		solver_destroy_(world->solver);
+		world->solver = NULL;
+	}
+	if (!world->solver && world->solver_threads > 1) {
+		world->solver       = OPUS_CALLOC(1, sizeof(opus_solver));
+		world->solver->pool = opus_thread_pool_create(world->solver_threads);
+		/* fewer threads may have been created, keep the count of the pool so it is not recreated every step */
+		world->solver_threads = opus_thread_pool_size(world->solver->pool);
+		opus_arr_create(world->solver->items, sizeof(opus_solver_item));
+		opus_arr_create(world->solver->scratch_, sizeof(opus_solver_item));
+	}
+}
+
+/**
+ * @brief pick the first colour neither body has used, static bodies are never written
+ * 		by the solver so they do not count
+ * @return OPUS_SOLVER_MAX_COLORS if all the colours are used
+ */
+static int color_bodies_(opus_body *A, opus_body *B)
+{
+	uint64_t used = 0;
+	int      c;
+
+	if (A && A->type == OPUS_BODY_STATIC) A = NULL;
+	if (B && B->type == OPUS_BODY_STATIC) B = NULL;
+	if (A) used |= A->solver_colors_;
+	if (B) used |= B->solver_colors_;
+
+	for (c = 0; c < OPUS_SOLVER_MAX_COLORS; c++)
+		if (!(used & (uint64_t) 1 << c)) break;
+
+	if (c < OPUS_SOLVER_MAX_COLORS) {
+		if (A) A->solver_colors_ |= (uint64_t) 1 << c;
+		if (B) B->solver_colors_ |= (uint64_t) 1 << c;
+	}
+	return c;
+}
+
+static void push_solver_item_(opus_solver *solver, int type, void *item, opus_body *A, opus_body *B)
+{
+	opus_solver_item si;
+	si.type  = type;
+	si.item  = item;
+	si.color = color_bodies_(A, B);
+	opus_arr_push(solver->scratch_, &si);
+	solver->colors[si.color + 1]++;
+}
+
+/**
+ * @brief greedy colouring of the contacts, joints and constraints, then a counting sort
+ * 		by colour. Items are visited in the same order as the serial solver, so the
+ * 		batches (and the result) do not depend on the number of threads.
+ * @param world
+ */
+static void color_solver_items_(opus_physics_world *world)
+{
+	opus_solver     *solver = world->solver;
+	opus_contacts   *contacts;
+	opus_joint      *joint;
+	opus_constraint *constraint;
+	opus_body       *A, *B;
+	uint64_t         i;
+	int              c;
+
+	for (i = 0; i < opus_arr_len(world->bodies); i++) world->bodies[i]->solver_colors_ = 0;
+	memset(solver->colors, 0, sizeof(solver->colors));
+	opus_arr_clear(solver->scratch_);
+
+	for (i = 0; i < opus_arr_len(world->awake_contacts_); i++) {
+		contacts = world->awake_contacts_[i];
+		push_solver_item_(solver, OPUS_SOLVER_ITEM_CONTACTS, contacts, contacts->A, contacts->B);
+	}
+
+	for (i = 0; i < opus_arr_len(world->joints); i++) {
+		joint = world->joints[i];
+		if (is_joint_asleep_(world, joint)) continue;
+		opus_joint_get_bodies(joint, &A, &B);
+		push_solver_item_(solver, OPUS_SOLVER_ITEM_JOINT, joint, A, B);
+	}
+
+	for (i = 0; i < opus_arr_len(world->constraints); i++) {
+		constraint = world->constraints[i];
+		if (is_constraint_asleep_(world, constraint)) continue;
+		opus_constraint_get_bodies(constraint, &A, &B);
+		push_solver_item_(solver, OPUS_SOLVER_ITEM_CONSTRAINT, constraint, A, B);
+	}
+
+	/* counting sort, "colors[c]" is the start of colour c after the prefix sum */
+	for (c = 0; c <= OPUS_SOLVER_MAX_COLORS; c++) solver->colors[c + 1] += solver->colors[c];
+	opus_arr_resize(solver->items, opus_arr_len(solver->scratch_));
+	for (i = 0; i < opus_arr_len(solver->scratch_); i++)
+		solver->items[solver->colors[solver->scratch_[i].color]++] = solver->scratch_[i];
+	for (c = OPUS_SOLVER_MAX_COLORS + 1; c > 0; c--) solver->colors[c] = solver->colors[c - 1];
+	solver->colors[0] = 0;
+}
+
 static void prepare_(opus_physics_world *world, opus_real dt)
 {
 	uint64_t i;
@@ -572,37 +1543,188 @@ static void prepare_(opus_physics_world *world, opus_real dt)
 
 	for (i = 0; i < opus_arr_len(world->joints); i++) {
 		joint = world->joints[i];
-		if (joint->prepare) joint->prepare(joint, dt);
+		if (joint->prepare && !is_joint_asleep_(world, joint)) joint->prepare(joint, dt);
 	}
 
 	for (i = 0; i < opus_arr_len(world->constraints); i++) {
 		constraint = world->constraints[i];
-		if (constraint->prepare) constraint->prepare(constraint, dt);
+		if (constraint->prepare && !is_constraint_asleep_(world, constraint)) constraint->prepare(constraint, dt);
 	}
 }
 
-void opus_physics_world_step(opus_physics_world *world, opus_real dt)
+#ifdef OPUS_PHYSICS_PROFILE
+#define PROFILE_N_CAPACITIES_ (9)
+
+/* of what the step grows, a change is a trip to the system allocator */
+static void profile_capacities_(opus_physics_world *world, uint64_t *capacities)
+{
+	capacities[0] = world->contacts_pool.n_slab_allocs;
+	capacities[1] = world->contacts.capacity;
+	capacities[2] = opus_arr_cap(world->awake_contacts_);
+	capacities[3] = opus_arr_cap(world->sleeping_pairs_);
+	capacities[4] = opus_arr_cap(world->island_parent_);
+	capacities[5] = opus_arr_cap(world->island_sleepy_);
+	capacities[6] = opus_arr_cap(world->sat_cache.x);
+	capacities[7] = world->solver ? opus_arr_cap(world->solver->items) : 0;
+	capacities[8] = opus_arr_cap(world->narrow_pairs_);
+}
+
+static void profile_begin_step_(opus_physics_world *world, uint64_t *capacities)
+{
+	memset(&world->profile, 0, sizeof(world->profile));
+	profile_capacities_(world, capacities);
+	world->profile.step_begin_ = stm_now();
+}
+
+static void profile_end_step_(opus_physics_world *world, uint64_t *capacities)
+{
+	int      i;
+	uint64_t now[PROFILE_N_CAPACITIES_];
+
+	world->profile.step_ns = stm_ns(stm_since(world->profile.step_begin_));
+	/* the narrow phase runs inside the broad phase */
+	world->profile.phase_ns[OPUS_PHASE_BROAD] -= world->profile.phase_ns[OPUS_PHASE_NARROW];
+	world->profile.touching_pairs = opus_arr_len(world->awake_contacts_);
+
+	profile_capacities_(world, now);
+	world->profile.allocations = now[0] - capacities[0];
+	for (i = 1; i < PROFILE_N_CAPACITIES_; i++) world->profile.allocations += now[i] != capacities[i];
+}
+#endif
+
+static void step_(opus_physics_world *world, opus_real dt)
 {
-	dt = get_nice_dt_(world, dt);
+	int n_bullets, soft;
+
+#ifdef OPUS_PHYSICS_PROFILE
+	uint64_t capacities[PROFILE_N_CAPACITIES_];
+	profile_begin_step_(world, capacities);
+#endif
+
+	soft = world->solver_mode == OPUS_SOLVER_SOFT_STEP;
+
+	/* forces applied since the last step wake up the resting islands */
+	world->woken_ = 0;
+	PROFILE_BEGIN_(world, OPUS_PHASE_SLEEPING);
+	if (world->enable_sleeping) opus_sleeping_wake_forced(world);
+	PROFILE_END_(world, OPUS_PHASE_SLEEPING);
 	/* apply gravity force to rigid bodies and integrate forces, affecting their velocity */
+	PROFILE_BEGIN_(world, OPUS_PHASE_INTEGRATE);
 	apply_gravity_(world, dt);
 	integrate_forces_(world, dt);
-//	opus_sleeping_update(world, dt);
+	PROFILE_END_(world, OPUS_PHASE_INTEGRATE);
 	/* check collision and generate contacts, plus warm start */
+	PROFILE_BEGIN_(world, OPUS_PHASE_BROAD);
 	retrieve_collision_info_(world, dt);
+	PROFILE_END_(world, OPUS_PHASE_BROAD);
+	PROFILE_BEGIN_(world, OPUS_PHASE_CONTACTS);
 	clear_inactive_contacts_(world);
+	collect_awake_contacts_(world);
+	PROFILE_END_(world, OPUS_PHASE_CONTACTS);
 	/* prepare to resolve constraint (other type of constraints and joints) */
-	prepare_(world, dt);
-//	opus_sleeping_before_resolution(world);
-	/* solve velocity constraints */
-	solve_velocity_(world, dt);
-	/* integrate velocity, affect their position */
-	integrate_velocity_(world, dt);
-//	opus_sleeping_after_collision(world, dt);
-	/* solve position constraints, mainly to supplement the resolution of velocity */
-	solve_position_(world, dt);
+	PROFILE_BEGIN_(world, OPUS_PHASE_PREPARE);
+	if (soft) prepare_soft_contacts_(world, dt / opus_max(world->sub_steps, 1));
+	else prepare_(world, dt);
+	sync_solver_(world);
+	if (world->solver) color_solver_items_(world);
+	PROFILE_END_(world, OPUS_PHASE_PREPARE);
+	if (soft) {
+		/* sub-steps of solving, moving and relaxing, instead of the three below */
+		n_bullets = begin_bullets_(world);
+		solve_soft_(world, dt);
+	} else {
+		/* solve velocity constraints */
+		PROFILE_BEGIN_(world, OPUS_PHASE_SOLVE_VELOCITY);
+		solve_velocity_(world, dt);
+		PROFILE_END_(world, OPUS_PHASE_SOLVE_VELOCITY);
+		/* integrate velocity, affect their position */
+		n_bullets = begin_bullets_(world);
+		PROFILE_BEGIN_(world, OPUS_PHASE_INTEGRATE);
+		integrate_velocity_(world, dt);
+		PROFILE_END_(world, OPUS_PHASE_INTEGRATE);
+		/* solve position constraints, mainly to supplement the resolution of velocity */
+		PROFILE_BEGIN_(world, OPUS_PHASE_SOLVE_POSITION);
+		solve_position_(world, dt);
+		PROFILE_END_(world, OPUS_PHASE_SOLVE_POSITION);
+	}
+	/* sweep the fast bodies to where they ended up, so that they do not tunnel */
+	PROFILE_BEGIN_(world, OPUS_PHASE_BULLETS);
+	if (n_bullets) solve_bullets_(world, dt);
+	PROFILE_END_(world, OPUS_PHASE_BULLETS);
+	/* build the islands while the contacts of the step are still active, put the resting ones to sleep */
+	PROFILE_BEGIN_(world, OPUS_PHASE_SLEEPING);
+	if (world->enable_sleeping) opus_sleeping_update(world, dt);
+	PROFILE_END_(world, OPUS_PHASE_SLEEPING);
 	clear_forces_(world);
+	/* for the renderer, while the contacts of the step are there (and to drop the old ones when turned off) */
+	if (world->debug_draw || opus_arr_len(world->debug_cmds)) opus_physics_world_debug_draw(world);
 	/* prepare for next frame */
 	inactivate_all_contacts_(world);
 	step_time_(world, dt);
+	world->query_dirty_ = 1;
+
+#ifdef OPUS_PHYSICS_PROFILE
+	profile_end_step_(world, capacities);
+#endif
+}
+
+void opus_physics_world_step(opus_physics_world *world, opus_real dt)
+{
+	step_(world, get_nice_dt_(world, dt));
+}
+
+/* keep the pose of every body before the step for the interpolation */
+static void save_previous_poses_(opus_physics_world *world)
+{
+	size_t     i;
+	opus_body *body;
+
+	for (i = 0; i < opus_arr_len(world->bodies); i++) {
+		body                = world->bodies[i];
+		body->prev_position = body->position;
+		body->prev_rotation = body->rotation;
+	}
+}
+
+/**
+ * @brief fixed step mode: the real time is accumulated and simulated in steps of exactly
+ * 		"fixed_dt" (scaled by "time_scale"), the rest is carried to the next call. The steps
+ * 		do not depend on how the time is sliced into frames, so the same sequence of inputs
+ * 		gives the same results bit for bit. Render the bodies with
+ * 		"opus_body_get_interpolated_transform" and "world->alpha".
+ * @param world
+ * @param real_dt time passed since the last call
+ * @return number of steps run, may be 0
+ */
+int opus_physics_world_advance(opus_physics_world *world, opus_real real_dt)
+{
+	int n;
+
+	OPUS_RETURN_IF(0, world->fixed_dt <= 0);
+
+	world->accumulator_ += real_dt;
+	for (n = 0; world->accumulator_ >= world->fixed_dt && n < world->max_fixed_steps; n++) {
+		save_previous_poses_(world);
+		step_(world, world->fixed_dt * world->time_scale);
+		world->accumulator_ -= world->fixed_dt;
+	}
+	/* too far behind to catch up, drop the whole steps left instead of spiralling */
+	if (world->accumulator_ >= world->fixed_dt)
+		world->accumulator_ -= opus_floor(world->accumulator_ / world->fixed_dt) * world->fixed_dt;
+
+	world->alpha = world->accumulator_ / world->fixed_dt;
+	return n;
+}
+
+/**
+ * @brief name of OPUS_PHASE_*, for the reports of "opus_physics_profile"
+ */
+const char *opus_physics_phase_name(int phase)
+{
+	static const char *names[OPUS_PHASE_COUNT] = {
+	        "broad phase", "narrow phase", "contacts", "prepare", "solve velocity",
+	        "integrate", "solve position", "bullets", "sleeping"};
+
+	OPUS_RETURN_IF("unknown", phase < 0 || phase >= OPUS_PHASE_COUNT);
+	return names[phase];
 }
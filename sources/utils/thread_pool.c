@@ -0,0 +1,206 @@
+/**
+ * @file thread_pool.c
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/3/26
+ *
+ * @brief workers spin for a while before sleeping on the condition, since the physics
+ * 		world issues many short loops in a row (one per colour per solver iteration)
+ *
+ */
+
+#include "utils/thread_pool.h"
+#include "utils/utils.h"
+
+#ifndef OPUS_NO_THREADS
+#include <pthread.h>
+#endif
+
+#define THREAD_POOL_SPIN_COUNT (4000)
+
+#if defined(__GNUC__) && !defined(OPUS_NO_THREADS)
+#define THREAD_POOL_LOAD_(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define THREAD_POOL_STORE_(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#define THREAD_POOL_LOAD_(p) (*(p))
+#define THREAD_POOL_STORE_(p, v) (*(p) = (v))
+#endif
+
+typedef struct thread_pool_worker_ thread_pool_worker_;
+
+struct thread_pool_worker_ {
+	opus_thread_pool *pool;
+	int               index;
+#ifndef OPUS_NO_THREADS
+	pthread_t thread;
+#endif
+};
+
+struct opus_thread_pool {
+	int n_threads; /* including the caller */
+
+	/* current loop */
+	opus_thread_pool_task_cb task;
+	void                    *data;
+	size_t                   n;
+
+	int                  generation; /* increased for every loop */
+	int                  pending;    /* workers still running the current loop */
+	int                  quit;
+	thread_pool_worker_ *workers;
+
+#ifndef OPUS_NO_THREADS
+	pthread_mutex_t mutex;
+	pthread_cond_t  start;
+	pthread_cond_t  done;
+#endif
+};
+
+/* the part of the range run by the worker, the same for the same "n" and pool size */
+static void thread_pool_run_(opus_thread_pool *pool, int worker)
+{
+	size_t begin, end;
+	begin = pool->n * (size_t) worker / (size_t) pool->n_threads;
+	end   = pool->n * (size_t) (worker + 1) / (size_t) pool->n_threads;
+	if (begin < end) pool->task(pool->data, begin, end, worker);
+}
+
+#ifndef OPUS_NO_THREADS
+static void *thread_pool_worker_main_(void *arg)
+{
+	thread_pool_worker_ *worker = arg;
+	opus_thread_pool    *pool   = worker->pool;
+	int                  seen, spin;
+
+	seen = 0;
+	for (;;) {
+		for (spin = 0; spin < THREAD_POOL_SPIN_COUNT; spin++)
+			if (THREAD_POOL_LOAD_(&pool->generation) != seen) break;
+
+		pthread_mutex_lock(&pool->mutex);
+		while (pool->generation == seen && !pool->quit)
+			pthread_cond_wait(&pool->start, &pool->mutex);
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+
+		if (pool->quit) break;
+
+		thread_pool_run_(pool, worker->index);
+
+		pthread_mutex_lock(&pool->mutex);
+		THREAD_POOL_STORE_(&pool->pending, pool->pending - 1);
+		if (pool->pending == 0) pthread_cond_signal(&pool->done);
+		pthread_mutex_unlock(&pool->mutex);
+	}
+
+	return NULL;
+}
+#endif
+
+/**
+ * @brief create a pool running loops on "n_threads" threads, the caller is one of them
+ * @param n_threads
+ * @return
+ */
+opus_thread_pool *opus_thread_pool_create(int n_threads)
+{
+	opus_thread_pool *pool;
+	int               i;
+
+#ifdef OPUS_NO_THREADS
+	n_threads = 1;
+#endif
+	if (n_threads < 1) n_threads = 1;
+
+	pool = OPUS_CALLOC(1, sizeof(opus_thread_pool));
+	if (!pool) return NULL;
+	pool->n_threads = n_threads;
+	pool->workers   = OPUS_CALLOC(n_threads, sizeof(thread_pool_worker_));
+
+#ifndef OPUS_NO_THREADS
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	for (i = 1; i < n_threads; i++) {
+		pool->workers[i].pool  = pool;
+		pool->workers[i].index = i;
+		if (pthread_create(&pool->workers[i].thread, NULL, thread_pool_worker_main_, &pool->workers[i]) != 0) {
+			OPUS_ERROR("opus_thread_pool_create: failed to create thread %d\n", i);
+			pool->n_threads = i;
+			break;
+		}
+	}
+#else
+	(void) i;
+#endif
+
+	return pool;
+}
+
+void opus_thread_pool_destroy(opus_thread_pool *pool)
+{
+#ifndef OPUS_NO_THREADS
+	int i;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+	for (i = 1; i < pool->n_threads; i++) pthread_join(pool->workers[i].thread, NULL);
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->mutex);
+#endif
+	OPUS_FREE(pool->workers);
+	OPUS_FREE(pool);
+}
+
+int opus_thread_pool_size(opus_thread_pool *pool)
+{
+	return pool->n_threads;
+}
+
+/**
+ * @brief split [0, n) into one contiguous range per thread and wait until all of them are done
+ * @param pool
+ * @param n
+ * @param task
+ * @param data
+ */
+void opus_thread_pool_for(opus_thread_pool *pool, size_t n, opus_thread_pool_task_cb task, void *data)
+{
+#ifndef OPUS_NO_THREADS
+	int spin;
+#endif
+
+	OPUS_RETURN_IF(, n == 0);
+
+	/* not worth waking anyone up */
+	if (pool->n_threads == 1 || n == 1) {
+		task(data, 0, n, 0);
+		return;
+	}
+
+#ifndef OPUS_NO_THREADS
+	pthread_mutex_lock(&pool->mutex);
+	pool->task    = task;
+	pool->data    = data;
+	pool->n       = n;
+	pool->pending = pool->n_threads - 1;
+	THREAD_POOL_STORE_(&pool->generation, pool->generation + 1);
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+
+	thread_pool_run_(pool, 0);
+
+	for (spin = 0; spin < THREAD_POOL_SPIN_COUNT; spin++)
+		if (THREAD_POOL_LOAD_(&pool->pending) == 0) break;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->pending > 0) pthread_cond_wait(&pool->done, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+#endif
+}
@@ -0,0 +1,56 @@
+/**
+ * @file thread_pool.h
+ *     Author:    _              _
+ *               / \   _ __ ___ (_)  __ _ ___
+ *              / _ \ | '_ ` _ \| |/ _` / __|
+ *             / ___ \| | | | | | | (_| \__ \
+ *            /_/   \_\_| |_| |_|_|\__,_|___/  2023/3/26
+ *
+ * @example
+ *
+ * static void task(void *data, size_t begin, size_t end, int worker)
+ * {
+ * 	size_t i;
+ * 	for (i = begin; i < end; i++) ((double *) data)[i] *= 2;
+ * }
+ *
+ * opus_thread_pool *pool = opus_thread_pool_create(8);
+ * opus_thread_pool_for(pool, n, task, array);
+ * opus_thread_pool_destroy(pool);
+ *
+ * @brief persistent worker threads for data parallel loops. The range is always split
+ * 		the same way for the same pool size, the caller thread works on the first part.
+ * 		Define OPUS_NO_THREADS (or build without pthreads) to run everything on the caller.
+ *
+ */
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stddef.h>
+
+#if !defined(OPUS_NO_THREADS) && defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define OPUS_NO_THREADS
+#endif
+
+typedef struct opus_thread_pool opus_thread_pool;
+
+/**
+ * @brief run the range [begin, end) of the loop
+ * @param worker index of the thread running it, 0 is the caller
+ */
+typedef void (*opus_thread_pool_task_cb)(void *data, size_t begin, size_t end, int worker);
+
+opus_thread_pool *opus_thread_pool_create(int n_threads);
+void              opus_thread_pool_destroy(opus_thread_pool *pool);
+int               opus_thread_pool_size(opus_thread_pool *pool);
+void              opus_thread_pool_for(opus_thread_pool *pool, size_t n, opus_thread_pool_task_cb task, void *data);
+
+#ifdef __cplusplus
+};
+#endif /* __cplusplus */
+
+#endif /* THREAD_POOL_H */